@@ -21,6 +21,7 @@
  */
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <errno.h>
 #include <sys/types.h>
@@ -31,8 +32,10 @@
 #include <time.h>
 #include <sys/time.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <limits.h>
 #include <stdint.h>
+#include <pthread.h>
 
 #include "acdll.h"
 
@@ -41,18 +44,66 @@
 #define ACDLL_MAX_SPARE_ELEMS        5
 #endif
 
+#ifndef ACDLL_CHUNK_SIZE
+/** Default number of elements each chunk of the chunked lists has room for */
+#define ACDLL_CHUNK_SIZE             64
+#endif
+
+/** Number of levels of the position index; each level has a quarter of the towers of
+ *  the one below, so it serves lists of up to 4^ACDLL_TOWER_LEVELS elements */
+#define ACDLL_TOWER_LEVELS           15
+/** Positions this close to either end are reached faster walking from it than through the index */
+#define ACDLL_TOWER_MINSEEK          16
+
+/** Number of slots a locator starts with */
+#define ACDLL_LOCATOR_MINSIZE        64
+
+#ifndef ACDLL_POOL_SLAB
+/** Default number of nodes in each slab of the pools */
+#define ACDLL_POOL_SLAB              256
+#endif
+
+
+
+/** Runs of arrays this short are sorted by insertion before being merged */
+#define ACDLL_MINMERGESORTELS        24
 
+/** Number of runs a merge sort of nodes keeps pending: one per power of two of elements */
+#define ACDLL_MERGE_BINS             32
 
-/** Minumum number of elements for sorting with quicksort instead of insertion */
-#define ACDLL_MINQUICKSORTELS        24
+/** Bits of the key ordered by each pass of a radix sort */
+#define ACDLL_RADIX_BITS             11
+/** Number of passes of a radix sort of 32-bit keys */
+#define ACDLL_RADIX_PASSES           ((32 + ACDLL_RADIX_BITS - 1) / ACDLL_RADIX_BITS)
+
+#ifndef ACDLL_SORT_MINPART
+/** Minimum number of elements each thread of a parallel sort gets */
+#define ACDLL_SORT_MINPART           32768
+#endif
+/** Most threads a sort uses */
+#define ACDLL_SORT_MAXTHREADS        64
 
 /** List dump declarations \n
  *  Version of fileformat managed by _dump* and _restore* functions
  */
-#define ACDLL_DUMPFORMAT_VERSION     1
+#define ACDLL_DUMPFORMAT_VERSION     2
+/** Oldest version of fileformat still restored */
+#define ACDLL_DUMPFORMAT_MINVERSION  1
 /** Length of the header */
 #define ACDLL_DUMPFORMAT_HEADERLEN   30
 
+#ifndef ACDLL_DUMP_BUFSIZE
+/** Default size of the buffer the dumps are staged in, bytes */
+#define ACDLL_DUMP_BUFSIZE           (1024 * 1024)
+#endif
+/** Maximum number of pieces handed to one writev() by the dumps */
+#define ACDLL_DUMP_IOVMAX            64
+
+/** Alignment of the memory given by the arenas, as for malloc() */
+#define ACDLL_ARENA_ALIGN            16
+/** Minimum size of a block of the arenas */
+#define ACDLL_ARENA_MINSIZE          (64 * 1024)
+
 /** Header description for a list dump */
 struct list_dump_header_s {
 	/** version */
@@ -73,12 +124,119 @@ struct list_dump_header_s {
 };
 
 
+/** Buffered writer of a list dump: small pieces are copied into a staging buffer,
+ *  pieces that stay valid until the flush are referenced, and all go out in one writev()
+ */
+struct list_dump_writer_s {
+	/** file descriptor to write to */
+	int fd;
+	/** staging buffer */
+	char *buf;
+	/** size of the staging buffer */
+	size_t size;
+	/** bytes of the staging buffer in use */
+	size_t used;
+	/** pieces to write, in order */
+	struct iovec iov[ACDLL_DUMP_IOVMAX];
+	/** number of pieces in iov */
+	int iovcnt;
+	/** bytes in the pieces */
+	size_t pending;
+	/** true if a write failed */
+	int error;
+};
+
+/** Slab of nodes of a pool */
+struct list_slab_s {
+	/** Next, older, slab */
+	struct list_slab_s *next;
+	/** Nodes of the slab; there are as many as the slab size of the pool */
+	struct list_entry_s nodes[1];
+};
+
+/** Reader of a list dump: serves the records from a buffer refilled with large reads,
+ *  or straight from a mapping
+ */
+struct list_restore_reader_s {
+	/** file descriptor to read from, or -1 if buf is the whole dump */
+	int fd;
+	/** data read */
+	unsigned char *buf;
+	/** size of buf */
+	size_t size;
+	/** bytes of buf filled */
+	size_t len;
+	/** position in buf of the next byte to serve */
+	size_t pos;
+};
+
+/** Partition of an array sorted by one thread of a parallel sort */
+struct list_sort_part_s {
+	/** list of the elements, for its comparator; NULL if the array is of sort keys */
+	const list_t *l;
+	/** same as in list_sort() */
+	int versus;
+	/** first element of the partition: element data pointers, or sort keys */
+	void *a;
+	/** scratch space for as many elements */
+	void *tmp;
+	/** number of elements */
+	unsigned int n;
+	/** thread sorting the partition */
+	pthread_t thread;
+	/** true if the thread was started */
+	int threaded;
+};
+
+/** Range of the keys counted and moved by one thread of a parallel radix sort, in each pass */
+struct list_radix_part_s {
+	/** first key of the range, in the array the pass reads */
+	const struct list_radixkey_s *src;
+	/** array the pass writes */
+	struct list_radixkey_s *dst;
+	/** number of keys */
+	unsigned int n;
+	/** bits flipped in every key, to reverse the order */
+	uint32_t flip;
+	/** bits of the keys below the digit of the pass */
+	unsigned int shift;
+	/** false to count the digits of the range; true to move its keys to the offsets in count */
+	int scatter;
+	/** keys of the range by digit, then where in dst the next one of each digit goes */
+	unsigned int count[1 << ACDLL_RADIX_BITS];
+	/** thread of the range */
+	pthread_t thread;
+	/** true if the thread was started */
+	int threaded;
+};
+
 static int list_drop_elem(list_t *l, struct list_entry_s *tmp, unsigned int pos);
 
+static inline void list_changed_insert(list_t *l, unsigned int pos);
+
+static inline void list_changed_delete(list_t *l, unsigned int pos);
+
+static void list_restore_link(list_t *l, struct list_entry_s *nodes, unsigned int n);
+
+static void list_sort_array(const list_t *l, int versus, void **a, void **tmp, unsigned int n);
+
+static int list_index_build(list_t *l);
+
+static void list_index_drop(list_t *l);
+
+static int list_locator_reserve(list_t *l, unsigned int n);
+
 static int list_attributes_setdefaults(list_t *l);
 
-static void list_sort_quicksort(list_t *l, int versus, unsigned int first, struct list_entry_s *fel, unsigned int last,
-		struct list_entry_s *lel);
+static void list_sort_merge(list_t *l, int versus);
+
+static unsigned int list_sort_threads(const list_t *l, unsigned int n);
+
+static void list_sort_parallel(const list_t *l, int keyed, int versus, void *a, void *tmp, unsigned int n,
+		unsigned int parts);
+
+static struct list_radixkey_s *list_sort_radix_parallel(struct list_radixkey_s *keys, struct list_radixkey_s *tmp,
+		unsigned int n, uint32_t flip, unsigned int parts);
 
 
 
@@ -90,6 +248,8 @@ int list_init(list_t *l) {
 	srandom((unsigned long)time(NULL));
 
 	l->numels = 0;
+	l->generation = 0;
+	l->sorted = 0;
 
 	/* head/tail sentinels and mid pointer */
 	l->head_sentinel = (struct list_entry_s *)malloc(sizeof(struct list_entry_s));
@@ -102,27 +262,67 @@ int list_init(list_t *l) {
 	/* iteration attributes */
 	l->iter_active = 0;
 	l->iter_pos = 0;
-	l->iter_curentry = NULL;
+	memset(&l->iter_cursor, 0, sizeof(l->iter_cursor));
+
+	l->restore_version = 0;
+	l->restore_mapped = 0;
+
+	l->arena = NULL;
+	l->towers = NULL;
+	memset(&l->locator, 0, sizeof(l->locator));
 
 	/* free-list attributes */
 	l->spareels = (struct list_entry_s **)malloc(ACDLL_MAX_SPARE_ELEMS * sizeof(struct list_entry_s *));
 	l->spareelsnum = 0;
+	memset(&l->pool, 0, sizeof(l->pool));
+	memset(&l->chunks, 0, sizeof(l->chunks));
 
 	list_attributes_setdefaults(l);
 
 	return 0;
 }
 
+int list_init_pool(list_t *l, unsigned int slab) {
+	if (list_init(l) != 0)
+		return -1;
+
+	l->pool.slab = (slab > 0 ? slab : ACDLL_POOL_SLAB);
+	return 0;
+}
+
+int list_init_chunked(list_t *l, unsigned int chunk) {
+	if (list_init(l) != 0)
+		return -1;
+
+	l->chunks.size = (chunk > 0 ? chunk : ACDLL_CHUNK_SIZE);
+	return 0;
+}
+
 void list_destroy(list_t *l) {
+	struct list_arena_s *a;
+	struct list_slab_s *s;
 	unsigned int i;
 
 	list_clear(l);
+	list_index_drop(l);
+	free(l->locator.slots);
 	for (i = 0; i < l->spareelsnum; i++) {
-		free(l->spareels[i]);
+		if (!list_arena_owns(l, l->spareels[i]))
+			free(l->spareels[i]);
 	}
 	free(l->spareels);
 	free(l->head_sentinel);
 	free(l->tail_sentinel);
+
+	while ((s = l->pool.slabs) != NULL) {
+		l->pool.slabs = s->next;
+		free(s);
+	}
+
+	while ((a = l->arena) != NULL) {
+		l->arena = a->next;
+		free(a);
+	}
 }
 
 /** set default values for initialized lists 
@@ -130,6 +330,7 @@ void list_destroy(list_t *l) {
  */
 int list_attributes_setdefaults(list_t *l) {
 	l->attrs.comparator = NULL;
+	l->attrs.keyer = NULL;
 	l->attrs.seeker = NULL;
 
 	/* also free() element data when removing and element from the list */
@@ -139,6 +340,10 @@ int list_attributes_setdefaults(list_t *l) {
 	l->attrs.serializer = NULL;
 	l->attrs.unserializer = NULL;
 
+	l->attrs.dump_bufsize = ACDLL_DUMP_BUFSIZE;
+
+	l->attrs.threads = 1;
+
 	return 0;
 }
 
@@ -151,6 +356,14 @@ int list_attributes_comparator(list_t *l, element_comparator comparator_fun) {
 	return 0;
 }
 
+int list_attributes_keyer(list_t *l, element_keyer keyer_fun) {
+	if (l == NULL)
+		return -1;
+
+	l->attrs.keyer = keyer_fun;
+	return 0;
+}
+
 int list_attributes_seeker(list_t *l, element_seeker seeker_fun) {
 	if (l == NULL)
 		return -1;
@@ -168,288 +381,1883 @@ int list_attributes_copy(list_t *l, element_meter metric_fun, int copy_data) {
 	return 0;
 }
 
-int list_append(list_t *l, const void *data) {
-	return list_insert_at(l, data, l->numels);
+int list_attributes_serializer(list_t *l, element_serializer serializer_fun, element_unserializer unserializer_fun) {
+	if (l == NULL)
+		return -1;
+
+	l->attrs.serializer = serializer_fun;
+	l->attrs.unserializer = unserializer_fun;
+	return 0;
 }
 
-/** 
- * Set tmp to point to element at index posstart in l 
- * \param l     	list to operate
- * \param posstart  start position
- * */
-static inline struct list_entry_s *list_findpos(const list_t *l, int posstart) {
-	struct list_entry_s *ptr;
-	float x;
-	int i;
+int list_attributes_indexed(list_t *l, int indexed) {
+	if (l == NULL || l->iter_active || (indexed && l->chunks.size > 0))
+		return -1;
 
-	/* accept 1 slot overflow for fetching head and tail sentinels */
-	if (posstart < -1 || posstart > (int)l->numels)
-		return NULL;
+	list_index_drop(l);
+	return (indexed ? list_index_build(l) : 0);
+}
 
-	x = (float)(posstart+1) / l->numels;
-	if (x <= 0.25) {
-		/* first quarter: get to posstart from head */
-		for (i = -1, ptr = l->head_sentinel; i < posstart; ptr = ptr->next, i++)
-			;
-	} else if (x < 0.5) {
-		/* second quarter: get to posstart from mid */
-		for (i = (l->numels-1)/2, ptr = l->mid_sentinel; i > posstart; ptr = ptr->prev, i--)
-			;
-	} else if (x <= 0.75) {
-		/* third quarter: get to posstart from mid */
-		for (i = (l->numels-1)/2, ptr = l->mid_sentinel; i < posstart; ptr = ptr->next, i++)
-			;
-	} else {
-		/* fourth quarter: get to posstart from tail */
-		for (i = l->numels, ptr = l->tail_sentinel; i > posstart; ptr = ptr->prev, i--)
-			;
-	}
+int list_attributes_threads(list_t *l, unsigned int threads) {
+	long n;
 
-	return ptr;
+	if (l == NULL)
+		return -1;
+
+	if (threads == 0) {
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (n > 0 ? (unsigned int)n : 1);
+	}
+	l->attrs.threads = (threads < ACDLL_SORT_MAXTHREADS ? threads : ACDLL_SORT_MAXTHREADS);
+	return 0;
 }
 
-int list_insert_at(list_t *l, const void *data, unsigned int pos) {
-	struct list_entry_s *lent, *succ, *prec;
+int list_attributes_locator(list_t *l, int located) {
+	if (l == NULL || l->iter_active || (located && l->chunks.size > 0))
+		return -1;
 
-	if (l->iter_active || pos > l->numels)
+	free(l->locator.slots);
+	memset(&l->locator, 0, sizeof(l->locator));
+	return (located ? list_locator_reserve(l, l->numels) : 0);
+}
+
+int list_attributes_dump_buffer(list_t *l, size_t size) {
+	if (l == NULL)
 		return -1;
 
-	/* this code optimizes malloc() with a free-list */
-	if (l->spareelsnum > 0) {
+	l->attrs.dump_bufsize = (size > 0 ? size : ACDLL_DUMP_BUFSIZE);
+	return 0;
+}
+
+/**
+ * Add a block to the arena of a list.
+ * \param l     list to operate
+ * \param size  bytes the block must have
+ * \return      the new block, now the current one, or NULL on failure
+ */
+static struct list_arena_s *list_arena_grow(list_t *l, size_t size) {
+	struct list_arena_s *a;
+	size_t head = (sizeof(struct list_arena_s) + ACDLL_ARENA_ALIGN - 1) & ~(size_t)(ACDLL_ARENA_ALIGN - 1);
+
+	a = (struct list_arena_s *)malloc(head + size);
+	if (a == NULL)
+		return NULL;
+	a->base = (char *)a + head;
+	a->used = 0;
+	a->size = size;
+	a->next = l->arena;
+	l->arena = a;
+
+	return a;
+}
+
+/**
+ * Make room in the current block of the arena of a list.
+ * \param l     list to operate
+ * \param size  bytes to be allocated next
+ * \return      0 for success. -1 for failure
+ */
+static int list_arena_reserve(list_t *l, size_t size) {
+	if (l->arena != NULL && l->arena->size - l->arena->used >= size)
+		return 0;
+
+	/* blocks at least double, so there are few of them to look into */
+	if (l->arena != NULL && size < 2 * l->arena->size)
+		size = 2 * l->arena->size;
+	if (size < ACDLL_ARENA_MINSIZE)
+		size = ACDLL_ARENA_MINSIZE;
+
+	return (list_arena_grow(l, size) != NULL ? 0 : -1);
+}
+
+void *list_arena_alloc(list_t *l, size_t size) {
+	void *p;
+
+	size = (size + ACDLL_ARENA_ALIGN - 1) & ~(size_t)(ACDLL_ARENA_ALIGN - 1);
+	if (list_arena_reserve(l, size) != 0)
+		return NULL;
+
+	p = l->arena->base + l->arena->used;
+	l->arena->used += size;
+
+	return p;
+}
+
+int list_arena_owns(const list_t *l, const void *p) {
+	const struct list_arena_s *a;
+
+	for (a = l->arena; a != NULL; a = a->next) {
+		if ((const char *)p >= a->base && (const char *)p < a->base + a->size)
+			return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Get a node for a new element of a list.
+ * \param l     list to operate
+ * \return      the node, or NULL on failure
+ */
+static struct list_entry_s *list_node_new(list_t *l) {
+	struct list_entry_s *lent;
+	struct list_slab_s *s;
+
+	if (l->pool.slab > 0) {
+		if (l->pool.free != NULL) {
+			/* reuse a node given back */
+			lent = l->pool.free;
+			l->pool.free = lent->next;
+			l->pool.numfree--;
+		} else {
+			if (l->pool.slabs == NULL || l->pool.carved == l->pool.slab) {
+				s = (struct list_slab_s *)malloc(sizeof(struct list_slab_s)
+						+ (l->pool.slab - 1) * sizeof(struct list_entry_s));
+				if (s == NULL)
+					return NULL;
+				s->next = l->pool.slabs;
+				l->pool.slabs = s;
+				l->pool.numslabs++;
+				l->pool.carved = 0;
+				l->pool.mallocs++;
+			}
+			lent = &l->pool.slabs->nodes[l->pool.carved++];
+		}
+	} else if (l->spareelsnum > 0) {
+		/* this code optimizes malloc() with a free-list */
 		lent = l->spareels[l->spareelsnum-1];
 		l->spareelsnum--;
 	} else {
 		lent = (struct list_entry_s *)malloc(sizeof(struct list_entry_s));
 		if (lent == NULL)
-			return -1;
+			return NULL;
+		l->pool.mallocs++;
 	}
+	l->pool.allocs++;
 
-	lent->data = (void*)data;
+	return lent;
+}
 
-	/* actually append element */
-	prec = list_findpos(l, pos-1);
-	succ = prec->next;
+/**
+ * Give back the node of an element removed from a list.
+ * \param l     list to operate
+ * \param lent  the node
+ */
+static void list_node_free(list_t *l, struct list_entry_s *lent) {
+	l->pool.frees++;
+	if (l->pool.slab > 0) {
+		lent->next = l->pool.free;
+		l->pool.free = lent;
+		l->pool.numfree++;
+	} else if (l->spareelsnum < ACDLL_MAX_SPARE_ELEMS) {
+		l->spareels[l->spareelsnum++] = lent;
+	} else if (!list_arena_owns(l, lent)) {
+		/* nodes living in the arena go with it */
+		free(lent);
+	}
+}
 
-	prec->next = lent;
-	lent->prev = prec;
-	lent->next = succ;
-	succ->prev = lent;
+int list_pool_stats(const list_t *l, struct list_pool_stats_s *st) {
+	if (l == NULL || st == NULL)
+		return -1;
 
-	l->numels++;
+	st->slab = l->pool.slab;
+	st->slabs = l->pool.numslabs;
+	st->nodes = l->pool.numslabs * l->pool.slab;
+	st->free = (l->pool.slab > 0 ? l->pool.numfree : l->spareelsnum);
+	st->allocs = l->pool.allocs;
+	st->frees = l->pool.frees;
+	st->mallocs = l->pool.mallocs;
+	st->bytes = (size_t)l->pool.numslabs * (sizeof(struct list_slab_s)
+			+ (l->pool.slab - 1) * sizeof(struct list_entry_s));
 
-	/* fix mid pointer */
-	if (l->numels == 1) { /* first element, set pointer */
-		l->mid_sentinel = lent;
-	} else if (l->numels % 2) { /* now odd */
-		if (pos >= (l->numels-1)/2)
-			l->mid_sentinel = l->mid_sentinel->next;
-	} else { /* now even */
-		if (pos <= (l->numels-1)/2)
-			l->mid_sentinel = l->mid_sentinel->prev;
+	return 0;
+}
+
+/**
+ * Set a cursor before the first element of a list.
+ * \param l     list to operate
+ * \param c     cursor to set
+ */
+static inline void list_cursor_rewind(const list_t *l, struct list_cursor_s *c) {
+	c->node = l->head_sentinel;
+	c->chunk = l->chunks.head;
+	/* wraps to 0 on the first step */
+	c->pos = UINT_MAX;
+}
+
+/**
+ * Move a cursor to the next element of a list.
+ * \param l     list to operate
+ * \param c     cursor to move
+ * \return      reference to the data pointer of the element, or NULL past the last one
+ */
+static inline void **list_cursor_next(const list_t *l, struct list_cursor_s *c) {
+	if (l->chunks.size == 0) {
+		c->node = c->node->next;
+		return (c->node != l->tail_sentinel ? &c->node->data : NULL);
 	}
 
-	return 1;
+	c->pos++;
+	while (c->chunk != NULL && c->pos >= c->chunk->numels) {
+		c->chunk = c->chunk->next;
+		c->pos = 0;
+	}
+	return (c->chunk != NULL ? &c->chunk->data[c->pos] : NULL);
 }
 
-int list_delete_at(list_t *l, unsigned int pos) {
-	struct list_entry_s *delendo;
+/**
+ * Add an empty chunk to a chunked list.
+ * \param l     list to operate
+ * \param prec  chunk to add it after, or NULL to add it first
+ * \return      the new chunk, or NULL on failure
+ */
+static struct list_chunk_s *list_chunk_new(list_t *l, struct list_chunk_s *prec) {
+	struct list_chunk_s *c;
 
-	if (l->iter_active || pos >= l->numels)
-		return -1;
+	c = (struct list_chunk_s *)malloc(sizeof(struct list_chunk_s) + (l->chunks.size - 1) * sizeof(void *));
+	if (c == NULL)
+		return NULL;
 
-	delendo = list_findpos(l, pos);
+	c->numels = 0;
+	c->prev = prec;
+	c->next = (prec != NULL ? prec->next : l->chunks.head);
+	if (c->prev != NULL)
+		c->prev->next = c;
+	else
+		l->chunks.head = c;
+	if (c->next != NULL)
+		c->next->prev = c;
+	else
+		l->chunks.tail = c;
+	l->chunks.numchunks++;
+
+	return c;
+}
 
-	list_drop_elem(l, delendo, pos);
+/**
+ * Remove a chunk from a chunked list, and free it.
+ * \param l     list to operate
+ * \param c     chunk to remove
+ */
+static void list_chunk_free(list_t *l, struct list_chunk_s *c) {
+	if (c->prev != NULL)
+		c->prev->next = c->next;
+	else
+		l->chunks.head = c->next;
+	if (c->next != NULL)
+		c->next->prev = c->prev;
+	else
+		l->chunks.tail = c->prev;
+	l->chunks.numchunks--;
+	free(c);
+}
+
+/**
+ * Find the chunk of the element at a position of a chunked list.
+ * \param l     list to operate
+ * \param pos   [0,size] position; size stands for the end of the last chunk
+ * \param i     position of the element in the chunk, to fill
+ * \return      the chunk, or NULL if the list is empty
+ */
+static struct list_chunk_s *list_chunk_findpos(const list_t *l, unsigned int pos, unsigned int *i) {
+	struct list_chunk_s *c;
+	unsigned int base;
+
+	if (pos < l->numels / 2) {
+		/* first half: get to pos from the head */
+		for (c = l->chunks.head; pos >= c->numels; c = c->next)
+			pos -= c->numels;
+		*i = pos;
+	} else {
+		/* second half: get to pos from the tail */
+		c = l->chunks.tail;
+		if (c == NULL)
+			return NULL;
+		for (base = l->numels - c->numels; pos < base; base -= c->numels)
+			c = c->prev;
+		*i = pos - base;
+	}
+
+	return c;
+}
+
+/**
+ * Insert an element at a given position of a chunked list.
+ * \param l     list to operate
+ * \param data  pointer to user data
+ * \param pos   [0,size] position to insert the element at
+ * \return      1 for success. < 0 for failure
+ */
+static int list_chunk_insert(list_t *l, const void *data, unsigned int pos) {
+	struct list_chunk_s *c, *n;
+	unsigned int i, half;
+
+	c = list_chunk_findpos(l, pos, &i);
+	if (c == NULL || c->numels == l->chunks.size) {
+		/* no room: add a chunk after c */
+		n = list_chunk_new(l, c);
+		if (n == NULL)
+			return -1;
+		if (c != NULL && i < c->numels) {
+			/* split c in halves, and insert into the one the position falls in */
+			half = c->numels / 2;
+			memcpy(n->data, c->data + half, (c->numels - half) * sizeof(void *));
+			n->numels = c->numels - half;
+			c->numels = half;
+			if (i > half) {
+				c = n;
+				i -= half;
+			}
+		} else {
+			/* appending to a full chunk: start the new one */
+			c = n;
+			i = 0;
+		}
+	}
+
+	memmove(c->data + i + 1, c->data + i, (c->numels - i) * sizeof(void *));
+	c->data[i] = (void *)data;
+	c->numels++;
+	l->numels++;
+	list_changed_insert(l, pos);
+
+	return 1;
+}
+
+/**
+ * Delete the element at a given position of a chunked list.
+ * \param l     list to operate
+ * \param pos   [0,size-1] position of the element
+ */
+static void list_chunk_delete(list_t *l, unsigned int pos) {
+	struct list_chunk_s *c, *n;
+	unsigned int i;
 
+	c = list_chunk_findpos(l, pos, &i);
+	c->numels--;
+	memmove(c->data + i, c->data + i + 1, (c->numels - i) * sizeof(void *));
 	l->numels--;
+	list_changed_delete(l, pos);
 
-	return 0;
+	if (c->numels == 0) {
+		list_chunk_free(l, c);
+		return;
+	}
+	/* keep the chunks from getting sparse: merge a quarter full chunk with a neighbour */
+	if (c->numels <= l->chunks.size / 4) {
+		if (c->prev != NULL && c->prev->numels + c->numels <= l->chunks.size) {
+			n = c;
+			c = c->prev;
+		} else if (c->next != NULL && c->next->numels + c->numels <= l->chunks.size) {
+			n = c->next;
+		} else {
+			return;
+		}
+		memcpy(c->data + c->numels, n->data, n->numels * sizeof(void *));
+		c->numels += n->numels;
+		list_chunk_free(l, n);
+	}
 }
 
-int list_clear(list_t *l) {
-	struct list_entry_s *s;
+int list_append(list_t *l, const void *data) {
+	return list_insert_at(l, data, l->numels);
+}
+
+int list_append_array(list_t *l, void *const *data, unsigned int n) {
+	struct list_entry_s *nodes;
+	unsigned int i;
 
 	if (l->iter_active)
 		return -1;
+	if (n == 0)
+		return 0;
+
+	if (l->chunks.size > 0) {
+		for (i = 0; i < n; i++) {
+			if (list_chunk_insert(l, data[i], l->numels) < 0) {
+				while (i-- > 0)
+					list_chunk_delete(l, l->numels - 1);
+				return -1;
+			}
+		}
+		return (int)n;
+	}
 
-	/* spare a loop conditional with two loops: spareing elems and freeing elems */
-	for (s = l->head_sentinel->next; l->spareelsnum < ACDLL_MAX_SPARE_ELEMS && s != l->tail_sentinel; s = s->next) {
-		/* move elements as spares as long as there is room */
-		l->spareels[l->spareelsnum++] = s;
+	nodes = (struct list_entry_s *)list_arena_alloc(l, (size_t)n * sizeof(struct list_entry_s));
+	if (nodes == NULL)
+		return -1;
+	for (i = 0; i < n; i++) {
+		nodes[i].data = data[i];
+		nodes[i].tower = NULL;
 	}
-	while (s != l->tail_sentinel) {
-		/* free the remaining elems */
-		s = s->next;
-		free(s->prev);
+	list_restore_link(l, nodes, n);
+	if (l->towers != NULL) {
+		list_index_drop(l);
+		list_index_build(l);
 	}
-	l->head_sentinel->next = l->tail_sentinel;
-	l->tail_sentinel->prev = l->head_sentinel;
+	/* the locator catches up on its next lookup */
+	l->locator.stale = 1;
 
-	l->numels = 0;
-	l->mid_sentinel = NULL;
+	return (int)n;
+}
+
+/**
+ * Record an element inserted in a list.
+ * \param l     list to operate
+ * \param pos   position the element was inserted at
+ */
+static inline void list_changed_insert(list_t *l, unsigned int pos) {
+	l->generation++;
+	/* appending keeps the sorted elements in front */
+	if (pos < l->sorted)
+		l->sorted = pos;
+}
+
+/**
+ * Record an element deleted from a list.
+ * \param l     list to operate
+ * \param pos   position the element was at; UINT_MAX if unknown
+ */
+static inline void list_changed_delete(list_t *l, unsigned int pos) {
+	l->generation++;
+	/* the others keep their order; an element of unknown position may have been a sorted one */
+	if (l->sorted > 0 && (pos < l->sorted || pos == UINT_MAX))
+		l->sorted--;
+}
+
+/**
+ * Record a list just sorted.
+ * \param l     list to operate
+ */
+static inline void list_changed_sort(list_t *l) {
+	l->generation++;
+	l->sorted = l->numels;
+}
+
+/**
+ * Allocate a tower of the position index.
+ * \param node  node the tower stands on
+ * \param height number of levels
+ * \return      the tower, linked to nothing, or NULL on failure
+ */
+static struct list_tower_s *list_tower_new(struct list_entry_s *node, unsigned int height) {
+	struct list_tower_s *t;
+	unsigned int i;
+
+	t = (struct list_tower_s *)malloc(sizeof(struct list_tower_s) + (height - 1) * sizeof(struct list_tower_link_s));
+	if (t == NULL)
+		return NULL;
+	t->node = node;
+	t->height = height;
+	for (i = 0; i < height; i++) {
+		t->link[i].next = t->link[i].prev = NULL;
+		t->link[i].width = 0;
+	}
+	node->tower = t;
+
+	return t;
+}
+
+/**
+ * Draw the height of the tower of a new node: 0 for three nodes in four, and a quarter
+ * of the towers reach each next level.
+ * \return      number of levels
+ */
+static inline unsigned int list_tower_height(void) {
+	unsigned long r = (unsigned long)random();
+	unsigned int h = 0;
+
+	while (h < ACDLL_TOWER_LEVELS && (r & 3) == 0) {
+		h++;
+		r >>= 2;
+	}
+
+	return h;
+}
+
+/**
+ * Drop the position index of a list.
+ * \param l     list to operate
+ */
+static void list_index_drop(list_t *l) {
+	struct list_tower_s *t, *next;
+
+	/* every tower is linked at the first level */
+	for (t = l->towers; t != NULL; t = next) {
+		next = t->link[0].next;
+		free(t);
+	}
+	l->towers = NULL;
+}
+
+/**
+ * Build the position index of a list, over all its nodes.
+ * \param l     list to operate
+ * \return      0 for success. -1 for failure
+ */
+static int list_index_build(list_t *l) {
+	struct list_tower_s *last[ACDLL_TOWER_LEVELS], *t;
+	int lastpos[ACDLL_TOWER_LEVELS], pos;
+	struct list_entry_s *x;
+	unsigned int h, i;
+
+	l->towers = list_tower_new(l->head_sentinel, ACDLL_TOWER_LEVELS);
+	if (l->towers == NULL)
+		return -1;
+	/* the head sentinel stands at position -1 */
+	for (i = 0; i < ACDLL_TOWER_LEVELS; i++) {
+		last[i] = l->towers;
+		lastpos[i] = -1;
+	}
+
+	for (pos = 0, x = l->head_sentinel->next; x != l->tail_sentinel; x = x->next, pos++) {
+		h = list_tower_height();
+		x->tower = NULL;
+		if (h == 0)
+			continue;
+		t = list_tower_new(x, h);
+		if (t == NULL) {
+			list_index_drop(l);
+			return -1;
+		}
+		for (i = 0; i < h; i++) {
+			last[i]->link[i].next = t;
+			last[i]->link[i].width = pos - lastpos[i];
+			t->link[i].prev = last[i];
+			last[i] = t;
+			lastpos[i] = pos;
+		}
+	}
+	for (i = 0; i < ACDLL_TOWER_LEVELS; i++)
+		last[i]->link[i].width = l->numels - lastpos[i];
+
+	return 0;
+}
+
+/**
+ * Find, at every level of the position index of a list, the last tower at or before a position.
+ * \param l         list to operate
+ * \param pos       [-1,size] position
+ * \param update    array of ACDLL_TOWER_LEVELS towers to fill
+ * \param rank      array of ACDLL_TOWER_LEVELS positions of those towers to fill
+ */
+static void list_index_seek(const list_t *l, int pos, struct list_tower_s **update, int *rank) {
+	struct list_tower_s *t = l->towers;
+	int i, cur = -1;
+
+	for (i = ACDLL_TOWER_LEVELS - 1; i >= 0; i--) {
+		while (t->link[i].next != NULL && cur + (int)t->link[i].width <= pos) {
+			cur += t->link[i].width;
+			t = t->link[i].next;
+		}
+		update[i] = t;
+		rank[i] = cur;
+	}
+}
+
+/**
+ * Add a node just linked into a list to its position index.
+ * \param l     list to operate
+ * \param lent  the node
+ * \param pos   position of the node
+ */
+static void list_index_insert(list_t *l, struct list_entry_s *lent, unsigned int pos) {
+	struct list_tower_s *update[ACDLL_TOWER_LEVELS], *t = NULL;
+	int rank[ACDLL_TOWER_LEVELS];
+	unsigned int h, i;
+
+	list_index_seek(l, (int)pos - 1, update, rank);
+
+	/* without memory for a tower the node just goes without one */
+	h = list_tower_height();
+	lent->tower = NULL;
+	if (h > 0 && (t = list_tower_new(lent, h)) == NULL)
+		h = 0;
+
+	for (i = 0; i < ACDLL_TOWER_LEVELS; i++) {
+		if (i < h) {
+			t->link[i].next = update[i]->link[i].next;
+			t->link[i].prev = update[i];
+			t->link[i].width = rank[i] + update[i]->link[i].width + 1 - pos;
+			if (t->link[i].next != NULL)
+				t->link[i].next->link[i].prev = t;
+			update[i]->link[i].next = t;
+			update[i]->link[i].width = pos - rank[i];
+		} else {
+			/* the link passes over the new node */
+			update[i]->link[i].width++;
+		}
+	}
+}
+
+/**
+ * Remove a node about to be unlinked from a list from its position index.
+ * \param l     list to operate
+ * \param lent  the node
+ * \param pos   position of the node
+ */
+static void list_index_delete(list_t *l, struct list_entry_s *lent, unsigned int pos) {
+	struct list_tower_s *update[ACDLL_TOWER_LEVELS], *t = NULL, *n;
+	int rank[ACDLL_TOWER_LEVELS];
+	unsigned int i;
+
+	list_index_seek(l, (int)pos - 1, update, rank);
+
+	for (i = 0; i < ACDLL_TOWER_LEVELS; i++) {
+		n = update[i]->link[i].next;
+		if (n != NULL && n->node == lent) {
+			update[i]->link[i].width += n->link[i].width - 1;
+			update[i]->link[i].next = n->link[i].next;
+			if (n->link[i].next != NULL)
+				n->link[i].next->link[i].prev = update[i];
+			t = n;
+		} else {
+			update[i]->link[i].width--;
+		}
+	}
+	free(t);
+}
+
+/**
+ * Find the position of a node of a list through its position index.
+ * \param l     list to operate
+ * \param lent  the node
+ * \return      its position
+ */
+static unsigned int list_index_rank(const list_t *l, const struct list_entry_s *lent) {
+	const struct list_tower_s *t;
+	unsigned int lvl = 0;
+	int pos = 0;
+
+	/* walk back to the nearest node with a tower: the head sentinel has one */
+	for (; lent->tower == NULL; lent = lent->prev)
+		pos++;
+	/* then climb back to the head sentinel, at the top level of each tower met */
+	for (t = lent->tower; t != l->towers; t = t->link[lvl].prev) {
+		lvl = t->height - 1;
+		pos += t->link[lvl].prev->link[lvl].width;
+	}
+
+	return pos - 1;
+}
+
+/**
+ * Hash of an element data pointer, for the locator.
+ * \param data  element data pointer
+ * \param mask  number of slots of the locator minus one
+ * \return      first slot to probe
+ */
+static inline unsigned int list_locator_hash(const void *data, unsigned int mask) {
+	/* Fibonacci hashing: the middle bits of the product depend on every bit of the pointer */
+	return (unsigned int)(((uint64_t)(uintptr_t)data * UINT64_C(0x9E3779B97F4A7C15)) >> 32) & mask;
+}
+
+/**
+ * Add a node to the locator of a list, which must have room for it.
+ * \param l     list to operate
+ * \param lent  the node
+ */
+static void list_locator_add(list_t *l, struct list_entry_s *lent) {
+	struct list_locator_slot_s *slots = l->locator.slots;
+	unsigned int mask = l->locator.size - 1, i;
+
+	for (i = list_locator_hash(lent->data, mask); slots[i].node != NULL; i = (i + 1) & mask)
+		;
+	slots[i].data = lent->data;
+	slots[i].node = lent;
+	l->locator.numels++;
+}
+
+/**
+ * Fill the locator of a list again with all its nodes.
+ * \param l     list to operate
+ */
+static void list_locator_fill(list_t *l) {
+	struct list_entry_s *x;
+
+	memset(l->locator.slots, 0, l->locator.size * sizeof(struct list_locator_slot_s));
+	l->locator.numels = 0;
+	for (x = l->head_sentinel->next; x != l->tail_sentinel; x = x->next)
+		list_locator_add(l, x);
+	l->locator.stale = 0;
+}
+
+/**
+ * Make room in the locator of a list for a number of elements; if it grows, it is
+ * filled again.
+ * \param l     list to operate
+ * \param n     number of elements
+ * \return      0 for success. -1 for failure
+ */
+static int list_locator_reserve(list_t *l, unsigned int n) {
+	struct list_locator_slot_s *slots;
+	unsigned int size = l->locator.size;
+
+	/* at most three slots in four are in use, to keep the probes short */
+	if (size > 0 && n <= size / 4 * 3)
+		return 0;
+	if (size == 0)
+		size = ACDLL_LOCATOR_MINSIZE;
+	while (n > size / 4 * 3) {
+		if (size > UINT_MAX / 2)
+			return -1;
+		size *= 2;
+	}
+
+	slots = (struct list_locator_slot_s *)malloc(size * sizeof(struct list_locator_slot_s));
+	if (slots == NULL)
+		return -1;
+	free(l->locator.slots);
+	l->locator.slots = slots;
+	l->locator.size = size;
+	list_locator_fill(l);
+
+	return 0;
+}
+
+/**
+ * Get the locator of a list ready for lookups, filling it again if a sort moved the elements.
+ * \param l     list to operate
+ * \return      1 if the locator can be used; 0 if the list has none, or no memory to fill it
+ */
+static int list_locator_ready(list_t *l) {
+	if (l->locator.slots == NULL)
+		return 0;
+	if (l->locator.stale) {
+		if (list_locator_reserve(l, l->numels) != 0)
+			return 0;
+		if (l->locator.stale)
+			list_locator_fill(l);
+	}
+
+	return 1;
+}
+
+/**
+ * Find the slot of an element in the locator of a list.
+ * \param l     list to operate
+ * \param data  the element
+ * \return      the slot, or NULL if the element is not in the list
+ */
+static struct list_locator_slot_s *list_locator_find(const list_t *l, const void *data) {
+	struct list_locator_slot_s *slots = l->locator.slots;
+	unsigned int mask = l->locator.size - 1, i;
+
+	for (i = list_locator_hash(data, mask); slots[i].node != NULL; i = (i + 1) & mask) {
+		if (slots[i].data == data)
+			return &slots[i];
+	}
+
+	return NULL;
+}
+
+/**
+ * Empty a slot of the locator of a list.
+ * \param l     list to operate
+ * \param s     the slot
+ */
+static void list_locator_remove(list_t *l, struct list_locator_slot_s *s) {
+	struct list_locator_slot_s *slots = l->locator.slots;
+	unsigned int mask = l->locator.size - 1, i = (unsigned int)(s - slots), j, k;
+
+	/* move back the slots probed past this one, so that no probe stops short of them */
+	for (j = (i + 1) & mask; slots[j].node != NULL; j = (j + 1) & mask) {
+		k = list_locator_hash(slots[j].data, mask);
+		if (((j - k) & mask) >= ((j - i) & mask)) {
+			slots[i] = slots[j];
+			i = j;
+		}
+	}
+	slots[i].node = NULL;
+	l->locator.numels--;
+}
+
+/**
+ * Remove a node about to be unlinked from a list from its locator, if it is up to date.
+ * \param l     list to operate
+ * \param lent  the node
+ */
+static void list_locator_forget(list_t *l, struct list_entry_s *lent) {
+	struct list_locator_slot_s *slots = l->locator.slots;
+	unsigned int mask = l->locator.size - 1, i;
+
+	if (slots == NULL || l->locator.stale)
+		return;
+	for (i = list_locator_hash(lent->data, mask); slots[i].node != NULL; i = (i + 1) & mask) {
+		if (slots[i].node == lent) {
+			list_locator_remove(l, &slots[i]);
+			return;
+		}
+	}
+}
+
+/** 
+ * Set tmp to point to element at index posstart in l 
+ * \param l     	list to operate
+ * \param posstart  start position
+ * */
+static inline struct list_entry_s *list_findpos(const list_t *l, int posstart) {
+	struct list_entry_s *ptr;
+	float x;
+	int i;
+
+	/* accept 1 slot overflow for fetching head and tail sentinels */
+	if (posstart < -1 || posstart > (int)l->numels)
+		return NULL;
+
+	if (l->towers != NULL && posstart > ACDLL_TOWER_MINSEEK && posstart < (int)l->numels - ACDLL_TOWER_MINSEEK) {
+		struct list_tower_s *update[ACDLL_TOWER_LEVELS];
+		int rank[ACDLL_TOWER_LEVELS];
+
+		/* get to the nearest tower before posstart, then walk the few nodes left */
+		list_index_seek(l, posstart, update, rank);
+		for (i = rank[0], ptr = update[0]->node; i < posstart; ptr = ptr->next, i++)
+			;
+		return ptr;
+	}
+
+	x = (float)(posstart+1) / l->numels;
+	if (x <= 0.25 || (x < 0.5 && l->mid_sentinel == NULL)) {
+		/* first quarter, or first half without mid: get to posstart from head */
+		for (i = -1, ptr = l->head_sentinel; i < posstart; ptr = ptr->next, i++)
+			;
+	} else if (x < 0.5) {
+		/* second quarter: get to posstart from mid */
+		for (i = (l->numels-1)/2, ptr = l->mid_sentinel; i > posstart; ptr = ptr->prev, i--)
+			;
+	} else if (x <= 0.75 && l->mid_sentinel != NULL) {
+		/* third quarter: get to posstart from mid */
+		for (i = (l->numels-1)/2, ptr = l->mid_sentinel; i < posstart; ptr = ptr->next, i++)
+			;
+	} else {
+		/* fourth quarter: get to posstart from tail */
+		for (i = l->numels, ptr = l->tail_sentinel; i > posstart; ptr = ptr->prev, i--)
+			;
+	}
+
+	return ptr;
+}
+
+int list_insert_at(list_t *l, const void *data, unsigned int pos) {
+	struct list_entry_s *lent, *succ, *prec;
+
+	if (l->iter_active || pos > l->numels)
+		return -1;
+
+	if (l->chunks.size > 0)
+		return list_chunk_insert(l, data, pos);
+
+	if (l->locator.slots != NULL && !l->locator.stale && list_locator_reserve(l, l->numels + 1) != 0)
+		return -1;
+
+	lent = list_node_new(l);
+	if (lent == NULL)
+		return -1;
+
+	lent->data = (void*)data;
+
+	/* actually append element */
+	prec = list_findpos(l, pos-1);
+	succ = prec->next;
+
+	prec->next = lent;
+	lent->prev = prec;
+	lent->next = succ;
+	succ->prev = lent;
+
+	l->numels++;
+	list_changed_insert(l, pos);
+
+	/* fix mid pointer, unless list_delete() left it unknown */
+	if (l->numels == 1) { /* first element, set pointer */
+		l->mid_sentinel = lent;
+	} else if (l->mid_sentinel != NULL) {
+		if (l->numels % 2) { /* now odd */
+			if (pos >= (l->numels-1)/2)
+				l->mid_sentinel = l->mid_sentinel->next;
+		} else { /* now even */
+			if (pos <= (l->numels-1)/2)
+				l->mid_sentinel = l->mid_sentinel->prev;
+		}
+	}
+
+	if (l->towers != NULL)
+		list_index_insert(l, lent, pos);
+	if (l->locator.slots != NULL && !l->locator.stale)
+		list_locator_add(l, lent);
+
+	return 1;
+}
+
+void *list_get_at(const list_t *l, unsigned int pos) {
+	struct list_chunk_s *c;
+	unsigned int i;
+
+	if (pos >= l->numels)
+		return NULL;
+
+	if (l->chunks.size > 0) {
+		c = list_chunk_findpos(l, pos, &i);
+		return c->data[i];
+	}
+
+	return list_findpos(l, pos)->data;
+}
+
+int list_delete_at(list_t *l, unsigned int pos) {
+	struct list_entry_s *delendo;
+
+	if (l->iter_active || pos >= l->numels)
+		return -1;
+
+	if (l->chunks.size > 0) {
+		list_chunk_delete(l, pos);
+		return 0;
+	}
+
+	delendo = list_findpos(l, pos);
+
+	if (l->towers != NULL)
+		list_index_delete(l, delendo, pos);
+	list_locator_forget(l, delendo);
+	list_drop_elem(l, delendo, pos);
+
+	l->numels--;
+	list_changed_delete(l, pos);
+
+	return 0;
+}
+
+int list_delete(list_t *l, const void *data) {
+	struct list_locator_slot_s *s;
+	struct list_entry_s *delendo;
+	unsigned int pos;
+	int p;
+
+	if (l->iter_active)
+		return -1;
+
+	if (!list_locator_ready(l)) {
+		/* without a locator the element is looked for from the head */
+		p = list_locate(l, data);
+		return (p < 0 ? -1 : list_delete_at(l, (unsigned int)p));
+	}
+
+	s = list_locator_find(l, data);
+	if (s == NULL)
+		return -1;
+	delendo = s->node;
+	list_locator_remove(l, s);
+
+	/* only the index tells the position quickly; without it the mid pointer is given up */
+	pos = (l->towers != NULL ? list_index_rank(l, delendo) : UINT_MAX);
+	if (l->towers != NULL)
+		list_index_delete(l, delendo, pos);
+	list_drop_elem(l, delendo, pos);
+
+	l->numels--;
+	list_changed_delete(l, pos);
+
+	return 0;
+}
+
+int list_locate(list_t *l, const void *data) {
+	struct list_locator_slot_s *s;
+	const struct list_entry_s *lent;
+	struct list_cursor_s cur;
+	void **x;
+	int pos;
+
+	if (list_locator_ready(l)) {
+		s = list_locator_find(l, data);
+		if (s == NULL)
+			return -1;
+		if (l->towers != NULL)
+			return (int)list_index_rank(l, s->node);
+		for (pos = -1, lent = s->node; lent != l->head_sentinel; lent = lent->prev)
+			pos++;
+		return pos;
+	}
+
+	list_cursor_rewind(l, &cur);
+	for (pos = 0; (x = list_cursor_next(l, &cur)) != NULL; pos++) {
+		if (*x == data)
+			return pos;
+	}
+
+	return -1;
+}
+
+int list_clear(list_t *l) {
+	struct list_entry_s *s;
+
+	if (l->iter_active)
+		return -1;
+
+	if (l->chunks.size > 0) {
+		while (l->chunks.head != NULL)
+			list_chunk_free(l, l->chunks.head);
+	} else if (l->pool.slab > 0) {
+		if (l->numels > 0) {
+			/* the nodes are already chained by their next pointer: give them back at once */
+			l->tail_sentinel->prev->next = l->pool.free;
+			l->pool.free = l->head_sentinel->next;
+			l->pool.numfree += l->numels;
+		}
+	} else {
+		/* spare a loop conditional with two loops: spareing elems and freeing elems */
+		for (s = l->head_sentinel->next; l->spareelsnum < ACDLL_MAX_SPARE_ELEMS && s != l->tail_sentinel; s = s->next) {
+			/* move elements as spares as long as there is room */
+			l->spareels[l->spareelsnum++] = s;
+		}
+		while (s != l->tail_sentinel) {
+			/* free the remaining elems, but those living in the arena */
+			s = s->next;
+			if (!list_arena_owns(l, s->prev))
+				free(s->prev);
+		}
+	}
+	if (l->chunks.size == 0)
+		l->pool.frees += l->numels;
+	l->head_sentinel->next = l->tail_sentinel;
+	l->tail_sentinel->prev = l->head_sentinel;
+
+	l->numels = 0;
+	l->mid_sentinel = NULL;
+	l->generation++;
+	l->sorted = 0;
+
+	if (l->towers != NULL) {
+		list_index_drop(l);
+		list_index_build(l);
+	}
+	if (l->locator.slots != NULL)
+		list_locator_fill(l);
+
+	return 0;
+}
+
+unsigned int list_size(const list_t *l) {
+	return l->numels;
+}
+
+unsigned long list_generation(const list_t *l) {
+	return l->generation;
+}
+
+unsigned int list_sorted(const list_t *l) {
+	return l->sorted;
+}
+
+const void *list_seek(const list_t *l, void *indicator) {
+	struct list_cursor_s cur;
+	void **x;
+
+	if (l->attrs.seeker == NULL)
+		return NULL;
+
+	list_cursor_rewind(l, &cur);
+	while ((x = list_cursor_next(l, &cur)) != NULL) {
+		if (l->attrs.seeker(*x, indicator) != 0)
+			return *x;
+	}
+
+	return NULL;
+}
+
+int list_sort(list_t *l, int versus) {
+	unsigned int parts;
+
+	if (l->iter_active || (l->attrs.comparator == NULL && l->attrs.keyer == NULL)) /* cannot modify list in the middle of an iteration */
+		return -1;
+
+	if (l->numels <= 1) {
+		l->sorted = l->numels;
+		return 0;
+	}
+
+	if (l->attrs.keyer != NULL) {
+		struct list_sortkey_s *keys;
+		struct list_cursor_s cur;
+		void **x;
+		unsigned int i;
+		int rt;
+
+		keys = (struct list_sortkey_s *)malloc(l->numels * sizeof(struct list_sortkey_s));
+		if (keys == NULL)
+			return -1;
+
+		/* decorate: every key is computed exactly once */
+		list_cursor_rewind(l, &cur);
+		for (i = 0; (x = list_cursor_next(l, &cur)) != NULL; i++) {
+			keys[i].key = l->attrs.keyer(*x);
+			keys[i].data = *x;
+		}
+
+		rt = list_sort_keys(l, keys, l->numels, versus);
+		free(keys);
+		return rt;
+	}
+
+	parts = list_sort_threads(l, l->numels);
+	if (l->chunks.size > 0 || parts > 1) {
+		struct list_cursor_s cur;
+		void **a, **sorted, **x;
+		unsigned int i;
+
+		/* sort the pointers in one array, then store them back in the list in their new order */
+		a = (void **)malloc(2 * (size_t)l->numels * sizeof(void *));
+		if (a == NULL)
+			return -1;
+		list_cursor_rewind(l, &cur);
+		for (i = 0; (x = list_cursor_next(l, &cur)) != NULL; i++)
+			a[i] = *x;
+		if (parts > 1) {
+			list_sort_parallel(l, 0, versus, a, a + l->numels, l->numels, parts);
+			sorted = a + l->numels;
+		} else {
+			list_sort_array(l, versus, a, a + l->numels, l->numels);
+			sorted = a;
+		}
+		list_cursor_rewind(l, &cur);
+		for (i = 0; (x = list_cursor_next(l, &cur)) != NULL; i++)
+			*x = sorted[i];
+		free(a);
+		/* the elements changed nodes */
+		l->locator.stale = 1;
+		list_changed_sort(l);
+		return 0;
+	}
+
+	list_sort_merge(l, versus);
+	list_changed_sort(l);
+	return 0;
+}
+
+/**
+ * Tell if a sort key goes after another in the order list_sort() gives.
+ * \param a     first key
+ * \param b     second key
+ * \param versus same as in list_sort()
+ * \return      non-0 if a goes after b; 0 if it goes before or they are equal
+ */
+static inline int list_sortkey_after(const struct list_sortkey_s *a, const struct list_sortkey_s *b, int versus) {
+	/* same order list_sort() gives with a comparator returning the sign of (a - b) */
+	return (versus < 0 ? a->key > b->key : a->key < b->key);
+}
+
+/**
+ * Stable sort of an array of sort keys: insertion sort of short runs, then merges of
+ * runs of doubling width back and forth between the array and a scratch one.
+ * \param keys  array of keys
+ * \param tmp   scratch array of as many keys
+ * \param n     number of keys
+ * \param versus same as in list_sort()
+ */
+static void list_sortkey_merge(struct list_sortkey_s *keys, struct list_sortkey_s *tmp, unsigned int n, int versus) {
+	struct list_sortkey_s *src = keys, *dst = tmp, *swp, x;
+	unsigned int i, j, k, lo, mid, hi, w;
+
+	for (lo = 0; lo < n; lo += ACDLL_MINMERGESORTELS) {
+		hi = (n - lo > ACDLL_MINMERGESORTELS ? lo + ACDLL_MINMERGESORTELS : n);
+		for (i = lo + 1; i < hi; i++) {
+			x = keys[i];
+			for (j = i; j > lo && list_sortkey_after(&keys[j-1], &x, versus); j--)
+				keys[j] = keys[j-1];
+			keys[j] = x;
+		}
+	}
+
+	for (w = ACDLL_MINMERGESORTELS; w < n; w *= 2) {
+		for (lo = 0; lo < n; lo += 2 * w) {
+			mid = (n - lo > w ? lo + w : n);
+			hi = (n - mid > w ? mid + w : n);
+			/* on ties the left run goes first: equal keys keep their order */
+			for (i = lo, j = mid, k = lo; k < hi; k++)
+				dst[k] = (i < mid && (j >= hi || !list_sortkey_after(&src[i], &src[j], versus)) ? src[i++] : src[j++]);
+		}
+		swp = src;
+		src = dst;
+		dst = swp;
+	}
+	if (src != keys)
+		memcpy(keys, src, n * sizeof(struct list_sortkey_s));
+}
+
+int list_sort_keys(list_t *l, struct list_sortkey_s *keys, unsigned int n, int versus) {
+	struct list_sortkey_s *tmp;
+	struct list_cursor_s cur;
+	void **x;
+	unsigned int i, parts;
+
+	if (l->iter_active || n != l->numels)
+		return -1;
+
+	/* sort: only the contiguous array of keys is touched */
+	tmp = (struct list_sortkey_s *)malloc((n > 0 ? n : 1) * sizeof(struct list_sortkey_s));
+	if (tmp == NULL)
+		return -1;
+	parts = list_sort_threads(l, n);
+	if (parts > 1) {
+		list_sort_parallel(l, 1, versus, keys, tmp, n, parts);
+		memcpy(keys, tmp, n * sizeof(struct list_sortkey_s));
+	} else {
+		list_sortkey_merge(keys, tmp, n, versus);
+	}
+	free(tmp);
+
+	/* undecorate: store the elements back in the list in their new order */
+	list_cursor_rewind(l, &cur);
+	for (i = 0; (x = list_cursor_next(l, &cur)) != NULL; i++)
+		*x = keys[i].data;
+	l->locator.stale = 1;
+	list_changed_sort(l);
+
+	return 0;
+}
+
+int list_sort_radix(list_t *l, struct list_radixkey_s *keys, unsigned int n, int versus) {
+	unsigned int (*count)[1 << ACDLL_RADIX_BITS];
+	struct list_radixkey_s *tmp, *src, *dst, *t;
+	struct list_cursor_s cur;
+	void **x;
+	unsigned int i, p, d, sum, c, parts;
+	uint32_t flip = (versus < 0 ? 0 : UINT32_MAX);
+
+	if (l->iter_active || n != l->numels)
+		return -1;
+
+	tmp = (struct list_radixkey_s *)malloc((n > 0 ? n : 1) * sizeof(struct list_radixkey_s));
+	if (tmp == NULL)
+		return -1;
+
+	parts = list_sort_threads(l, n);
+	if (parts > 1) {
+		src = list_sort_radix_parallel(keys, tmp, n, flip, parts);
+		if (src == NULL) {
+			free(tmp);
+			return -1;
+		}
+	} else {
+		count = calloc(ACDLL_RADIX_PASSES, sizeof(*count));
+		if (count == NULL) {
+			free(tmp);
+			return -1;
+		}
+
+		/* count the digits of every pass at once; flipping the keys reverses the order */
+		for (i = 0; i < n; i++) {
+			uint32_t k = keys[i].key ^ flip;
+
+			for (p = 0; p < ACDLL_RADIX_PASSES; p++)
+				count[p][(k >> (p * ACDLL_RADIX_BITS)) & ((1 << ACDLL_RADIX_BITS) - 1)]++;
+		}
+
+		src = keys;
+		dst = tmp;
+		for (p = 0; p < ACDLL_RADIX_PASSES; p++) {
+			unsigned int shift = p * ACDLL_RADIX_BITS;
+
+			/* a digit shared by all the keys leaves them in their order */
+			if (n == 0 || count[p][((src[0].key ^ flip) >> shift) & ((1 << ACDLL_RADIX_BITS) - 1)] == n)
+				continue;
+			for (d = 0, sum = 0; d < (1 << ACDLL_RADIX_BITS); d++) {
+				c = count[p][d];
+				count[p][d] = sum;
+				sum += c;
+			}
+			for (i = 0; i < n; i++)
+				dst[count[p][((src[i].key ^ flip) >> shift) & ((1 << ACDLL_RADIX_BITS) - 1)]++] = src[i];
+			t = src;
+			src = dst;
+			dst = t;
+		}
+		free(count);
+	}
+
+	/* undecorate: store the elements back in the list in their new order */
+	list_cursor_rewind(l, &cur);
+	for (i = 0; (x = list_cursor_next(l, &cur)) != NULL; i++)
+		*x = src[i].data;
+	l->locator.stale = 1;
+	list_changed_sort(l);
+	if (src != keys)
+		memcpy(keys, src, n * sizeof(struct list_radixkey_s));
+	free(tmp);
+
+	return 0;
+}
+
+/**
+ * Store an element in a node, by list_sort_repair().
+ * \param l     list to operate
+ * \param lent  node
+ * \param data  element
+ */
+static inline void list_sort_repair_put(list_t *l, struct list_entry_s *lent, void *data) {
+	struct list_locator_slot_s *s;
+
+	lent->data = data;
+	if (l->locator.slots != NULL && !l->locator.stale && (s = list_locator_find(l, data)) != NULL)
+		s->node = lent;
+}
+
+int list_sort_repair(list_t *l, int versus) {
+	struct list_sortkey_s *tail, *tmp, rkey;
+	struct list_entry_s *r, *w;
+	unsigned int i, k;
+
+	if (l->iter_active || (l->attrs.comparator == NULL && l->attrs.keyer == NULL))
+		return -1;
+
+	k = l->numels - l->sorted;
+	if (k == 0)
+		return 0;
+	if (l->chunks.size > 0 || l->sorted == 0)
+		return list_sort(l, versus);
+
+	tail = (struct list_sortkey_s *)malloc(2 * (size_t)k * sizeof(struct list_sortkey_s));
+	if (tail == NULL)
+		return -1;
+	tmp = tail + k;
+
+	/* sort the appended elements on their own */
+	for (i = k, r = l->tail_sentinel->prev; i-- > 0; r = r->prev) {
+		tail[i].data = r->data;
+		tail[i].key = (l->attrs.keyer != NULL ? l->attrs.keyer(r->data) : 0);
+	}
+	if (l->attrs.keyer != NULL) {
+		list_sortkey_merge(tail, tmp, k, versus);
+	} else {
+		/* sort the data pointers alone, through the scratch half */
+		void **a = (void **)tmp, **t = (void **)tail;
+
+		for (i = 0; i < k; i++)
+			a[i] = tail[i].data;
+		list_sort_array(l, versus, a, t, k);
+		for (i = k; i-- > 0; )
+			tail[i].data = a[i];
+	}
+
+	if (l->towers != NULL) {
+		/* indexed: take the appended elements out, and insert each where a binary search puts it */
+		unsigned int lo, hi, mid;
+
+		for (i = 0; i < k; i++)
+			list_delete_at(l, l->numels - 1);
+		for (i = 0, lo = 0; i < k; i++, lo++) {
+			for (hi = l->numels; lo < hi; ) {
+				mid = lo + (hi - lo) / 2;
+				rkey.data = list_get_at(l, mid);
+				rkey.key = (l->attrs.keyer != NULL ? l->attrs.keyer(rkey.data) : 0);
+				/* on ties the appended element goes last, after the sorted ones */
+				if (l->attrs.keyer != NULL ? list_sortkey_after(&rkey, &tail[i], versus)
+						: l->attrs.comparator(rkey.data, tail[i].data) * -versus > 0)
+					hi = mid;
+				else
+					lo = mid + 1;
+			}
+			if (list_insert_at(l, tail[i].data, lo) < 0) {
+				/* out of memory: put the others back at the end, unsorted */
+				for (; i < k; i++)
+					list_append(l, tail[i].data);
+				free(tail);
+				return -1;
+			}
+		}
+		free(tail);
+		list_changed_sort(l);
+		return 0;
+	}
+
+	/* merge from the tail: r reads the sorted elements backwards, w writes every node backwards */
+	w = l->tail_sentinel->prev;
+	rkey.data = r->data;
+	rkey.key = (l->attrs.keyer != NULL ? l->attrs.keyer(r->data) : 0);
+	for (i = k; i > 0; w = w->prev) {
+		/* on ties the appended element goes last, after the sorted ones */
+		if (r != l->head_sentinel && (l->attrs.keyer != NULL ? list_sortkey_after(&rkey, &tail[i-1], versus)
+				: l->attrs.comparator(rkey.data, tail[i-1].data) * -versus > 0)) {
+			list_sort_repair_put(l, w, rkey.data);
+			r = r->prev;
+			if (r != l->head_sentinel) {
+				rkey.data = r->data;
+				rkey.key = (l->attrs.keyer != NULL ? l->attrs.keyer(r->data) : 0);
+			}
+		} else {
+			i--;
+			list_sort_repair_put(l, w, tail[i].data);
+		}
+	}
+	free(tail);
+
+	list_changed_sort(l);
+	return 0;
+}
+
+/**
+ * Compare two elements in the order list_sort() gives them.
+ * \param l     list to operate
+ * \param versus 	same as in list_sort()
+ * \param a     first element, with its key if the list has a keyer
+ * \param b     second element, with its key if the list has a keyer
+ * \return      <0 if a goes before b, >0 if a goes after b, 0 otherwise
+ */
+static inline int list_select_order(const list_t *l, int versus, const struct list_sortkey_s *a,
+		const struct list_sortkey_s *b) {
+	int c;
+
+	if (l->attrs.keyer != NULL)
+		c = (a->key > b->key) - (a->key < b->key);
+	else
+		c = l->attrs.comparator(a->data, b->data);
+
+	return (versus < 0 ? c : -c);
+}
+
+unsigned int list_select(const list_t *l, unsigned int k, int versus, void *indicator, void **out) {
+	struct list_cursor_s cur;
+	void **x;
+	struct list_sortkey_s *heap, tmp;
+	unsigned int n = 0, i, c;
+
+	if (k == 0 || (l->attrs.comparator == NULL && l->attrs.keyer == NULL))
+		return 0;
+
+	heap = (struct list_sortkey_s *)malloc(k * sizeof(struct list_sortkey_s));
+	if (heap == NULL)
+		return 0;
+
+	/* heap[0] is the selected element that goes last */
+	list_cursor_rewind(l, &cur);
+	while ((x = list_cursor_next(l, &cur)) != NULL) {
+		if (l->attrs.seeker != NULL && l->attrs.seeker(*x, indicator) == 0)
+			continue;
+
+		tmp.data = *x;
+		tmp.key = (l->attrs.keyer != NULL ? l->attrs.keyer(*x) : 0);
+
+		if (n < k) {
+			/* sift up */
+			for (i = n++; i > 0 && list_select_order(l, versus, &heap[(i-1)/2], &tmp) < 0; i = (i-1)/2)
+				heap[i] = heap[(i-1)/2];
+			heap[i] = tmp;
+		} else if (list_select_order(l, versus, &tmp, &heap[0]) < 0) {
+			/* sift down */
+			for (i = 0; (c = 2*i+1) < k; i = c) {
+				if (c+1 < k && list_select_order(l, versus, &heap[c+1], &heap[c]) > 0)
+					c++;
+				if (list_select_order(l, versus, &heap[c], &tmp) <= 0)
+					break;
+				heap[i] = heap[c];
+			}
+			heap[i] = tmp;
+		}
+	}
+
+	/* heap sort the selection: repeatedly move the one that goes last to the end */
+	for (c = n; c > 1; c--) {
+		tmp = heap[c-1];
+		heap[c-1] = heap[0];
+		for (i = 0; 2*i+1 < c-1; ) {
+			unsigned int m = 2*i+1;
+
+			if (m+1 < c-1 && list_select_order(l, versus, &heap[m+1], &heap[m]) > 0)
+				m++;
+			if (list_select_order(l, versus, &heap[m], &tmp) <= 0)
+				break;
+			heap[i] = heap[m];
+			i = m;
+		}
+		heap[i] = tmp;
+	}
+
+	for (i = 0; i < n; i++)
+		out[i] = heap[i].data;
+	free(heap);
+
+	return n;
+}
+
+/**
+ * Sort an array of elements in the order list_sort() gives them: insertion sort of
+ * short runs, then merges of runs of doubling width back and forth between the array
+ * and a scratch one. The sort is stable.
+ * \param l         list of the elements, for its comparator
+ * \param versus    same as in list_sort()
+ * \param a         array of element data pointers
+ * \param tmp       scratch array of as many pointers
+ * \param n         number of elements in a
+ */
+static void list_sort_array(const list_t *l, int versus, void **a, void **tmp, unsigned int n) {
+	void **src = a, **dst = tmp, **swp, *x;
+	unsigned int i, j, k, lo, mid, hi, w;
+
+	for (lo = 0; lo < n; lo += ACDLL_MINMERGESORTELS) {
+		hi = (n - lo > ACDLL_MINMERGESORTELS ? lo + ACDLL_MINMERGESORTELS : n);
+		for (i = lo + 1; i < hi; i++) {
+			x = a[i];
+			for (j = i; j > lo && l->attrs.comparator(a[j-1], x) * -versus > 0; j--)
+				a[j] = a[j-1];
+			a[j] = x;
+		}
+	}
+
+	for (w = ACDLL_MINMERGESORTELS; w < n; w *= 2) {
+		for (lo = 0; lo < n; lo += 2 * w) {
+			mid = (n - lo > w ? lo + w : n);
+			hi = (n - mid > w ? mid + w : n);
+			/* on ties the left run goes first: equal elements keep their order */
+			for (i = lo, j = mid, k = lo; k < hi; k++)
+				dst[k] = (i < mid && (j >= hi || l->attrs.comparator(src[i], src[j]) * -versus <= 0) ? src[i++] : src[j++]);
+		}
+		swp = src;
+		src = dst;
+		dst = swp;
+	}
+	if (src != a)
+		memcpy(a, src, n * sizeof(void *));
+}
+
+/**
+ * Number of partitions a sort of a list runs on, one per thread.
+ * \param l         list to operate
+ * \param n         number of elements to sort
+ * \return          number of partitions; 1 to sort serially
+ */
+static unsigned int list_sort_threads(const list_t *l, unsigned int n) {
+	unsigned int parts = l->attrs.threads;
+
+	if (parts > n / ACDLL_SORT_MINPART)
+		parts = n / ACDLL_SORT_MINPART;
+
+	return (parts > 1 ? parts : 1);
+}
+
+/**
+ * Sort a partition of a parallel sort, as the routine of its thread.
+ * \param arg       the partition, a struct list_sort_part_s
+ * \return          NULL
+ */
+static void *list_sort_part(void *arg) {
+	struct list_sort_part_s *p = (struct list_sort_part_s *)arg;
+
+	if (p->l != NULL)
+		list_sort_array(p->l, p->versus, (void **)p->a, (void **)p->tmp, p->n);
+	else
+		list_sortkey_merge((struct list_sortkey_s *)p->a, (struct list_sortkey_s *)p->tmp, p->n, p->versus);
+
+	return NULL;
+}
+
+/**
+ * Tell if the first element left in a partition goes before the one of another partition,
+ * for the k-way merge of a parallel sort.
+ * \param part      partitions
+ * \param i         index of the first partition
+ * \param j         index of the second partition
+ * \return          non-0 if the element of partition i goes first
+ */
+static int list_sort_part_first(const struct list_sort_part_s *part, unsigned int i, unsigned int j) {
+	const struct list_sort_part_s *p = &part[i < j ? i : j], *q = &part[i < j ? j : i];
+	int pfirst;
+
+	/* on ties the earlier partition goes first: equal elements keep their order */
+	if (p->l == NULL)
+		pfirst = !list_sortkey_after((const struct list_sortkey_s *)p->a, (const struct list_sortkey_s *)q->a, p->versus);
+	else
+		pfirst = (p->l->attrs.comparator(*(void **)p->a, *(void **)q->a) * -p->versus <= 0);
 
-	return 0;
+	return (i < j ? pfirst : !pfirst);
 }
 
-unsigned int list_size(const list_t *l) {
-	return l->numels;
+/**
+ * Restore the order of a heap of partitions from one of its nodes down.
+ * \param part      partitions
+ * \param heap      heap of the indexes of the partitions with elements left, earliest element on top
+ * \param hn        number of partitions in the heap
+ * \param i         node of the heap to sift down
+ */
+static void list_sort_heap_down(const struct list_sort_part_s *part, unsigned int *heap, unsigned int hn, unsigned int i) {
+	unsigned int c, top = heap[i];
+
+	while ((c = 2 * i + 1) < hn) {
+		if (c + 1 < hn && list_sort_part_first(part, heap[c+1], heap[c]))
+			c++;
+		if (list_sort_part_first(part, top, heap[c]))
+			break;
+		heap[i] = heap[c];
+		i = c;
+	}
+	heap[i] = top;
 }
 
-const void *list_seek(const list_t *l, void *indicator) {
-	const struct list_entry_s *iter;
+/**
+ * Sort an array of element data pointers, or of sort keys, on several threads: each
+ * sorts a partition, then the calling thread merges them, k-way, into a second array.
+ * \param l         list of the elements, for its comparator and number of threads
+ * \param keyed     true if the array is of sort keys, false if of element data pointers
+ * \param versus    same as in list_sort()
+ * \param a         array to sort
+ * \param tmp       array of as many elements, to fill with the sorted ones
+ * \param n         number of elements
+ * \param parts     number of partitions, as given by list_sort_threads()
+ * \remarks A partition whose thread could not be started is sorted on the calling one.
+ */
+static void list_sort_parallel(const list_t *l, int keyed, int versus, void *a, void *tmp, unsigned int n,
+		unsigned int parts) {
+	struct list_sort_part_s part[ACDLL_SORT_MAXTHREADS];
+	unsigned int heap[ACDLL_SORT_MAXTHREADS], hn, i, j, p;
+	size_t elsize = (keyed ? sizeof(struct list_sortkey_s) : sizeof(void *));
+	char *out = (char *)tmp;
+
+	for (i = 0, j = 0; i < parts; j += part[i].n, i++) {
+		part[i].l = (keyed ? NULL : l);
+		part[i].versus = versus;
+		part[i].a = (char *)a + j * elsize;
+		part[i].tmp = (char *)tmp + j * elsize;
+		part[i].n = n / parts + (i < n % parts ? 1 : 0);
+		part[i].threaded = 0;
+	}
 
-	if (l->attrs.seeker == NULL)
-		return NULL;
+	for (i = 1; i < parts; i++)
+		part[i].threaded = (pthread_create(&part[i].thread, NULL, list_sort_part, &part[i]) == 0);
+	list_sort_part(&part[0]);
+	for (i = 1; i < parts; i++) {
+		if (part[i].threaded)
+			pthread_join(part[i].thread, NULL);
+		else
+			list_sort_part(&part[i]);
+	}
+
+	/* k-way merge: the heap tells which partition has the next element */
+	for (hn = 0; hn < parts; hn++)
+		heap[hn] = hn;
+	for (i = hn / 2; i-- > 0; )
+		list_sort_heap_down(part, heap, hn, i);
+	while (hn > 0) {
+		p = heap[0];
+		memcpy(out, part[p].a, elsize);
+		out += elsize;
+		part[p].a = (char *)part[p].a + elsize;
+		if (--part[p].n == 0)
+			heap[0] = heap[--hn];
+		if (hn > 0)
+			list_sort_heap_down(part, heap, hn, 0);
+	}
+}
 
-	for (iter = l->head_sentinel->next; iter != l->tail_sentinel; iter = iter->next) {
-		if (l->attrs.seeker(iter->data, indicator) != 0)
-			return iter->data;
+/**
+ * Count the digits of a range of keys, or move them to their offsets, as the routine of
+ * a thread of a parallel radix sort.
+ * \param arg       the range, a struct list_radix_part_s
+ * \return          NULL
+ */
+static void *list_radix_part(void *arg) {
+	struct list_radix_part_s *p = (struct list_radix_part_s *)arg;
+	unsigned int i;
+
+	if (p->scatter) {
+		for (i = 0; i < p->n; i++)
+			p->dst[p->count[((p->src[i].key ^ p->flip) >> p->shift) & ((1 << ACDLL_RADIX_BITS) - 1)]++] = p->src[i];
+	} else {
+		memset(p->count, 0, sizeof(p->count));
+		for (i = 0; i < p->n; i++)
+			p->count[((p->src[i].key ^ p->flip) >> p->shift) & ((1 << ACDLL_RADIX_BITS) - 1)]++;
 	}
 
 	return NULL;
 }
 
-int list_sort(list_t *l, int versus) {
-	if (l->iter_active || l->attrs.comparator == NULL) /* cannot modify list in the middle of an iteration */
-		return -1;
+/**
+ * Run a step of a parallel radix sort on every range, each on its own thread.
+ * \param part      ranges
+ * \param parts     number of ranges
+ * \remarks A range whose thread could not be started is done on the calling one.
+ */
+static void list_radix_step(struct list_radix_part_s *part, unsigned int parts) {
+	unsigned int i;
 
-	if (l->numels <= 1)
-		return 0;
-	list_sort_quicksort(l, versus, 0, l->head_sentinel->next, l->numels-1, l->tail_sentinel->prev);
-	return 0;
+	for (i = 1; i < parts; i++)
+		part[i].threaded = (pthread_create(&part[i].thread, NULL, list_radix_part, &part[i]) == 0);
+	list_radix_part(&part[0]);
+	for (i = 1; i < parts; i++) {
+		if (part[i].threaded)
+			pthread_join(part[i].thread, NULL);
+		else
+			list_radix_part(&part[i]);
+	}
 }
 
-static inline void list_sort_selectionsort(list_t *l, int versus, unsigned int first, struct list_entry_s *fel,
-		unsigned int last, struct list_entry_s *lel) {
-	struct list_entry_s *cursor, *toswap, *firstunsorted;
-	void *tmpdata;
+/**
+ * LSD radix sort of an array of integer sort keys on several threads: in each pass, each
+ * thread counts the digits of a range of the keys, then moves that range to where the
+ * counts of the ranges before it leave room for it, so equal keys keep their order.
+ * \param keys      array to sort
+ * \param tmp       scratch array of as many keys
+ * \param n         number of keys
+ * \param flip      bits flipped in every key, to reverse the order
+ * \param parts     number of ranges, as given by list_sort_threads()
+ * \return          keys or tmp, whichever holds the sorted keys; NULL if out of memory
+ */
+static struct list_radixkey_s *list_sort_radix_parallel(struct list_radixkey_s *keys, struct list_radixkey_s *tmp,
+		unsigned int n, uint32_t flip, unsigned int parts) {
+	struct list_radix_part_s *part;
+	struct list_radixkey_s *src = keys, *dst = tmp, *t;
+	unsigned int i, j, p, d, sum, c;
+
+	part = (struct list_radix_part_s *)malloc(parts * sizeof(struct list_radix_part_s));
+	if (part == NULL)
+		return NULL;
+
+	for (p = 0; p < ACDLL_RADIX_PASSES; p++) {
+		for (i = 0, j = 0; i < parts; j += part[i].n, i++) {
+			part[i].src = src + j;
+			part[i].dst = dst;
+			part[i].n = n / parts + (i < n % parts ? 1 : 0);
+			part[i].flip = flip;
+			part[i].shift = p * ACDLL_RADIX_BITS;
+			part[i].scatter = 0;
+		}
+		list_radix_step(part, parts);
+
+		/* offsets: digit by digit, range by range */
+		for (d = 0, sum = 0; d < (1 << ACDLL_RADIX_BITS); d++) {
+			for (i = 0; i < parts; i++) {
+				c = part[i].count[d];
+				part[i].count[d] = sum;
+				sum += c;
+			}
+		}
+		/* a digit shared by all the keys leaves them in their order */
+		d = ((src[0].key ^ flip) >> (p * ACDLL_RADIX_BITS)) & ((1 << ACDLL_RADIX_BITS) - 1);
+		if (part[0].count[d] == 0 && (d + 1 == (1 << ACDLL_RADIX_BITS) || part[0].count[d + 1] == n))
+			continue;
+
+		for (i = 0; i < parts; i++)
+			part[i].scatter = 1;
+		list_radix_step(part, parts);
+		t = src;
+		src = dst;
+		dst = t;
+	}
+	free(part);
 
-	if (last <= first) /* <= 1-element lists are always sorted */
-		return;
+	return src;
+}
 
-	for (firstunsorted = fel; firstunsorted != lel; firstunsorted = firstunsorted->next) {
-		/* find min or max in the remainder of the list */
-		for (toswap = firstunsorted, cursor = firstunsorted->next; cursor != lel->next; cursor = cursor->next)
-			if (l->attrs.comparator(toswap->data, cursor->data) * -versus > 0)
-				toswap = cursor;
-		if (toswap != firstunsorted) { /* swap firstunsorted with toswap */
-			tmpdata = firstunsorted->data;
-			firstunsorted->data = toswap->data;
-			toswap->data = tmpdata;
+/**
+ * Merge two sorted runs of nodes, ended by a NULL next pointer.
+ * \param l         list of the nodes, for its comparator
+ * \param versus    same as in list_sort()
+ * \param a         first run, of elements that were before those of b
+ * \param alast     last node of a
+ * \param b         second run
+ * \param blast     last node of b
+ * \param last      where to store the last node of the merged run
+ * \return          the merged run; the prev pointers of all but its first node are set
+ */
+static struct list_entry_s *list_sort_merge_runs(const list_t *l, int versus, struct list_entry_s *a,
+		struct list_entry_s *alast, struct list_entry_s *b, struct list_entry_s *blast, struct list_entry_s **last) {
+	struct list_entry_s head, *tail = &head;
+
+	/* runs scattered in memory make each step wait for the next node: fetch it one step early */
+	while (a != NULL && b != NULL) {
+		/* b only goes first if a goes after it: equal elements keep their order */
+		if (l->attrs.comparator(a->data, b->data) * -versus > 0) {
+			tail->next = b;
+			b = b->next;
+			if (b != NULL)
+				__builtin_prefetch(b->next);
+		} else {
+			tail->next = a;
+			a = a->next;
+			if (a != NULL)
+				__builtin_prefetch(a->next);
 		}
+		/* the node is in cache now: set its prev pointer here rather than in another pass */
+		tail->next->prev = tail;
+		tail = tail->next;
 	}
+	/* what is left of one run goes last, as it is */
+	tail->next = (a != NULL ? a : b);
+	tail->next->prev = tail;
+	*last = (a != NULL ? alast : blast);
+
+	return head.next;
 }
 
 /**
- * start an iteration session.
- *
- * This function prepares the list to be iterated.
+ * Sort the nodes of a list by relinking them: a stable, bottom-up merge sort.
  *
- * \param l     	list to operate
- * \param versus 	- positive: order small to big(Ascendent); 
- * 					- negative: order big to small(Descendent)
- * \param first		fist index position
- * \param fel		first element
- * \param last		last index position
- * \param lel		last element
+ * \remarks The nodes are taken in order and merged into pending runs, one of each power
+ * of two of elements, like the carries of a binary counter; no element data moves and
+ * no memory is allocated. The towers of the position index stay at their positions:
+ * they are moved onto the nodes now there in one last pass, which also finds the mid
+ * pointer; without towers it stops at the mid pointer.
  *
- * \see list_sort
+ * \param l         list to operate
+ * \param versus    same as in list_sort()
  */
-static void list_sort_quicksort(list_t *l, int versus, unsigned int first, struct list_entry_s *fel, unsigned int last,
-		struct list_entry_s *lel) {
-	unsigned int pivotid;
-	unsigned int i;
-	register struct list_entry_s *pivot;
-	struct list_entry_s *left, *right;
-	void *tmpdata;
-
-	if (last <= first) /* <= 1-element lists are always sorted */
-		return;
-
-	if (last - first+1 <= ACDLL_MINQUICKSORTELS) {
-		list_sort_selectionsort(l, versus, first, fel, last, lel);
-		return;
+static void list_sort_merge(list_t *l, int versus) {
+	struct list_entry_s *bins[ACDLL_MERGE_BINS], *binlast[ACDLL_MERGE_BINS], *run, *last, *x, *next;
+	struct list_tower_s *t;
+	unsigned int i, top = 0, pos, tpos;
+
+	/* bins[i] is empty or a sorted run of 2^i elements, older than those of bins[i-1] */
+	l->tail_sentinel->prev->next = NULL;
+	for (x = l->head_sentinel->next; x != NULL; x = next) {
+		next = x->next;
+		x->next = NULL;
+		run = last = x;
+		for (i = 0; i < top && bins[i] != NULL; i++) {
+			run = list_sort_merge_runs(l, versus, bins[i], binlast[i], run, last, &last);
+			bins[i] = NULL;
+		}
+		if (i == top)
+			top++;
+		bins[i] = run;
+		binlast[i] = last;
+	}
+	for (run = NULL, i = 0; i < top; i++) {
+		if (bins[i] == NULL)
+			continue;
+		if (run == NULL) {
+			run = bins[i];
+			last = binlast[i];
+		} else {
+			run = list_sort_merge_runs(l, versus, bins[i], binlast[i], run, last, &last);
+		}
 	}
 
-	/* base of iteration: one element list */
-	if (! (last > first))
-		return;
-
-	pivotid = (random() % (last - first + 1));
-	/* pivotid = (last - first + 1) / 2; */
+	l->head_sentinel->next = run;
+	run->prev = l->head_sentinel;
+	last->next = l->tail_sentinel;
+	l->tail_sentinel->prev = last;
 
-	/* find pivot */
-	if (pivotid < (last - first + 1)/2) {
-		for (i = 0, pivot = fel; i < pivotid; pivot = pivot->next, i++)
-			;
-	} else {
-		for (i = last - first, pivot = lel; i > pivotid; pivot = pivot->prev, i--)
+	if (l->towers == NULL) {
+		for (pos = 0, x = run; pos < (l->numels - 1) / 2; x = x->next, pos++)
 			;
+		l->mid_sentinel = x;
+		return;
 	}
 
-	/* smaller PIVOT bigger */
-	left = fel;
-	right = lel;
-	/* iterate     --- left ---> PIV <--- right --- */
-	while (left != pivot && right != pivot) {
-		for (; left != pivot && (l->attrs.comparator(left->data, pivot->data) * -versus <= 0); left = left->next)
-			;
-		/* left points to a smaller element, or to pivot */
-		for (; right != pivot && (l->attrs.comparator(right->data, pivot->data) * -versus >= 0); right = right->prev)
-			;
-		/* right points to a bigger element, or to pivot */
-		if (left != pivot && right != pivot) {
-			/* swap, then move iterators */
-			tmpdata = left->data;
-			left->data = right->data;
-			right->data = tmpdata;
-
-			left = left->next;
-			right = right->prev;
-		}
-	}
-
-	/* now either left points to pivot (end run), or right */
-	if (right == pivot) { /* left part longer */
-		while (left != pivot) {
-			if (l->attrs.comparator(left->data, pivot->data) * -versus > 0) {
-				tmpdata = left->data;
-				left->data = pivot->prev->data;
-				pivot->prev->data = pivot->data;
-				pivot->data = tmpdata;
-				pivot = pivot->prev;
-				pivotid--;
-				if (pivot == left)
-					break;
-			} else {
-				left = left->next;
-			}
-		}
-	} else { /* right part longer */
-		while (right != pivot) {
-			if (l->attrs.comparator(right->data, pivot->data) * -versus < 0) {
-				/* move current right before pivot */
-				tmpdata = right->data;
-				right->data = pivot->next->data;
-				pivot->next->data = pivot->data;
-				pivot->data = tmpdata;
-				pivot = pivot->next;
-				pivotid++;
-				if (pivot == right)
-					break;
-			} else {
-				right = right->prev;
-			}
+	t = l->towers->link[0].next;
+	tpos = l->towers->link[0].width - 1;
+	for (pos = 0, x = run; x != l->tail_sentinel; x = x->next, pos++) {
+		if (pos == (l->numels - 1) / 2)
+			l->mid_sentinel = x;
+		if (t != NULL && pos == tpos) {
+			/* the tower at this position now stands on this node */
+			t->node = x;
+			x->tower = t;
+			tpos += t->link[0].width;
+			t = t->link[0].next;
+		} else {
+			x->tower = NULL;
 		}
 	}
-
-	/* sort sublists A and B :       |---A---| pivot |---B---| */
-
-	if (pivotid > 0)
-		list_sort_quicksort(l, versus, first, fel, first+pivotid-1, pivot->prev);
-	if (first + pivotid < last)
-		list_sort_quicksort(l, versus, first+pivotid+1, pivot->next, last, lel);
-
 }
 
 int list_iterator_start(list_t *l) {
@@ -457,21 +2265,22 @@ int list_iterator_start(list_t *l) {
 		return 0;
 	l->iter_pos = 0;
 	l->iter_active = 1;
-	l->iter_curentry = l->head_sentinel->next;
+	list_cursor_rewind(l, &l->iter_cursor);
 	return 1;
 }
 
 void *list_iterator_next(list_t *l) {
-	void *toret;
+	void **x;
 
 	if (!l->iter_active)
 		return NULL;
 
-	toret = l->iter_curentry->data;
-	l->iter_curentry = l->iter_curentry->next;
+	x = list_cursor_next(l, &l->iter_cursor);
+	if (x == NULL)
+		return NULL;
 	l->iter_pos++;
 
-	return toret;
+	return *x;
 }
 
 int list_iterator_hasnext(const list_t *l) {
@@ -489,6 +2298,148 @@ int list_iterator_stop(list_t *l) {
 }
 
 
+/**
+ * Write all the pieces of a dump writer.
+ * \param w     writer to operate
+ * \return      0 for success. -1 for failure
+ */
+static int list_dump_flush(struct list_dump_writer_s *w) {
+	struct iovec *iov = w->iov;
+	int iovcnt = w->iovcnt;
+	ssize_t rt;
+
+	while (iovcnt > 0 && !w->error) {
+		rt = writev(w->fd, iov, iovcnt);
+		if (rt < 0) {
+			if (errno == EINTR)
+				continue;
+			w->error = 1;
+			break;
+		}
+		/* skip what was written, in case of a short write */
+		while (iovcnt > 0 && (size_t)rt >= iov->iov_len) {
+			rt -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = (char *)iov->iov_base + rt;
+			iov->iov_len -= rt;
+		}
+	}
+
+	w->iovcnt = 0;
+	w->pending = 0;
+	w->used = 0;
+
+	return (w->error ? -1 : 0);
+}
+
+/**
+ * Add a piece to a dump writer.
+ * \param w         writer to operate
+ * \param data      data of the piece
+ * \param len       length of the piece
+ * \param stable    true if data stays valid until the next flush, so it is not copied
+ * \return          0 for success. -1 for failure
+ */
+static int list_dump_put(struct list_dump_writer_s *w, const void *data, size_t len, int stable) {
+	/* small pieces are cheaper to copy than to spend a piece of the writev() on */
+	if (len < w->size / ACDLL_DUMP_IOVMAX)
+		stable = 0;
+
+	if (!stable && len > w->size - w->used) {
+		if (list_dump_flush(w) != 0)
+			return -1;
+		/* too big for the buffer: write it on its own */
+		stable = (len > w->size);
+	}
+	if (w->iovcnt == ACDLL_DUMP_IOVMAX && list_dump_flush(w) != 0)
+		return -1;
+
+	if (stable) {
+		w->iov[w->iovcnt].iov_base = (void *)data;
+		w->iov[w->iovcnt].iov_len = len;
+		w->iovcnt++;
+	} else {
+		char *dst = w->buf + w->used;
+
+		memcpy(dst, data, len);
+		w->used += len;
+		/* grow the last piece if it ends where this one starts */
+		if (w->iovcnt > 0 && (char *)w->iov[w->iovcnt - 1].iov_base + w->iov[w->iovcnt - 1].iov_len == dst) {
+			w->iov[w->iovcnt - 1].iov_len += len;
+		} else {
+			w->iov[w->iovcnt].iov_base = dst;
+			w->iov[w->iovcnt].iov_len = len;
+			w->iovcnt++;
+		}
+	}
+	w->pending += len;
+
+	if (w->pending >= w->size)
+		return list_dump_flush(w);
+
+	return 0;
+}
+
+/**
+ * Drop the pieces of a dump writer not yet written.
+ * \param w     writer to operate
+ */
+static void list_dump_discard(struct list_dump_writer_s *w) {
+	w->iovcnt = 0;
+	w->pending = 0;
+	w->used = 0;
+}
+
+/**
+ * Prepare the header of a dump, with no elements.
+ * \param header    header to fill, in network byte order
+ */
+static void list_dump_header_init(struct list_dump_header_s *header) {
+	struct timeval timeofday;
+
+	/* version */
+	header->ver = htons( ACDLL_DUMPFORMAT_VERSION);
+
+	/* timestamp */
+	gettimeofday(&timeofday, NULL);
+	header->timestamp = (int64_t)timeofday.tv_sec * 1000000 + (int64_t)timeofday.tv_usec;
+
+	header->rndterm = htonl((int32_t)random());
+	header->listhash = htonl(0);
+	header->totlistlen = header->numels = header->elemlen = 0;
+}
+
+/**
+ * Write the header of a dump at the beginning of its file, in one piece.
+ * \param fd        file descriptor
+ * \param header    header to write, in network byte order
+ * \return          0 for success. -1 for failure
+ */
+static int list_dump_header_write(int fd, const struct list_dump_header_s *header) {
+	char head[ACDLL_DUMPFORMAT_HEADERLEN], *p;
+
+	p = head;
+	memcpy(p, &header->ver, sizeof(header->ver)); /* version */
+	p += sizeof(header->ver);
+	memcpy(p, &header->timestamp, sizeof(header->timestamp)); /* timestamp */
+	p += sizeof(header->timestamp);
+	memcpy(p, &header->rndterm, sizeof(header->rndterm)); /* random terminator */
+	p += sizeof(header->rndterm);
+
+	memcpy(p, &header->totlistlen, sizeof(header->totlistlen)); /* total length of elements */
+	p += sizeof(header->totlistlen);
+	memcpy(p, &header->numels, sizeof(header->numels)); /* number of elements */
+	p += sizeof(header->numels);
+	memcpy(p, &header->elemlen, sizeof(header->elemlen)); /* size of each element, or 0 for independent */
+	p += sizeof(header->elemlen);
+	memcpy(p, &header->listhash, sizeof(header->listhash)); /* list hash, or 0 for "ignore" */
+
+	return (pwrite(fd, head, sizeof(head), 0) == (ssize_t)sizeof(head) ? 0 : -1);
+}
+
 /**
  * Dump the heather descriptor to a file name.
  * \param l     list to operate
@@ -503,39 +2454,37 @@ int list_iterator_stop(list_t *l) {
  * -# for other lists (element size dictated by element_meter each time; elemlen <= 0) \n
  * [ size elem     size elem       ...     size elem ]
  *
- * \remarks all integers are encoded in long long
+ * \remarks the integers of the header and the element sizes are in network byte order.
+ * Version 1 wrote the element sizes as host size_t. \n
+ * The content is staged in a buffer of the size set by list_attributes_dump_buffer() and
+ * written with writev(); the header is written last, with a single pwrite().
  */
 size_t list_dump_filedescriptor(const list_t *l, int fd) {
-	struct list_entry_s *x;
+	struct list_cursor_s cur;
+	void **x;
 	void *ser_buf;
-	uint32_t bufsize;
-	struct timeval timeofday;
+	uint32_t bufsize, netsize;
 	struct list_dump_header_s header;
+	struct list_dump_writer_s w;
 
 	if (l->attrs.meter == NULL && l->attrs.serializer == NULL)
 		return 0;
 
+	w.fd = fd;
+	w.size = l->attrs.dump_bufsize;
+	w.used = w.pending = 0;
+	w.iovcnt = 0;
+	w.error = 0;
+	w.buf = (char *)malloc(w.size);
+	if (w.buf == NULL)
+		return 0;
 
-	/* prepare HEADER */
-	/* version */
-	header.ver = htons( ACDLL_DUMPFORMAT_VERSION);
-
-	/* timestamp */
-	gettimeofday(&timeofday, NULL);
-	header.timestamp = (int64_t)timeofday.tv_sec * 1000000 + (int64_t)timeofday.tv_usec;
-	header.timestamp = (long long)(header.timestamp);
-
-	header.rndterm = htonl((int32_t)random());
-
-	/* total list size is postprocessed afterwards */
+	/* prepare HEADER; total list size is postprocessed afterwards */
+	list_dump_header_init(&header);
 
 	/* number of elements */
 	header.numels = htonl(l->numels);
 
-	header.listhash = htonl(0);
-
-	header.totlistlen = header.elemlen = 0;
-
 	/* leave room for the header at the beginning of the file */
 	lseek(fd, ACDLL_DUMPFORMAT_HEADERLEN, SEEK_SET);
 
@@ -544,11 +2493,12 @@ size_t list_dump_filedescriptor(const list_t *l, int fd) {
 		/* SPECULATE that the list has constant element size */
 
 		if (l->attrs.serializer != NULL) { /* user user-specified serializer */
-			ser_buf = l->attrs.serializer(l->head_sentinel->next->data, &header.elemlen);
+			ser_buf = l->attrs.serializer(list_get_at(l, 0), &header.elemlen);
 			free(ser_buf);
 			/* request custom serialization of each element */
-			for (x = l->head_sentinel->next; x != l->tail_sentinel; x = x->next) {
-				ser_buf = l->attrs.serializer(x->data, &bufsize);
+			list_cursor_rewind(l, &cur);
+			while ((x = list_cursor_next(l, &cur)) != NULL) {
+				ser_buf = l->attrs.serializer(*x, &bufsize);
 				header.totlistlen += bufsize;
 				if (header.elemlen != 0) { /* continue on speculation */
 					if (header.elemlen != bufsize) {
@@ -556,38 +2506,45 @@ size_t list_dump_filedescriptor(const list_t *l, int fd) {
 						/* constant element length speculation broken! */
 						header.elemlen = 0;
 						header.totlistlen = 0;
-						x = l->head_sentinel;
 						/* restart from the beginning */
+						list_cursor_rewind(l, &cur);
+						list_dump_discard(&w);
+						lseek(fd, ACDLL_DUMPFORMAT_HEADERLEN, SEEK_SET);
 						continue;
 					}
 					/* speculation confirmed */
-					write(fd, ser_buf, bufsize);
+					list_dump_put(&w, ser_buf, bufsize, 0);
 				} else { /* speculation found broken */
-					write(fd, &bufsize, sizeof(size_t));
-					write(fd, ser_buf, bufsize);
+					netsize = htonl(bufsize);
+					list_dump_put(&w, &netsize, sizeof(netsize), 0);
+					list_dump_put(&w, ser_buf, bufsize, 0);
 				}
 				free(ser_buf);
 			}
 		} else if (l->attrs.meter != NULL) {
-			header.elemlen = (uint32_t)l->attrs.meter(l->head_sentinel->next->data);
+			header.elemlen = (uint32_t)l->attrs.meter(list_get_at(l, 0));
 
-			/* serialize the element straight from its data */
-			for (x = l->head_sentinel->next; x != l->tail_sentinel; x = x->next) {
-				bufsize = l->attrs.meter(x->data);
+			/* serialize the element straight from its data, which stays put until flushed */
+			list_cursor_rewind(l, &cur);
+			while ((x = list_cursor_next(l, &cur)) != NULL) {
+				bufsize = l->attrs.meter(*x);
 				header.totlistlen += bufsize;
 				if (header.elemlen != 0) {
 					if (header.elemlen != bufsize) {
 						/* constant element length speculation broken! */
 						header.elemlen = 0;
 						header.totlistlen = 0;
-						x = l->head_sentinel;
 						/* restart from the beginning */
+						list_cursor_rewind(l, &cur);
+						list_dump_discard(&w);
+						lseek(fd, ACDLL_DUMPFORMAT_HEADERLEN, SEEK_SET);
 						continue;
 					}
-					write(fd, x->data, bufsize);
+					list_dump_put(&w, *x, bufsize, 1);
 				} else {
-					write(fd, &bufsize, sizeof(size_t));
-					write(fd, x->data, bufsize);
+					netsize = htonl(bufsize);
+					list_dump_put(&w, &netsize, sizeof(netsize), 0);
+					list_dump_put(&w, *x, bufsize, 1);
 				}
 			}
 		}
@@ -597,141 +2554,274 @@ size_t list_dump_filedescriptor(const list_t *l, int fd) {
 	}
 
 	/* write random terminator */
-	write(fd, &header.rndterm, sizeof(header.rndterm)); /* list terminator */
+	list_dump_put(&w, &header.rndterm, sizeof(header.rndterm), 0); /* list terminator */
+	list_dump_flush(&w);
+	free(w.buf);
 
-	/* write header */
-	lseek(fd, 0, SEEK_SET);
+	if (w.error || list_dump_header_write(fd, &header) != 0)
+		return 0;
 
-	write(fd, &header.ver, sizeof(header.ver)); /* version */
-	write(fd, &header.timestamp, sizeof(header.timestamp)); /* timestamp */
-	write(fd, &header.rndterm, sizeof(header.rndterm)); /* random terminator */
+	return ntohl(header.totlistlen);
+}
 
-	write(fd, &header.totlistlen, sizeof(header.totlistlen)); /* total length of elements */
-	write(fd, &header.numels, sizeof(header.numels)); /* number of elements */
-	write(fd, &header.elemlen, sizeof(header.elemlen)); /* size of each element, or 0 for independent */
-	write(fd, &header.listhash, sizeof(header.listhash)); /* list hash, or 0 for "ignore" */
+int list_dump_stream_open(struct list_dump_stream_s *s, int fd, size_t bufsize) {
+	struct list_dump_writer_s *w;
 
-	return ntohl(header.totlistlen);
+	if (bufsize == 0)
+		bufsize = ACDLL_DUMP_BUFSIZE;
+	w = (struct list_dump_writer_s *)malloc(sizeof(struct list_dump_writer_s));
+	s->header = (struct list_dump_header_s *)malloc(sizeof(struct list_dump_header_s));
+	if (w == NULL || s->header == NULL || (w->buf = (char *)malloc(bufsize)) == NULL) {
+		free(w);
+		free(s->header);
+		return -1;
+	}
+	w->fd = fd;
+	w->size = bufsize;
+	w->used = w->pending = 0;
+	w->iovcnt = 0;
+	w->error = 0;
+	list_dump_header_init(s->header);
+
+	s->writer = w;
+	s->numels = 0;
+	s->totlistlen = 0;
+
+	/* leave room for the header at the beginning of the file */
+	if (lseek(fd, ACDLL_DUMPFORMAT_HEADERLEN, SEEK_SET) < 0)
+		w->error = 1;
+
+	return (w->error ? -1 : 0);
+}
+
+int list_dump_stream_put(struct list_dump_stream_s *s, const void *data, unsigned int len) {
+	uint32_t netsize = htonl(len);
+
+	if (list_dump_put(s->writer, &netsize, sizeof(netsize), 0) != 0 || list_dump_put(s->writer, data, len, 0) != 0)
+		return -1;
+	s->numels++;
+	s->totlistlen += len;
+
+	return 0;
+}
+
+int list_dump_stream_close(struct list_dump_stream_s *s) {
+	struct list_dump_writer_s *w = s->writer;
+	struct list_dump_header_s *header = s->header;
+	int rt;
+
+	/* elements of varying size: no element length in the header */
+	header->numels = htonl(s->numels);
+	header->totlistlen = htonl(s->totlistlen);
+	header->elemlen = 0;
+
+	list_dump_put(w, &header->rndterm, sizeof(header->rndterm), 0); /* list terminator */
+	list_dump_flush(w);
+	rt = (w->error || list_dump_header_write(w->fd, header) != 0 ? -1 : 0);
+
+	free(w->buf);
+	free(w);
+	free(header);
+	s->writer = NULL;
+	s->header = NULL;
+
+	return rt;
 }
 
 /**
- * Read the heather descriptor to a file name.
+ * Read a 32 bit integer in network byte order from a dump in memory.
+ * \param p     position to read, advanced past the integer
+ * \param end   end of the dump
+ * \param v     integer to fill
+ * \return      0 for success. -1 if the dump ends before
+ */
+static int list_mapped_uint32(const unsigned char **p, const unsigned char *end, uint32_t *v) {
+	if (end - *p < (ptrdiff_t)sizeof(*v))
+		return -1;
+	memcpy(v, *p, sizeof(*v));
+	*v = ntohl(*v);
+	*p += sizeof(*v);
+
+	return 0;
+}
+
+/**
+ * Take the next bytes of a dump from a reader.
+ * \param r     reader to operate
+ * \param n     number of bytes
+ * \return      the bytes, valid until the next call, or NULL if the dump ends before
+ */
+static const unsigned char *list_restore_take(struct list_restore_reader_s *r, size_t n) {
+	const unsigned char *p;
+	unsigned char *tmp;
+	ssize_t rt;
+
+	if (r->len - r->pos < n) {
+		if (r->fd < 0)
+			return NULL;
+
+		/* keep the bytes not served yet, and refill the rest of the buffer */
+		memmove(r->buf, r->buf + r->pos, r->len - r->pos);
+		r->len -= r->pos;
+		r->pos = 0;
+		if (n > r->size) {
+			tmp = (unsigned char *)realloc(r->buf, n);
+			if (tmp == NULL)
+				return NULL;
+			r->buf = tmp;
+			r->size = n;
+		}
+		while (r->len < n) {
+			rt = read(r->fd, r->buf + r->len, r->size - r->len);
+			if (rt < 0 && errno == EINTR)
+				continue;
+			if (rt <= 0)
+				return NULL;
+			r->len += rt;
+		}
+	}
+
+	p = r->buf + r->pos;
+	r->pos += n;
+
+	return p;
+}
+
+/**
+ * Link the nodes of the elements restored at the end of a list, in one pass.
  * \param l     list to operate
- * \param fd    file discriptor
+ * \param nodes array of the nodes, with their data set
+ * \param n     number of nodes
+ */
+static void list_restore_link(list_t *l, struct list_entry_s *nodes, unsigned int n) {
+	struct list_entry_s *prec = l->tail_sentinel->prev;
+	unsigned int i;
+
+	if (n == 0)
+		return;
+
+	for (i = 0; i < n; i++) {
+		nodes[i].prev = (i == 0 ? prec : &nodes[i - 1]);
+		nodes[i].next = (i == n - 1 ? l->tail_sentinel : &nodes[i + 1]);
+	}
+	prec->next = &nodes[0];
+	l->tail_sentinel->prev = &nodes[n - 1];
+
+	/* fix mid pointer: it is the element at (numels-1)/2 */
+	if (l->numels == 0) {
+		l->mid_sentinel = &nodes[(n - 1) / 2];
+	} else if (l->mid_sentinel != NULL) {
+		for (i = (l->numels - 1) / 2; i < (l->numels + n - 1) / 2; i++)
+			l->mid_sentinel = l->mid_sentinel->next;
+	}
+	l->numels += n;
+	/* restored elements are appended */
+	l->generation++;
+}
+
+/**
+ * Restore the list from a dump.
+ * \param l     list to operate
+ * \param r     reader of the dump
  * \return the number of bytes read into memory
  *
  * \see list_dump_filedescriptor
  */
-size_t list_restore_filedescriptor(list_t *l, int fd) {
+static size_t list_restore_reader(list_t *l, struct list_restore_reader_s *r) {
 	struct list_dump_header_s header;
+	struct list_entry_s *nodes = NULL;
+	const unsigned char *p, *end;
 	unsigned long cnt;
-	void *buf;
-	uint32_t elsize, totreadlen, totmemorylen;
-
-	memset(&header, 0, sizeof(header));
+	uint32_t len, elsize, totreadlen, totmemorylen;
+	size_t oldsize;
+	void *el;
 
-	/* read header */
+	if (l->iter_active)
+		return 0;
 
-	/* version */
-	if (read(fd, &header.ver, sizeof(header.ver)) != sizeof(header.ver))
+	/* read header, with the same layout written by list_dump_filedescriptor() */
+	p = list_restore_take(r, ACDLL_DUMPFORMAT_HEADERLEN);
+	if (p == NULL) {
+		errno = EPROTO;
 		return 0;
+	}
+	end = p + ACDLL_DUMPFORMAT_HEADERLEN;
+	memcpy(&header.ver, p, sizeof(header.ver));
 	header.ver = ntohs(header.ver);
-	if (header.ver != ACDLL_DUMPFORMAT_VERSION) {
+	if (header.ver < ACDLL_DUMPFORMAT_MINVERSION || header.ver > ACDLL_DUMPFORMAT_VERSION) {
 		errno = EILSEQ;
 		return 0;
 	}
-
-	/* timestamp */
-	if (read(fd, &header.timestamp, sizeof(header.timestamp)) != sizeof(header.timestamp))
-		return 0;
-
-	/* list terminator */
-	if (read(fd, &header.rndterm, sizeof(header.rndterm)) != sizeof(header.rndterm))
-		return 0;
-
-	header.rndterm = ntohl(header.rndterm);
-
-	/* total list size */
-	if (read(fd, &header.totlistlen, sizeof(header.totlistlen)) != sizeof(header.totlistlen))
-		return 0;
-	header.totlistlen = ntohl(header.totlistlen);
-
-	/* number of elements */
-	if (read(fd, &header.numels, sizeof(header.numels)) != sizeof(header.numels))
-		return 0;
-	header.numels = ntohl(header.numels);
-
-	/* length of every element, or '0' = variable */
-	if (read(fd, &header.elemlen, sizeof(header.elemlen)) != sizeof(header.elemlen))
-		return 0;
-	header.elemlen = ntohl(header.elemlen);
-
-	/* list hash, or 0 = 'ignore' */
-	if (read(fd, &header.listhash, sizeof(header.listhash)) != sizeof(header.listhash))
-		return 0;
-	header.listhash = ntohl(header.listhash);
+	p += sizeof(header.ver);
+	memcpy(&header.timestamp, p, sizeof(header.timestamp));
+	p += sizeof(header.timestamp);
+	list_mapped_uint32(&p, end, (uint32_t *)&header.rndterm);
+	list_mapped_uint32(&p, end, &header.totlistlen);
+	list_mapped_uint32(&p, end, &header.numels);
+	list_mapped_uint32(&p, end, &header.elemlen);
+	list_mapped_uint32(&p, end, (uint32_t *)&header.listhash);
+
+	l->restore_version = header.ver;
+
+	/* one block for all the nodes, and room for all the element data after it; chunked
+	 * lists just append the elements */
+	if (header.numels > 0 && l->chunks.size == 0) {
+		nodes = (struct list_entry_s *)list_arena_alloc(l, (size_t)header.numels * sizeof(struct list_entry_s));
+		if (nodes == NULL)
+			return 0;
+		/* just a hint: unserializers may take less, or more */
+		list_arena_reserve(l, (size_t)header.totlistlen + (size_t)header.numels * ACDLL_ARENA_ALIGN);
+	}
 
 	/* read content */
 	totreadlen = totmemorylen = 0;
-	if (header.elemlen > 0) {
-		/* elements have constant size = header.elemlen */
-		if (l->attrs.unserializer != NULL) {
-			/* use unserializer */
-			buf = malloc(header.elemlen);
-			for (cnt = 0; cnt < header.numels; cnt++) {
-				if (read(fd, buf, header.elemlen) != (ssize_t)header.elemlen) {
-					errno = EPROTO;
-					return 0;
-				}
-				list_append(l, l->attrs.unserializer(buf, &elsize));
-				totmemorylen += elsize;
-			}
+	for (cnt = 0; cnt < header.numels; cnt++) {
+		if (header.elemlen > 0) {
+			/* elements have constant size = header.elemlen */
+			len = header.elemlen;
+		} else if (header.ver == 1) {
+			/* version 1 preceded each element by its size as a host size_t */
+			if ((p = list_restore_take(r, sizeof(oldsize))) == NULL)
+				break;
+			memcpy(&oldsize, p, sizeof(oldsize));
+			len = (uint32_t)oldsize;
 		} else {
-			/* copy verbatim into memory */
-			for (cnt = 0; cnt < header.numels; cnt++) {
-				buf = malloc(header.elemlen);
-				if (read(fd, buf, header.elemlen) != (ssize_t)header.elemlen) {
-					errno = EPROTO;
-					return 0;
-				}
-				list_append(l, buf);
-			}
-			totmemorylen = header.numels * header.elemlen;
+			/* elements have variable size. Each element is preceded by its size */
+			if ((p = list_restore_take(r, sizeof(len))) == NULL)
+				break;
+			memcpy(&len, p, sizeof(len));
+			len = ntohl(len);
 		}
-		totreadlen = header.numels * header.elemlen;
-	} else {
-		/* elements have variable size. Each element is preceded by its size */
+		if ((p = list_restore_take(r, len)) == NULL)
+			break;
+
+		elsize = len;
 		if (l->attrs.unserializer != NULL) {
-			/* use unserializer */
-			for (cnt = 0; cnt < header.numels; cnt++) {
-				read(fd, &elsize, sizeof(elsize));
-				buf = malloc((size_t)elsize);
-				if (read(fd, buf, elsize) != (ssize_t)elsize) {
-					errno = EPROTO;
-					return 0;
-				}
-				totreadlen += elsize;
-				list_append(l, l->attrs.unserializer(buf, &elsize));
-				totmemorylen += elsize;
-			}
+			el = l->attrs.unserializer(p, &elsize);
 		} else {
 			/* copy verbatim into memory */
-			for (cnt = 0; cnt < header.numels; cnt++) {
-				read(fd, &elsize, sizeof(elsize));
-				buf = malloc(elsize);
-				if (read(fd, buf, elsize) != (ssize_t)elsize) {
-					errno = EPROTO;
-					return 0;
-				}
-				totreadlen += elsize;
-				list_append(l, buf);
-			}
-			totmemorylen = totreadlen;
+			el = list_arena_alloc(l, len);
+			if (el != NULL)
+				memcpy(el, p, len);
 		}
+		if (el == NULL)
+			break;
+		if (nodes != NULL)
+			nodes[cnt].data = el;
+		else if (list_chunk_insert(l, el, l->numels) < 0)
+			break;
+		totreadlen += len;
+		totmemorylen += elsize;
+	}
+	if (nodes != NULL) {
+		list_restore_link(l, nodes, cnt);
+		if (l->towers != NULL) {
+			list_index_drop(l);
+			list_index_build(l);
+		}
+		/* the locator catches up on its next lookup */
+		l->locator.stale = 1;
 	}
-
-	read(fd, &elsize, sizeof(elsize)); /* read list terminator */
-	elsize = ntohl(elsize);
 
 	/* possibly verify the list consistency */
 	/* wrt hash */
@@ -742,19 +2832,93 @@ size_t list_restore_filedescriptor(list_t *l, int fd) {
 	 }
 	 */
 
-	/* wrt header */
-	if (totreadlen != header.totlistlen && (int32_t)elsize == header.rndterm) {
+	/* wrt header and file: only the list terminator is left */
+	if (cnt < header.numels || totreadlen != header.totlistlen
+			|| list_restore_take(r, sizeof(header.rndterm)) == NULL || list_restore_take(r, 1) != NULL) {
 		errno = EPROTO;
 		return 0;
 	}
 
-	/* wrt file */
-	if (lseek(fd, 0, SEEK_CUR) != lseek(fd, 0, SEEK_END)) {
+	return totmemorylen;
+}
+
+/**
+ * Read the heather descriptor to a file name.
+ * \param l     list to operate
+ * \param fd    file discriptor
+ * \return the number of bytes read into memory
+ *
+ * \see list_dump_filedescriptor
+ */
+size_t list_restore_filedescriptor(list_t *l, int fd) {
+	struct list_restore_reader_s r;
+	size_t rt;
+
+	r.fd = fd;
+	r.size = l->attrs.dump_bufsize;
+	r.len = r.pos = 0;
+	r.buf = (unsigned char *)malloc(r.size);
+	if (r.buf == NULL)
+		return 0;
+
+	rt = list_restore_reader(l, &r);
+	free(r.buf);
+
+	return rt;
+}
+
+size_t list_restore_mmap(list_t *l, const char *filename, struct list_mapping_s *map) {
+	struct list_restore_reader_s r;
+	struct stat st;
+	void *addr;
+	size_t rt;
+	int fd;
+
+	map->addr = NULL;
+	map->len = 0;
+
+	fd = open(filename, O_RDONLY, 0);
+	if (fd < 0)
+		return 0;
+	if (fstat(fd, &st) != 0 || st.st_size < ACDLL_DUMPFORMAT_HEADERLEN) {
+		close(fd);
 		errno = EPROTO;
 		return 0;
 	}
+	addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (addr == MAP_FAILED)
+		return 0;
+	madvise(addr, (size_t)st.st_size, MADV_SEQUENTIAL);
+	map->addr = addr;
+	map->len = (size_t)st.st_size;
 
-	return totmemorylen;
+	/* the whole dump is already in memory */
+	r.fd = -1;
+	r.buf = (unsigned char *)addr;
+	r.size = r.len = map->len;
+	r.pos = 0;
+
+	l->restore_mapped = 1;
+	rt = list_restore_reader(l, &r);
+	l->restore_mapped = 0;
+
+	return rt;
+}
+
+void list_mapping_release(struct list_mapping_s *map) {
+	if (map->addr != NULL)
+		munmap(map->addr, map->len);
+	map->addr = NULL;
+	map->len = 0;
+}
+
+int list_restore_mapped(const list_t *l) {
+	return l->restore_mapped;
+}
+
+unsigned int list_restore_version(const list_t *l) {
+	return l->restore_version;
 }
 
 size_t list_dump_file(const list_t *l, const char *filename) {
@@ -791,29 +2955,29 @@ size_t list_restore_file(list_t *l, const char *filename) {
  * Deletes tmp from list, with care write its position (head, tail, middle) 
  * \param l     list to operate
  * \param tmp   pointer to temporary element
- * \param pos   [0,size-1] position index
+ * \param pos   [0,size-1] position index, or UINT_MAX if unknown
  */
 static int list_drop_elem(list_t *l, struct list_entry_s *tmp, unsigned int pos) {
 	if (tmp == NULL)
 		return -1;
 
-	/* fix mid pointer */
-	if (l->numels % 2) { /* now odd */
-		if (pos >= l->numels/2)
-			l->mid_sentinel = l->mid_sentinel->prev;
-	} else { /* now even */
-		if (pos < l->numels/2)
-			l->mid_sentinel = l->mid_sentinel->next;
+	/* fix mid pointer; without the position of tmp it is no longer known */
+	if (pos == UINT_MAX) {
+		l->mid_sentinel = NULL;
+	} else if (l->mid_sentinel != NULL) {
+		if (l->numels % 2) { /* now odd */
+			if (pos >= l->numels/2)
+				l->mid_sentinel = l->mid_sentinel->prev;
+		} else { /* now even */
+			if (pos < l->numels/2)
+				l->mid_sentinel = l->mid_sentinel->next;
+		}
 	}
 
 	tmp->prev->next = tmp->next;
 	tmp->next->prev = tmp->prev;
 
-	if (l->spareelsnum < ACDLL_MAX_SPARE_ELEMS) {
-		l->spareels[l->spareelsnum++] = tmp;
-	} else {
-		free(tmp);
-	}
+	list_node_free(l, tmp);
 
 	return 0;
 }
@@ -29,6 +29,7 @@ extern "C" {
 
 #include <errno.h>
 #include <sys/types.h>
+#include <stdint.h>
 
 
 /**
@@ -42,6 +43,19 @@ extern "C" {
  */
 typedef int (*element_comparator)(const void *a, const void *b);
 
+/**
+ * \brief A sort key extractor of elements.
+ *
+ * A keyer is a function that:
+ *      -# receives a reference to an element el
+ *      -# returns the numeric key the element is to be sorted by
+ *
+ * \remarks A list with a keyer is sorted by its keys, computed only once per element,
+ * instead of calling the comparator O(n log n) times.
+ * It is responsability of the function to handle possible NULL values.
+ */
+typedef double (*element_keyer)(const void *el);
+
 /**
  * \brief A seeker of elements.
  *
@@ -96,6 +110,11 @@ typedef void *(*element_serializer)(const void *el, unsigned int *serializ_len);
  * with its data, and the function allocates and returns the buffer containing
  * the original element, and it sets the length of this buffer into the
  * integer passed by reference.
+ * On entry, that integer holds the length of the serialized representation. The
+ * version of the dump format it was read from is given by list_restore_version().
+ * If list_restore_mapped() is true the serialized representation stays in memory after
+ * the call, so the element may point into it instead of copying it. The element may be
+ * allocated with list_arena_alloc() instead of malloc().
  *
  * \param data              reference to the buffer with the serialized representation of the element
  * \param data_len          reference to the location where to store the length of the data in the buffer returned
@@ -119,6 +138,8 @@ struct list_entry_s {
 	struct list_entry_s *next;
 	/** Privious element pointer */
 	struct list_entry_s *prev;
+	/** Tower of the node in the position index, or NULL; only kept while the list has an index */
+	struct list_tower_s *tower;
 };
 
 /** Double Linked List attributes
@@ -127,6 +148,8 @@ struct list_entry_s {
 struct list_attributes_s {
 	/** User-set routine for comparing list elements */
 	element_comparator comparator;
+	/** User-set routine for extracting the sort key of list elements */
+	element_keyer keyer;
 	/** User-set routing for seeking elements */
 	element_seeker seeker;
 	/** User-set routine for determining the length of an element */
@@ -135,6 +158,199 @@ struct list_attributes_s {
 	element_serializer serializer;
 	/** User-set routine for unserializing an element */
 	element_unserializer unserializer;
+	/** Size of the buffer the dumps are staged in and restored through, bytes */
+	size_t dump_bufsize;
+	/** Most threads a sort may use */
+	unsigned int threads;
+};
+
+/** Element of the list along with its precomputed sort key
+ * \see list_sort_keys()
+ */
+struct list_sortkey_s {
+	/** Sort key of the element */
+	double key;
+	/** Element data pointer */
+	void *data;
+};
+
+/** Element of the list along with its precomputed integer sort key
+ * \see list_sort_radix()
+ */
+struct list_radixkey_s {
+	/** Sort key of the element */
+	uint32_t key;
+	/** Element data pointer */
+	void *data;
+};
+
+/** Block of memory of the arena of a list
+ * \note [private-use]
+ */
+struct list_arena_s {
+	/** Next, older, block */
+	struct list_arena_s *next;
+	/** Start of the memory of the block */
+	char *base;
+	/** Bytes of the block in use */
+	size_t used;
+	/** Size of the block, bytes */
+	size_t size;
+};
+
+/** Allocator of the nodes of a list
+ * \note [private-use]
+ */
+struct list_pool_s {
+	/** Number of nodes in each slab, or 0 if the nodes are allocated one by one */
+	unsigned int slab;
+	/** Slabs allocated, newest first */
+	struct list_slab_s *slabs;
+	/** Number of slabs allocated */
+	unsigned int numslabs;
+	/** Number of nodes of the newest slab already handed out */
+	unsigned int carved;
+	/** Free nodes, linked by their next pointer */
+	struct list_entry_s *free;
+	/** Number of nodes in free */
+	unsigned int numfree;
+	/** Number of nodes handed out */
+	unsigned long allocs;
+	/** Number of nodes given back */
+	unsigned long frees;
+	/** Number of malloc() calls made for nodes */
+	unsigned long mallocs;
+};
+
+/** Statistics of the node allocator of a list
+ * \see list_pool_stats()
+ */
+struct list_pool_stats_s {
+	/** Number of nodes in each slab, or 0 if the list does not use a pool */
+	unsigned int slab;
+	/** Number of slabs allocated */
+	unsigned int slabs;
+	/** Number of nodes the slabs hold */
+	unsigned int nodes;
+	/** Number of nodes ready for reuse */
+	unsigned int free;
+	/** Number of nodes handed out since list_init() */
+	unsigned long allocs;
+	/** Number of nodes given back since list_init() */
+	unsigned long frees;
+	/** Number of malloc() calls made for nodes since list_init() */
+	unsigned long mallocs;
+	/** Bytes taken by the slabs */
+	size_t bytes;
+};
+
+/** Tower of the position index of a list: the levels one of its nodes is linked at
+ * \note [private-use]
+ */
+struct list_tower_s {
+	/** Node the tower stands on */
+	struct list_entry_s *node;
+	/** Number of levels of the tower */
+	unsigned int height;
+	/** Links of the tower, by level; there are as many as its height */
+	struct list_tower_link_s {
+		/** Next tower at the level, or NULL */
+		struct list_tower_s *next;
+		/** Previous tower at the level, or NULL for the head sentinel */
+		struct list_tower_s *prev;
+		/** Number of positions from this tower to the next, or to the end of the list */
+		unsigned int width;
+	} link[1];
+};
+
+/** Slot of the locator of a list
+ * \note [private-use]
+ */
+struct list_locator_slot_s {
+	/** Element data pointer, the key */
+	const void *data;
+	/** Node holding the element, or NULL for an empty slot */
+	struct list_entry_s *node;
+};
+
+/** Locator of a list: open addressed hash table from element data to its node
+ * \note [private-use]
+ */
+struct list_locator_s {
+	/** Slots, or NULL if the list keeps no locator */
+	struct list_locator_slot_s *slots;
+	/** Number of slots, a power of two */
+	unsigned int size;
+	/** Number of slots in use */
+	unsigned int numels;
+	/** True if a sort moved elements between nodes since the slots were filled */
+	int stale;
+};
+
+/** Chunk of a chunked list: a run of consecutive elements
+ * \note [private-use]
+ */
+struct list_chunk_s {
+	/** Next chunk */
+	struct list_chunk_s *next;
+	/** Previous chunk */
+	struct list_chunk_s *prev;
+	/** Number of elements in data */
+	unsigned int numels;
+	/** Element data pointers; there is room for as many as the chunk size of the list */
+	void *data[1];
+};
+
+/** Chunks of a chunked list
+ * \note [private-use]
+ */
+struct list_chunks_s {
+	/** Room for elements in each chunk, or 0 if the list has a node per element */
+	unsigned int size;
+	/** First chunk, or NULL if the list is empty */
+	struct list_chunk_s *head;
+	/** Last chunk, or NULL if the list is empty */
+	struct list_chunk_s *tail;
+	/** Number of chunks */
+	unsigned int numchunks;
+};
+
+/** Position of an element in a list, whatever its storage
+ * \note [private-use]
+ */
+struct list_cursor_s {
+	/** Node of the element, for lists with a node per element */
+	struct list_entry_s *node;
+	/** Chunk of the element, for chunked lists */
+	struct list_chunk_s *chunk;
+	/** Position of the element in chunk */
+	unsigned int pos;
+};
+
+/** Memory mapping of a dump file restored by list_restore_mmap() */
+struct list_mapping_s {
+	/** Start of the mapping, or NULL if none */
+	void *addr;
+	/** Length of the mapping, bytes */
+	size_t len;
+};
+
+/** Dump file written one element at a time, with no list behind it
+ * \see list_dump_stream_open()
+ */
+struct list_dump_stream_s {
+	/** Buffered writer of the file
+	 * \note [private-use]
+	 */
+	struct list_dump_writer_s *writer;
+	/** Header of the file, written by the close
+	 * \note [private-use]
+	 */
+	struct list_dump_header_s *header;
+	/** Number of elements written */
+	uint32_t numels;
+	/** Sum of the size of the elements written, bytes */
+	uint32_t totlistlen;
 };
 
 /** Double Linked List object */
@@ -152,16 +368,38 @@ struct list_s {
 	struct list_entry_s **spareels;
 	/** Number of elements in spareels */
 	unsigned int spareelsnum;
+	/** Allocator of the nodes */
+	struct list_pool_s pool;
+	/** Storage of the elements of chunked lists */
+	struct list_chunks_s chunks;
 
 	/** True if an list iteration is active(on-going) */
 	int iter_active;
 	/** Position of list iteration active*/
 	unsigned int iter_pos;
-	/** Pointer to the current list iteration */
-	struct list_entry_s *iter_curentry;
+	/** Position of the last element given by the list iteration */
+	struct list_cursor_s iter_cursor;
 
 	/** List attributes */
 	struct list_attributes_s attrs;
+
+	/** Version of the dump format being restored */
+	unsigned int restore_version;
+	/** True while restoring from a mapping that outlives the restore */
+	int restore_mapped;
+
+	/** Blocks of memory owned by the list, newest first */
+	struct list_arena_s *arena;
+
+	/** Tower of the head sentinel, with every level, if the list keeps a position index */
+	struct list_tower_s *towers;
+	/** Node of every element, if the list keeps a locator */
+	struct list_locator_s locator;
+
+	/** Count of the changes made to the elements of the list, and to their order */
+	unsigned long generation;
+	/** Number of leading elements still in the order of the last sort */
+	unsigned int sorted;
 };
 
 /**
@@ -177,12 +415,51 @@ int list_init(list_t *l);
  *
  * \remarks This function is the inverse of list_init(). It is meant to be called when
  * the list is no longer going to be used. Elements and possible memory taken
- * for internal use are freed.
+ * for internal use are freed, along with the arena of the list.
  *
  * \param l     list to destroy
  */
 void list_destroy(list_t *l);
 
+/**
+ * Initialize a list object for use, with a pool of nodes.
+ *
+ * The nodes of the list are carved out of slabs, allocated as needed, and the nodes
+ * removed are kept in a free list for reuse; slabs are only freed by list_destroy().
+ * Lists initialized by list_init() allocate each node on its own instead, keeping just
+ * a few spares.
+ *
+ * \param l     must point to a user-provided memory location
+ * \param slab  number of nodes in each slab; 0 for the default ACDLL_POOL_SLAB
+ * \return      0 for success. -1 for failure
+ *
+ * \see list_pool_stats()
+ */
+int list_init_pool(list_t *l, unsigned int slab);
+
+/**
+ * Initialize a chunked list object for use.
+ *
+ * A chunked (unrolled) list keeps its elements in a chain of chunks, each with an array
+ * of up to chunk elements, instead of a node per element: scans and sorts walk arrays
+ * instead of chasing a pointer per element, and indexed access skips whole chunks.
+ * Every other function works the same on either kind of list.
+ *
+ * \param l     must point to a user-provided memory location
+ * \param chunk number of elements each chunk has room for; 0 for the default ACDLL_CHUNK_SIZE
+ * \return      0 for success. -1 for failure
+ */
+int list_init_chunked(list_t *l, unsigned int chunk);
+
+/**
+ * Get the statistics of the node allocator of a list.
+ *
+ * \param l     list to operate
+ * \param st    statistics to fill
+ * \return      0 for success. -1 for failure
+ */
+int list_pool_stats(const list_t *l, struct list_pool_stats_s *st);
+
 /**
  * Set the comparator function for list elements.
  *
@@ -197,6 +474,20 @@ void list_destroy(list_t *l);
  */
 int list_attributes_comparator(list_t *l, element_comparator comparator_fun);
 
+/**
+ * Set the sort key extractor function for list elements.
+ *
+ * \remarks When set, list_sort() uses the keyer instead of the comparator. \n
+ *          If NULL is passed as reference to the function, the keyer is disabled.
+ *
+ * \param l     list to operate
+ * \param keyer_fun    pointer to the actual keyer function
+ * \return      0 if the attribute was successfully set; -1 otherwise
+ *
+ * \see element_keyer()
+ */
+int list_attributes_keyer(list_t *l, element_keyer keyer_fun);
+
 /**
  * Set a seeker function for list elements.
  *
@@ -230,6 +521,84 @@ int list_attributes_seeker(list_t *l, element_seeker seeker_fun);
  */
 int list_attributes_copy(list_t *l, element_meter metric_fun, int copy_data);
 
+/**
+ * Set the serializer and unserializer functions used to dump and restore the list.
+ *
+ * \remarks When set, list_dump_file() writes what the serializer returns for each
+ * element instead of the element data, and list_restore_file() appends what the
+ * unserializer builds from it. \n
+ * 			If NULL is passed as reference to the functions, the element data is
+ * 			dumped and restored verbatim, as measured by the meter.
+ *
+ * \param l                 list to operate
+ * \param serializer_fun    pointer to the actual serializer function
+ * \param unserializer_fun  pointer to the actual unserializer function
+ * \return                  0 if the attribute was successfully set; -1 otherwise
+ *
+ * \see element_serializer()
+ * \see element_unserializer()
+ */
+int list_attributes_serializer(list_t *l, element_serializer serializer_fun, element_unserializer unserializer_fun);
+
+/**
+ * Keep an index of the positions of the elements of the list.
+ *
+ * \remarks The index is a skip list over the nodes: random nodes get towers linking them
+ * to farther nodes, along with the number of positions skipped. It takes positional
+ * access - list_insert_at(), list_delete_at() and list_get_at() - from O(n) to
+ * O(log n), at the cost of keeping the towers up to date. Chunked lists have no index.
+ *
+ * \param l         list to operate
+ * \param indexed   0: drop the index (default); non-0: build it and keep it
+ * \return          0 if the attribute was successfully set; -1 otherwise
+ */
+int list_attributes_indexed(list_t *l, int indexed);
+
+/**
+ * Set the number of threads sorting the list.
+ *
+ * \remarks With more than one thread, list_sort() and list_sort_keys() copy the
+ * elements to an array, sort one partition of it on each thread and merge the
+ * partitions on the calling one, before storing the elements back in the list in their
+ * new order; list_sort_radix() has each thread count and move one range of the keys in
+ * every pass. Each thread gets at least ACDLL_SORT_MINPART elements: shorter lists are
+ * sorted serially, as with a single thread (the default). The sort is stable either way.
+ *
+ * \param l         list to operate
+ * \param threads   most threads to use; 0 for one per online processor
+ * \return          0 if the attribute was successfully set; -1 otherwise
+ */
+int list_attributes_threads(list_t *l, unsigned int threads);
+
+/**
+ * Keep a locator of the nodes of the elements of the list.
+ *
+ * \remarks The locator is a hash table from the element data pointer to its node. It
+ * lets list_delete() and list_locate() find an element in O(1) instead of scanning the
+ * list; along with the position index, they also get its position in O(log n). Sorting
+ * moves the elements between nodes, so the next lookup after a sort fills the table
+ * again. Chunked lists have no locator.
+ *
+ * \param l         list to operate
+ * \param located   0: drop the locator (default); non-0: build it and keep it
+ * \return          0 if the attribute was successfully set; -1 otherwise
+ */
+int list_attributes_locator(list_t *l, int located);
+
+/**
+ * Set the size of the buffer used to stage the dumps of the list.
+ *
+ * \remarks The dump writes the buffer with one writev() each time it fills, so larger
+ * buffers mean fewer system calls. Element data at least this large is written on its own.
+ *
+ * \param l     list to operate
+ * \param size  size of the buffer, in bytes; 0 restores the default ACDLL_DUMP_BUFSIZE
+ * \return      0 if the attribute was successfully set; -1 otherwise
+ *
+ * \see list_dump_file()
+ */
+int list_attributes_dump_buffer(list_t *l, size_t size);
+
 
 /**
  * Append data at the end of the list.
@@ -241,6 +610,21 @@ int list_attributes_copy(list_t *l, element_meter metric_fun, int copy_data);
  */
 int list_append(list_t *l, const void *data);
 
+/**
+ * Append many data at the end of the list at once.
+ *
+ * The nodes are allocated in one block from the arena of the list and linked in one
+ * pass; the position index, if any, is built again and the locator catches up on its
+ * next lookup.
+ *
+ * \param l     list to operate
+ * \param data  array of pointers to user data to append, in order
+ * \param n     number of pointers in data
+ *
+ * \return      n for success. < 0 for failure, with none appended
+ */
+int list_append_array(list_t *l, void *const *data, unsigned int n);
+
 
 /**
  * Insert an element at a given position.
@@ -252,6 +636,15 @@ int list_append(list_t *l, const void *data);
  */
 int list_insert_at(list_t *l, const void *data, unsigned int pos);
 
+/**
+ * Get the element at a given position.
+ *
+ * \param l     list to operate
+ * \param pos   [0,size-1] position index of the element wanted
+ * \return      reference to user-given data; NULL on error
+ */
+void *list_get_at(const list_t *l, unsigned int pos);
+
 /**
  * Delete an element at a given position from the list.
  *
@@ -261,6 +654,34 @@ int list_insert_at(list_t *l, const void *data, unsigned int pos);
  */
 int list_delete_at(list_t *l, unsigned int pos);
 
+/**
+ * Delete an element from the list, given the element itself.
+ *
+ * \remarks Elements are told apart by their data pointer; if the element is in the list
+ * more than once, only one of them is deleted. With a locator the element is found
+ * in O(1); a list without position index then stops keeping its middle pointer, so
+ * positional access walks from the ends only.
+ *
+ * \param l     list to operate
+ * \param data  reference to the element to be deleted
+ * \return      0 on success. Negative value on failure or if the element is not in the list
+ *
+ * \see list_attributes_locator
+ */
+int list_delete(list_t *l, const void *data);
+
+/**
+ * Find the position of an element in the list, given the element itself.
+ *
+ * \param l     list to operate
+ * \param data  reference to the element
+ * \return      [0,size-1] position of the element (of one of them, if it is in the list
+ *              more than once); -1 if it is not in the list
+ *
+ * \see list_attributes_locator
+ */
+int list_locate(list_t *l, const void *data);
+
 /**
  * Clear all the elements off of the list.
  *
@@ -281,6 +702,27 @@ int list_clear(list_t *l);
  */
 unsigned int list_size(const list_t *l);
 
+/**
+ * Inspect the generation of the list.
+ *
+ * The generation changes whenever elements are inserted, deleted, restored or
+ * sorted, so two equal generations tell the list was left as it was.
+ *
+ * \param l     list to operate
+ * \return      generation of the list
+ */
+unsigned long list_generation(const list_t *l);
+
+/**
+ * Inspect how much of the list is still sorted.
+ *
+ * \param l     list to operate
+ * \return      number of leading elements still in the order the last sort left them in
+ *
+ * \see list_sort_repair()
+ */
+unsigned int list_sorted(const list_t *l);
+
 /**
  * Returns an element given an indicator.
  *
@@ -300,11 +742,14 @@ const void *list_seek(const list_t *l, void *indicator);
 /**
  * Sort list elements.
  *
- * \warning Requires a comparator function to be set for the list.
+ * \warning Requires a comparator or a keyer function to be set for the list.
  *
  * Sorts the list in ascending or descending order as specified by the versus
- * flag. The algorithm chooses autonomously what algorithm is best suited for
- * sorting the list wrt its current status.
+ * flag. The sort is stable: equal elements keep their relative order. \n
+ * Node lists are sorted by a bottom-up merge sort that relinks the nodes, with no
+ * memory allocated; chunked lists are merge sorted through an array. \n
+ * If a keyer is set, the key of each element is computed once, the keys are sorted
+ * and the list is rewritten in their order (decorate-sort-undecorate).
  *
  * \param l     list to operate
  * \param versus 	- positive: order small to big (Asdendent); 
@@ -313,9 +758,89 @@ const void *list_seek(const list_t *l, void *indicator);
  * 					- non-0: errors happened
  *
  * \see list_attributes_comparator()
+ * \see list_attributes_keyer()
  */
 int list_sort(list_t *l, int versus);
 
+/**
+ * Select the first elements of the list in sort order, without sorting it.
+ *
+ * \warning Requires a comparator or a keyer function to be set for the list.
+ *
+ * In a single pass over the list, keeps in a bounded heap the k elements that
+ * list_sort() would put first, among those accepted by the seeker (or all elements
+ * if no seeker is set). It takes O(n log k) and does not modify the list.
+ *
+ * \param l     list to operate
+ * \param k     maximum number of elements to select
+ * \param versus 	same as in list_sort()
+ * \param indicator indicator data to pass to the seeker along with elements
+ * \param out   array of at least k references to fill, in sort order
+ * \return      number of elements stored in out
+ *
+ * \see list_sort()
+ * \see list_attributes_seeker()
+ */
+unsigned int list_select(const list_t *l, unsigned int k, int versus, void *indicator, void **out);
+
+/**
+ * Sort list elements by precomputed keys.
+ *
+ * Sorts the pairs in keys and then stores their elements in the list in that order.
+ * The order is the one list_sort() gives with a comparator returning the sign of
+ * (key a - key b); pairs with equal keys keep their order in keys.
+ *
+ * \param l     list to operate
+ * \param keys  array with every element of the list along with its key
+ * \param n     number of pairs in keys; must be the size of the list
+ * \param versus 	- positive: order small to big (Asdendent);
+ * 					- negative: order big to small(Descendent)
+ * \return      	- 0: sorting went OK
+ * 					- non-0: errors happened
+ *
+ * \see list_sort()
+ */
+int list_sort_keys(list_t *l, struct list_sortkey_s *keys, unsigned int n, int versus);
+
+/**
+ * Sort list elements by precomputed integer keys.
+ *
+ * Same as list_sort_keys(), with 32-bit keys: an LSD radix sort orders them in
+ * O(n) without comparing, one pass per ACDLL_RADIX_BITS bits that differ among
+ * the keys. Pairs with equal keys keep their order in keys. The passes are split
+ * among the threads of the list, as set by list_attributes_threads().
+ *
+ * \param l     list to operate
+ * \param keys  array with every element of the list along with its key
+ * \param n     number of pairs in keys; must be the size of the list
+ * \param versus 	same as in list_sort_keys()
+ * \return      	- 0: sorting went OK
+ * 					- non-0: errors happened
+ *
+ * \see list_sort_keys()
+ */
+int list_sort_radix(list_t *l, struct list_radixkey_s *keys, unsigned int n, int versus);
+
+/**
+ * Sort a list again after elements were appended to it.
+ *
+ * Only the elements after the list_sorted() ones are sorted, then they are merged into
+ * the others from the tail, so the elements before the first insertion point are not
+ * touched. Indexed lists instead find where each goes by a binary search, in O(log^2 n).
+ * The sorted elements must still be in the order given by versus: the same comparator,
+ * or keyer, and versus as the last sort.
+ *
+ * \param l     list to operate
+ * \param versus 	same as in list_sort()
+ * \return      	- 0: sorting went OK
+ * 					- non-0: errors happened
+ *
+ * \remarks Chunked lists are sorted with list_sort().
+ * \see list_sort()
+ * \see list_sorted()
+ */
+int list_sort_repair(list_t *l, int versus);
+
 /**
  * Start an iteration session.
  *
@@ -369,11 +894,48 @@ int list_iterator_stop(list_t *l);
  */
 size_t list_dump_file(const list_t *l, const char *filename);
 
+/**
+ * Start a dump file written one element at a time.
+ *
+ * The file gets the same format as list_dump_file() writes for lists of elements of
+ * varying size, so list_restore_file() restores it, but the elements are handed over
+ * by the caller, already serialized, instead of being taken from a list: a file of
+ * any size can be written with the memory of the buffer alone.
+ *
+ * \param s         must point to a user-provided memory location
+ * \param fd        file descriptor to write to, from its start
+ * \param bufsize   size of the buffer the dump is staged in; 0 for ACDLL_DUMP_BUFSIZE
+ * \return          0 for success. -1 for failure
+ * \see list_dump_stream_put()
+ * \see list_dump_stream_close()
+ */
+int list_dump_stream_open(struct list_dump_stream_s *s, int fd, size_t bufsize);
+
+/**
+ * Write an element to a dump file started by list_dump_stream_open().
+ * \param s     dump to operate
+ * \param data  serialized element; it is copied
+ * \param len   length of the element, bytes
+ * \return      0 for success. -1 for failure
+ */
+int list_dump_stream_put(struct list_dump_stream_s *s, const void *data, unsigned int len);
+
+/**
+ * Finish a dump file started by list_dump_stream_open(), writing its header.
+ * \param s     dump to operate; released even on failure
+ * \return      0 for success. -1 if a write failed, now or before
+ * \remarks The file descriptor is left open.
+ */
+int list_dump_stream_close(struct list_dump_stream_s *s);
+
 /**
  * Restore the list from a file name.
  *
  * This function restores the content of a list from a file into memory. It is
  * the inverse of list_dump_file().
+ * The file is read in large chunks; the nodes of the elements restored, and the element
+ * data copied without an unserializer, are allocated at once from the arena of the list
+ * and freed only by list_destroy().
  *
  * \see element_unserializer()
  * \see list_dump_file()
@@ -385,6 +947,77 @@ size_t list_dump_file(const list_t *l, const char *filename);
  */
 size_t list_restore_file(list_t *l, const char *filename);
 
+/**
+ * Restore the list from a file name, mapping the file in memory.
+ *
+ * This function does the same as list_restore_file(), without a read() per element:
+ * the file is mapped read-only and shared with other processes mapping it. The
+ * unserializer is given the elements straight from the mapping and may keep pointers
+ * into it.
+ *
+ * \param l         list to restore to
+ * \param filename  filename to read data from
+ * \param map       mapping to fill; it must be released with list_mapping_release()
+ *                  only after the elements pointing into it are gone, even if the
+ *                  restore fails
+ * \return          the number of bytes read into memory
+ *
+ * \remarks Elements without an unserializer are copied out of the mapping, into the arena.
+ * \see list_restore_file()
+ */
+size_t list_restore_mmap(list_t *l, const char *filename, struct list_mapping_s *map);
+
+/**
+ * Release the mapping of a dump file restored by list_restore_mmap().
+ *
+ * \param map   mapping to release
+ */
+void list_mapping_release(struct list_mapping_s *map);
+
+/**
+ * Allocate memory from the arena of a list.
+ *
+ * The arena hands out memory from a few large blocks, which are only released, all
+ * at once, by list_destroy(). Restores take the nodes of the list and the element data
+ * they copy from it; unserializers may take the elements they build.
+ *
+ * \param l     list to operate
+ * \param size  bytes to allocate
+ * \return      the memory, aligned as for malloc(), or NULL on failure
+ *
+ * \remarks The memory must not be passed to free(): see list_arena_owns().
+ */
+void *list_arena_alloc(list_t *l, size_t size);
+
+/**
+ * Tell if memory belongs to the arena of a list.
+ *
+ * \param l     list to operate
+ * \param p     memory to check
+ * \return      non-0 if p was given by list_arena_alloc(), or is a node restored into l
+ */
+int list_arena_owns(const list_t *l, const void *p);
+
+/**
+ * Tell if a list is being restored from a mapping that outlives the restore.
+ *
+ * \param l     list to operate
+ * \return      non-0 while list_restore_mmap() gives elements to the unserializer
+ * \see element_unserializer()
+ */
+int list_restore_mapped(const list_t *l);
+
+/**
+ * Get the version of the dump format a list is being restored from.
+ *
+ * \param l     list to operate
+ * \return      the version of the last dump restored into the list, or 0 if none
+ *
+ * \remarks Unserializers use it to read the elements of older dump files.
+ * \see element_unserializer()
+ */
+unsigned int list_restore_version(const list_t *l);
+
 
 
 
@@ -0,0 +1,43 @@
+/**
+ *      \file bench.h
+ * 		\brief Heather file for the helpers shared by the benchmarks
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ *
+ *      \par
+ *      Each benchmark is a single file linked with the objects it times, so the helpers
+ *      are defined here, static, rather than in an object of their own.
+ */
+
+#ifndef _BENCH_H
+#define	_BENCH_H
+
+#include <time.h>
+
+/**
+ * Current time
+ * \return  seconds of a monotonic clock
+ */
+static double bench_now() {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+#endif	/* _BENCH_H */
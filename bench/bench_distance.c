@@ -0,0 +1,186 @@
+/**
+ *      \file bench_distance.c
+ * 		\brief Correctness test and benchmark of the batch distance kernels
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ *
+ *      \par Usage
+ *      bench_distance [ROWS] \n
+ *      Compares every instruction set of distance_batch() the CPU supports with the scalar
+ *      one, on points all over the globe, points close to the user, the user's own point,
+ *      antipodes and every tail length, then times each on ROWS points, 1000003 by default,
+ *      in rows/second. Exits with 1 if an instruction set is off by more than
+ *      BENCH_TOLERANCE Km.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "utils.h"
+#include "bench.h"
+
+/**
+ * Most difference allowed from the scalar distances, in Km: a metre, the precision of the
+ * sort keys. The acos of distance() itself rounds to steps of a few decimetres at antipodes.
+ */
+#define BENCH_TOLERANCE 1e-3
+
+/** Times each instruction set is timed, keeping the best */
+#define BENCH_RUNS 5
+
+/** Names of the instruction sets, by eDISTANCE_ISA */
+static const char *bench_isa_names[] = { "auto", "scalar", "sse2", "avx2" };
+
+/**
+ * Random number in a range
+ * \param min   lowest value
+ * \param max   highest value
+ * \return      random number from min to max
+ */
+static float bench_random(float min, float max) {
+	return min + (max - min) * (float) rand() / RAND_MAX;
+}
+
+/**
+ * Compare an instruction set with the scalar one on the first n points
+ * \param isa   instruction set
+ * \param ulat  GPS latitude of the user
+ * \param ulon  GPS longitude of the user
+ * \param lat   latitudes
+ * \param lon   longitudes
+ * \param n     number of points
+ * \param ref   room for n distances
+ * \param out   room for n distances
+ * \return      largest difference, in Km; a NaN on either side counts as infinite
+ */
+static double bench_compare(eDISTANCE_ISA isa, float ulat, float ulon, const float *lat, const float *lon, size_t n,
+		double *ref, double *out) {
+	double err, worst = 0;
+	size_t i;
+
+	distance_batch_isa(DISTANCE_ISA_SCALAR);
+	distance_batch(ulat, ulon, lat, lon, ref, n);
+	distance_batch_isa(isa);
+	distance_batch(ulat, ulon, lat, lon, out, n);
+
+	for (i = 0; i < n; i++) {
+		err = (isnan(ref[i]) || isnan(out[i]) ? INFINITY : fabs(ref[i] - out[i]));
+		if (err > worst)
+			worst = err;
+	}
+
+	return worst;
+}
+
+/** Main entry function
+ * \param argc	number of parameters inserted in command line
+ * \param argv 	array of all parameters inserted in command line
+ * \return 		0 in case of success; errorcode in case of an error
+ */
+int main(int argc, char** argv) {
+	size_t n = (argc > 1 ? (size_t) atol(argv[1]) : 1000003), i, len;
+	float *lat, *lon;
+	double *ref, *out, err, worst, t, best;
+	int isa, run, failed = 0;
+
+	if (n < 64)
+		n = 64;
+	lat = (float *) malloc(n * sizeof(float));
+	lon = (float *) malloc(n * sizeof(float));
+	ref = (double *) malloc(n * sizeof(double));
+	out = (double *) malloc(n * sizeof(double));
+	if (!lat || !lon || !ref || !out) {
+		perror("out of memory");
+		return (1);
+	}
+
+	for (isa = DISTANCE_ISA_SSE2; isa <= DISTANCE_ISA_AVX2; isa++) {
+		if (distance_batch_isa(isa) < 0) {
+			printf("%-6s not supported\n", bench_isa_names[isa]);
+			continue;
+		}
+
+		/* all over the globe */
+		srand(1);
+		for (i = 0; i < n; i++) {
+			lat[i] = bench_random(-90, 90);
+			lon[i] = bench_random(-180, 180);
+		}
+		worst = bench_compare(isa, -33.9f, 151.2f, lat, lon, n, ref, out);
+
+		/* within a few hundred metres, and the user's own point */
+		for (i = 0; i < n; i++) {
+			lat[i] = 38.72f + bench_random(0, 0.001f);
+			lon[i] = -9.14f + bench_random(0, 0.001f);
+		}
+		lat[n / 2] = 38.72f;
+		lon[n / 2] = -9.14f;
+		err = bench_compare(isa, 38.72f, -9.14f, lat, lon, n, ref, out);
+		worst = (err > worst ? err : worst);
+
+		/* antipodes of the user, where the cosine may round under -1 */
+		for (i = 0; i < n; i++) {
+			lat[i] = bench_random(-90, 90);
+			lon[i] = bench_random(-180, 180);
+		}
+		for (i = 0; i < n; i++) {
+			err = bench_compare(isa, -lat[i], lon[i] > 0 ? lon[i] - 180 : lon[i] + 180, lat + i, lon + i, 1, ref,
+					out);
+			worst = (err > worst ? err : worst);
+		}
+
+		/* every length up to a few vectors: the tails of 1 to 3 points after the last vector */
+		for (len = 1; len <= 19; len++) {
+			err = bench_compare(isa, 38.72f, -9.14f, lat, lon, len, ref, out);
+			worst = (err > worst ? err : worst);
+		}
+
+		printf("%-6s max difference from scalar %.3g Km: %s\n", bench_isa_names[isa], worst,
+				worst <= BENCH_TOLERANCE ? "ok" : "FAILED");
+		if (!(worst <= BENCH_TOLERANCE))
+			failed = 1;
+	}
+
+	/* throughput, on points around mainland Portugal */
+	for (i = 0; i < n; i++) {
+		lat[i] = bench_random(37, 42);
+		lon[i] = bench_random(-9.5f, -6.5f);
+	}
+	for (isa = DISTANCE_ISA_SCALAR; isa <= DISTANCE_ISA_AVX2; isa++) {
+		if (distance_batch_isa(isa) < 0)
+			continue;
+		best = 1e9;
+		for (run = 0; run < BENCH_RUNS; run++) {
+			t = bench_now();
+			distance_batch(38.72f, -9.14f, lat, lon, out, n);
+			t = bench_now() - t;
+			if (t < best)
+				best = t;
+		}
+		printf("%-6s %8.1f M rows/s\n", bench_isa_names[isa], n / best / 1e6);
+	}
+	distance_batch_isa(DISTANCE_ISA_AUTO);
+
+	free(lat);
+	free(lon);
+	free(ref);
+	free(out);
+
+	return (failed);
+}
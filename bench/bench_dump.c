@@ -0,0 +1,177 @@
+/**
+ *      \file bench_dump.c
+ * 		\brief Benchmark of the dump of lists to files, in records and system calls
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ *
+ *      \par Usage
+ *      bench_dump [ROWS [FILE]] \n
+ *      Times list_dump_file() on ROWS records, 1000000 by default, written to FILE,
+ *      /tmp/bench_dump.dat by default and removed at the end: restaurants through their
+ *      serializer, fixed 32 byte elements and elements of 16 to 31 bytes, with the default
+ *      dump buffer and with a 4 KiB one. Reports records/second and the write(), writev(),
+ *      lseek() and pwrite() calls per record, counted by wrapping them at link time
+ *      (-Wl,--wrap=write,...), as the bench/bench_dump rule of the makefile does.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "restaurant.h"
+#include "main.h"
+#include "bench.h"
+
+/** Times each dump is run, keeping the best */
+#define BENCH_RUNS 3
+
+/** Size of the small dump buffer, in bytes */
+#define BENCH_SMALL_BUFFER 4096
+
+/** Calls of each wrapped system call since the last bench_run() started */
+static unsigned long bench_writes, bench_writevs, bench_lseeks, bench_pwrites;
+
+ssize_t __real_write(int fd, const void *buf, size_t count);
+ssize_t __real_writev(int fd, const struct iovec *iov, int iovcnt);
+off_t __real_lseek(int fd, off_t offset, int whence);
+ssize_t __real_pwrite(int fd, const void *buf, size_t count, off_t offset);
+
+/** write(), counted */
+ssize_t __wrap_write(int fd, const void *buf, size_t count) {
+	bench_writes++;
+	return __real_write(fd, buf, count);
+}
+
+/** writev(), counted */
+ssize_t __wrap_writev(int fd, const struct iovec *iov, int iovcnt) {
+	bench_writevs++;
+	return __real_writev(fd, iov, iovcnt);
+}
+
+/** lseek(), counted */
+off_t __wrap_lseek(int fd, off_t offset, int whence) {
+	bench_lseeks++;
+	return __real_lseek(fd, offset, whence);
+}
+
+/** pwrite(), counted */
+ssize_t __wrap_pwrite(int fd, const void *buf, size_t count, off_t offset) {
+	bench_pwrites++;
+	return __real_pwrite(fd, buf, count, offset);
+}
+
+/** Meter of the fixed elements: always 32 bytes */
+static size_t bench_meter_fixed(const void *el) {
+	return 32;
+}
+
+/** Meter of the variable elements: 16 to 31 bytes, by the number they start with */
+static size_t bench_meter_variable(const void *el) {
+	return 16 + (*(const unsigned int *) el & 15);
+}
+
+/**
+ * Time the dump of a list, and count its system calls
+ * \param name      name of the list
+ * \param l         list to dump
+ * \param file      file to dump to
+ * \param buffer    size of the dump buffer; 0 for the default
+ */
+static void bench_run(const char *name, list_t *l, const char *file, size_t buffer) {
+	unsigned long calls = 0;
+	double t, best = 1e9;
+	int i;
+
+	list_attributes_dump_buffer(l, buffer);
+	for (i = 0; i < BENCH_RUNS; i++) {
+		bench_writes = bench_writevs = bench_lseeks = bench_pwrites = 0;
+		t = bench_now();
+		if (list_dump_file(l, file) == 0) {
+			perror(file);
+			exit(1);
+		}
+		t = bench_now() - t;
+		if (t < best)
+			best = t;
+		calls = bench_writes + bench_writevs + bench_lseeks + bench_pwrites;
+	}
+
+	printf("%-12s %-7s %8.1f ms %6.2f M rec/s  %.5f syscalls/rec (write %lu writev %lu lseek %lu pwrite %lu)\n",
+			name, buffer ? "4 KiB" : "default", best * 1e3, list_size(l) / best / 1e6,
+			(double) calls / list_size(l), bench_writes, bench_writevs, bench_lseeks, bench_pwrites);
+}
+
+/** Main entry function
+ * \param argc	number of parameters inserted in command line
+ * \param argv 	array of all parameters inserted in command line
+ * \return 		0 in case of success; errorcode in case of an error
+ */
+int main(int argc, char** argv) {
+	unsigned int n = (argc > 1 ? (unsigned int) atoi(argv[1]) : 1000000), i;
+	const char *file = (argc > 2 ? argv[2] : "/tmp/bench_dump.dat");
+	list_t fixed, variable;
+	prestaurant_t r;
+	unsigned int *el;
+
+	restaurant_init();
+	srand(1);
+	for (i = 0; i < n; i++) {
+		r = restaurant_new();
+		r->latitude = 37 + 5.0f * rand() / RAND_MAX;
+		r->longitude = -9.5f + 3.0f * rand() / RAND_MAX;
+		restaurant_set_text(r, NAME, "Restaurante");
+		restaurant_set_text(r, TOWN, "Lisboa");
+		restaurant_insert(r);
+	}
+
+	list_init(&fixed);
+	list_init(&variable);
+	list_attributes_copy(&fixed, bench_meter_fixed, 0);
+	list_attributes_copy(&variable, bench_meter_variable, 0);
+	for (i = 0; i < n; i++) {
+		el = (unsigned int *) calloc(1, 32);
+		if (!el) {
+			perror("out of memory");
+			return (1);
+		}
+		*el = i;
+		list_append(&fixed, el);
+		list_append(&variable, el);
+	}
+
+	printf("dump of %u records, best of %d\n", n, BENCH_RUNS);
+	bench_run("restaurants", &list_restaurants, file, 0);
+	bench_run("restaurants", &list_restaurants, file, BENCH_SMALL_BUFFER);
+	bench_run("fixed 32B", &fixed, file, 0);
+	bench_run("fixed 32B", &fixed, file, BENCH_SMALL_BUFFER);
+	bench_run("var 16-31B", &variable, file, 0);
+	bench_run("var 16-31B", &variable, file, BENCH_SMALL_BUFFER);
+	unlink(file);
+
+	/* the lists share the elements, and leave them to their owner */
+	list_iterator_start(&fixed);
+	while (list_iterator_hasnext(&fixed))
+		free(list_iterator_next(&fixed));
+	list_iterator_stop(&fixed);
+	list_destroy(&variable);
+	list_destroy(&fixed);
+	restaurant_clear();
+
+	return (0);
+}
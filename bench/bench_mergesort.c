@@ -0,0 +1,143 @@
+/**
+ *      \file bench_mergesort.c
+ * 		\brief Benchmark of the merge sort of the lists on sorted, reversed and random inputs
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ *
+ *      \par Usage
+ *      bench_mergesort [MAX] \n
+ *      Times list_sort() by comparator, the merge sort of the node links, on lists of 10000
+ *      elements, ten times that and so on up to MAX, 1000000 by default, each appended
+ *      already sorted, reversed, in random order and in random order with many equal keys.
+ *      Each sort is checked to be in order and stable, keeping equal elements in the order
+ *      they were appended; exits with 1 if one is not.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "acdll.h"
+#include "bench.h"
+
+/** Times each sort is run, keeping the best */
+#define BENCH_RUNS 3
+
+/** Element sorted: a key, and its position before the sort */
+struct bench_el_s {
+	double key;
+	unsigned int seq;
+};
+
+/** Names of the inputs, by kind */
+static const char *bench_kinds[] = { "sorted", "reversed", "random", "100 keys" };
+
+/** Comparator of the keys */
+static int bench_comparator(const void *a, const void *b) {
+	double x = ((const struct bench_el_s *) a)->key, y = ((const struct bench_el_s *) b)->key;
+
+	return (x < y) - (x > y);
+}
+
+/**
+ * Count the elements out of order, or out of their appended order among equal keys
+ * \param l     sorted list
+ * \return      number of elements in the wrong place
+ */
+static unsigned int bench_misplaced(list_t *l) {
+	const struct bench_el_s *el, *prev = NULL;
+	unsigned int bad = 0;
+
+	list_iterator_start(l);
+	while (list_iterator_hasnext(l)) {
+		el = (const struct bench_el_s *) list_iterator_next(l);
+		if (prev != NULL && (el->key < prev->key || (el->key == prev->key && el->seq < prev->seq)))
+			bad++;
+		prev = el;
+	}
+	list_iterator_stop(l);
+
+	return bad;
+}
+
+/**
+ * Time the sort of one input
+ * \param v     room for n elements
+ * \param n     number of elements
+ * \param kind  0 sorted, 1 reversed, 2 random, 3 random among 100 keys
+ * \return      number of elements misplaced by the sort
+ */
+static unsigned int bench_run(struct bench_el_s *v, unsigned int n, int kind) {
+	unsigned int i, bad = 0;
+	double t, best = 1e9;
+	list_t l;
+	int run;
+
+	srand(9);
+	for (i = 0; i < n; i++) {
+		v[i].key = (kind == 0 ? i : kind == 1 ? n - i : kind == 2 ? (double) rand() / RAND_MAX : rand() % 100);
+		v[i].seq = i;
+	}
+
+	for (run = 0; run < BENCH_RUNS; run++) {
+		list_init_pool(&l, 0);
+		list_attributes_comparator(&l, bench_comparator);
+		for (i = 0; i < n; i++)
+			list_append(&l, &v[i]);
+
+		t = bench_now();
+		list_sort(&l, 1);
+		t = bench_now() - t;
+		if (t < best)
+			best = t;
+
+		bad += bench_misplaced(&l);
+		list_destroy(&l);
+	}
+
+	printf("%8u %-9s %9.2f ms %8.2f M el/s  %u misplaced\n", n, bench_kinds[kind], best * 1e3, n / best / 1e6, bad);
+
+	return bad;
+}
+
+/** Main entry function
+ * \param argc	number of parameters inserted in command line
+ * \param argv 	array of all parameters inserted in command line
+ * \return 		0 in case of success; errorcode in case of an error
+ */
+int main(int argc, char** argv) {
+	unsigned int max = (argc > 1 ? (unsigned int) atoi(argv[1]) : 1000000), n, bad = 0;
+	struct bench_el_s *v;
+	int kind;
+
+	if (max < 10000)
+		max = 10000;
+	v = (struct bench_el_s *) malloc(max * sizeof(struct bench_el_s));
+	if (!v) {
+		perror("out of memory");
+		return (1);
+	}
+
+	printf("list_sort() by comparator, best of %d\n", BENCH_RUNS);
+	for (n = 10000; n <= max; n *= 10) {
+		for (kind = 0; kind < 4; kind++)
+			bad += bench_run(v, n, kind);
+	}
+	free(v);
+
+	return (bad ? 1 : 0);
+}
@@ -0,0 +1,247 @@
+/**
+ *      \file bench_snapshot.c
+ * 		\brief Stress test of the snapshots of the Restaurant List, with readers and a writer
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ *
+ *      \par Usage
+ *      bench_snapshot [ROUNDS [READERS [FILE]]] \n
+ *      Imports BENCH_ROWS restaurants from a CSV file written to FILE, /tmp/bench_snapshot.csv
+ *      by default and removed at the end, publishes a snapshot and starts READERS threads,
+ *      3 by default, that pin snapshots and check their nearest and open restaurants against
+ *      a scan of the whole snapshot. Meanwhile the calling thread, the writer, runs ROUNDS
+ *      rounds, 200 by default, of BENCH_CHANGES deletions, insertions and replacements by
+ *      edited copies, as the edit menu does, importing the file again every
+ *      BENCH_IMPORT_EVERY rounds, so the arena of the list grows while readers free the
+ *      restaurants retired, and publishes a snapshot after each. Reports the snapshots
+ *      checked per second, and exits with 1 if a check failed. \n
+ *      Built with -fsanitize=thread, as by
+ *      make CFLAGS="-g -fsanitize=thread -fcommon" LDFLAGS="-lm -pthread -fsanitize=thread" bench/bench_snapshot,
+ *      it checks the readers and the writer share nothing unlocked besides the snapshots.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "restaurant.h"
+#include "import.h"
+#include "utils.h"
+#include "main.h"
+#include "bench.h"
+
+/** Restaurants in the file imported */
+#define BENCH_ROWS 2000
+
+/** Changes of the list in each round of the writer */
+#define BENCH_CHANGES 50
+
+/** Rounds of the writer between imports of the file */
+#define BENCH_IMPORT_EVERY 20
+
+/** Most readers */
+#define BENCH_MAX_READERS 64
+
+/** Restaurants each check asks for, at most */
+#define BENCH_K 20
+
+/** State shared by the readers and the writer */
+static struct {
+	/** guards the rest */
+	pthread_mutex_t lock;
+	/** true once the writer is done */
+	int stop;
+	/** snapshots pinned and checked */
+	unsigned long pins;
+	/** snapshots that failed their check */
+	unsigned long failed;
+} bench = { PTHREAD_MUTEX_INITIALIZER, 0, 0, 0 };
+
+/**
+ * Write a CSV file of points of interest around Lisbon
+ * \param file  file to write
+ * \return      0 for success. -1 for failure
+ */
+static int bench_csv(const char *file) {
+	FILE *f = fopen(file, "w");
+	static const char *foods[] = { "Italian", "Seafood", "Grill", "Vegetarian" };
+	unsigned int i;
+
+	if (f == NULL) {
+		perror(file);
+		return -1;
+	}
+	srand(1);
+	for (i = 0; i < BENCH_ROWS; i++)
+		fprintf(f, "%f;%f;Restaurante %u;Rua %u;Lisboa;%u;Local %u;r%u@x.pt;http://r%u.pt;%s;obs %u;\n",
+				-9.5 + (double) rand() / RAND_MAX, 38 + (double) rand() / RAND_MAX, i, i, 1000 + i % 9000, i, i, i,
+				foods[i % 4], i);
+
+	return (fclose(f) == 0 ? 0 : -1);
+}
+
+/**
+ * Check the answers of a query on a snapshot against a scan of all of it
+ * \param s     snapshot
+ * \param seed  state of rand_r()
+ * \return      non-0 if an answer was wrong
+ */
+static unsigned int bench_check(const restaurant_snapshot_t *s, unsigned int *seed) {
+	struct restaurant_filter_s open = { 1, -1, NULL };
+	prestaurant_t out[BENCH_K], r;
+	unsigned int i, k, n, nearer, size = restaurant_snapshot_size(s), failed = 0;
+	float lat = 38 + (rand_r(seed) % 1000) / 1000.0f, lon = -9.5f + (rand_r(seed) % 1000) / 1000.0f;
+	double dk;
+
+	k = 1 + rand_r(seed) % BENCH_K;
+	n = restaurant_snapshot_knn(s, lat, lon, k, out);
+	if (n != (k < size ? k : size))
+		return 1;
+
+	/* no restaurant is nearer than the kth found but those found before it */
+	if (n > 0) {
+		dk = distance(lat, lon, out[n - 1]->latitude, out[n - 1]->longitude);
+		for (i = 0, nearer = 0; i < size; i++) {
+			r = restaurant_snapshot_get(s, i);
+			if (distance(lat, lon, r->latitude, r->longitude) < dk - 1e-9)
+				nearer++;
+			if (restaurant_get_text(r, NAME) == NULL || restaurant_get_text(r, FOOD_TYPE) == NULL)
+				failed = 1;
+		}
+		if (nearer > n - 1)
+			failed = 1;
+	}
+
+	n = restaurant_snapshot_select(s, lat, lon, k, &open, out);
+	for (i = 0; i < n; i++) {
+		if (!fn_seeker_restaurant_open(out[i], NULL))
+			failed = 1;
+	}
+
+	return failed;
+}
+
+/**
+ * Pin snapshots and check them until the writer is done, as the routine of a reader
+ * \param arg   seed of the reader
+ * \return      NULL
+ */
+static void *bench_reader(void *arg) {
+	const restaurant_snapshot_t *s;
+	unsigned int seed = (unsigned int) (unsigned long) arg, failed;
+	unsigned long last = 0;
+	int stop = 0;
+
+	while (!stop) {
+		s = restaurant_snapshot_pin();
+		/* snapshots only go forward */
+		failed = (s == NULL || restaurant_snapshot_number(s) < last);
+		if (s != NULL) {
+			last = restaurant_snapshot_number(s);
+			failed += bench_check(s, &seed);
+		}
+		restaurant_snapshot_unpin(s);
+
+		pthread_mutex_lock(&bench.lock);
+		bench.pins++;
+		bench.failed += (failed != 0);
+		stop = bench.stop;
+		pthread_mutex_unlock(&bench.lock);
+	}
+
+	return NULL;
+}
+
+/** Main entry function
+ * \param argc	number of parameters inserted in command line
+ * \param argv 	array of all parameters inserted in command line
+ * \return 		0 in case of success; errorcode in case of an error
+ */
+int main(int argc, char** argv) {
+	unsigned int rounds = (argc > 1 ? (unsigned int) atoi(argv[1]) : 200);
+	unsigned int readers = (argc > 2 ? (unsigned int) atoi(argv[2]) : 3);
+	const char *file = (argc > 3 ? argv[3] : "/tmp/bench_snapshot.csv");
+	pthread_t threads[BENCH_MAX_READERS];
+	unsigned int i, j, started, seed = 11, size;
+	prestaurant_t r, c;
+	double t;
+
+	if (readers > BENCH_MAX_READERS)
+		readers = BENCH_MAX_READERS;
+	if (bench_csv(file) != 0)
+		return (1);
+	restaurant_init();
+	if (import_csv(file, 1, NULL, NULL) < 0 || restaurant_snapshot_publish() == 0) {
+		remove(file);
+		return (1);
+	}
+
+	t = bench_now();
+	for (started = 0; started < readers; started++) {
+		if (pthread_create(&threads[started], NULL, bench_reader, (void *) (unsigned long) (started + 1)) != 0)
+			break;
+	}
+
+	for (i = 0; i < rounds; i++) {
+		/* restaurants imported live in the arena: growing it races with nothing the readers do */
+		if (i % BENCH_IMPORT_EVERY == BENCH_IMPORT_EVERY - 1)
+			import_csv(file, 1, NULL, NULL);
+		for (j = 0; j < BENCH_CHANGES; j++) {
+			size = list_size(&list_restaurants);
+			switch (size > 1 ? rand_r(&seed) % 3 : 0) {
+			case 1:
+				restaurant_delete((prestaurant_t) list_get_at(&list_restaurants, rand_r(&seed) % size));
+				break;
+			case 2:
+				/* published restaurants are not edited in place, but a copy put in their place */
+				r = (prestaurant_t) list_get_at(&list_restaurants, rand_r(&seed) % size);
+				if ((c = restaurant_copy(r)) != NULL) {
+					c->latitude = 38 + (rand_r(&seed) % 1000) / 1000.0f;
+					restaurant_set_text(c, NAME, "Editado");
+					if (restaurant_replace(r, c) != 0)
+						restaurant_free(c);
+				}
+				break;
+			default:
+				if ((r = restaurant_new()) != NULL) {
+					r->latitude = 38 + (rand_r(&seed) % 1000) / 1000.0f;
+					r->longitude = -9.5f + (rand_r(&seed) % 1000) / 1000.0f;
+					restaurant_set_text(r, NAME, "Novo");
+					restaurant_insert(r);
+				}
+			}
+		}
+		restaurant_snapshot_publish();
+	}
+
+	pthread_mutex_lock(&bench.lock);
+	bench.stop = 1;
+	pthread_mutex_unlock(&bench.lock);
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	t = bench_now() - t;
+
+	printf("%u rounds, %u readers, %u restaurants: %lu snapshots checked, %.0f/s, %lu failed\n", rounds, started,
+			list_size(&list_restaurants), bench.pins, bench.pins / t, bench.failed);
+
+	restaurant_clear();
+	remove(file);
+
+	return (bench.failed ? 1 : 0);
+}
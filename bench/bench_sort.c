@@ -0,0 +1,140 @@
+/**
+ *      \file bench_sort.c
+ * 		\brief Benchmark of the sort of the Restaurant List by distance to the user
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ *
+ *      \par Usage
+ *      bench_sort [ROWS] \n
+ *      Fills the Restaurant List with ROWS restaurants, 100000 by default, scattered over
+ *      mainland Portugal, and times its sort by distance to the user: by the comparator
+ *      alone, computing both distances in each comparison, as before the sort keys; by
+ *      the keyer, computing each distance once; and by restaurant_list_sort(), which takes
+ *      the keys from the coordinate table.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "restaurant.h"
+#include "utils.h"
+#include "main.h"
+#include "bench.h"
+
+/** Times each sort is run, keeping the best */
+#define BENCH_RUNS 3
+
+/**
+ * Fill the Restaurant List with restaurants at random positions
+ * \param n     number of restaurants
+ */
+static void bench_fill(unsigned int n) {
+	prestaurant_t r;
+	unsigned int i;
+
+	srand(1);
+	for (i = 0; i < n; i++) {
+		r = restaurant_new();
+		r->latitude = 37 + 5.0f * rand() / RAND_MAX;
+		r->longitude = -9.5f + 3.0f * rand() / RAND_MAX;
+		restaurant_set_text(r, NAME, "Restaurante");
+		restaurant_insert(r);
+	}
+}
+
+/**
+ * Count the restaurants out of order by distance to the user
+ * \return  number of restaurants nearer than the one before them
+ */
+static unsigned int bench_unsorted() {
+	prestaurant_t r;
+	double d, prev = -1;
+	unsigned int bad = 0;
+
+	list_iterator_start(&list_restaurants);
+	while (list_iterator_hasnext(&list_restaurants)) {
+		r = (prestaurant_t) list_iterator_next(&list_restaurants);
+		d = distance(user_latitude, user_longitude, r->latitude, r->longitude);
+		/* the radix sort rounds to the metre */
+		if (d < prev - 1e-3)
+			bad++;
+		prev = d;
+	}
+	list_iterator_stop(&list_restaurants);
+
+	return bad;
+}
+
+/**
+ * Time a sort of the Restaurant List, from the order for another user position each run
+ * \param name  name of the sort
+ * \param how   0 for the comparator alone, 1 for the keyer, 2 for restaurant_list_sort()
+ * \return      best time, in seconds
+ */
+static double bench_run(const char *name, int how) {
+	double t, best = 1e9;
+	int i;
+
+	for (i = 0; i < BENCH_RUNS; i++) {
+		/* shuffle: the order for a user in the north */
+		user_latitude = 41.5f;
+		user_longitude = -8.4f + i;
+		restaurant_list_sort();
+
+		user_latitude = 38.72f;
+		user_longitude = -9.14f;
+		list_attributes_comparator(&list_restaurants, fn_comparator_restaurant_distance);
+		list_attributes_keyer(&list_restaurants, how == 0 ? NULL : fn_keyer_restaurant_distance);
+		t = bench_now();
+		if (how == 2)
+			restaurant_list_sort();
+		else
+			list_sort(&list_restaurants, -1);
+		t = bench_now() - t;
+		if (t < best)
+			best = t;
+	}
+
+	printf("%-22s %9.1f ms  %10.0f rows/s  %u out of order\n", name, best * 1e3,
+			list_size(&list_restaurants) / best, bench_unsorted());
+
+	return best;
+}
+
+/** Main entry function
+ * \param argc	number of parameters inserted in command line
+ * \param argv 	array of all parameters inserted in command line
+ * \return 		0 in case of success; errorcode in case of an error
+ */
+int main(int argc, char** argv) {
+	unsigned int n = (argc > 1 ? (unsigned int) atoi(argv[1]) : 100000);
+	double before, keyed;
+
+	restaurant_init();
+	bench_fill(n);
+	printf("sort of %u restaurants by distance to the user, best of %d\n", n, BENCH_RUNS);
+
+	before = bench_run("comparator (before)", 0);
+	keyed = bench_run("keyer (after)", 1);
+	bench_run("restaurant_list_sort", 2);
+	printf("keyer speedup %.1fx\n", before / keyed);
+
+	restaurant_clear();
+
+	return (0);
+}
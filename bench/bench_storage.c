@@ -0,0 +1,196 @@
+/**
+ *      \file bench_storage.c
+ * 		\brief Benchmark of the storages of the lists: nodes, pooled nodes and chunks
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ *
+ *      \par Usage
+ *      bench_storage [ELEMENTS] \n
+ *      Fills a list of ELEMENTS random numbers, 100000 by default, once for each storage:
+ *      a node per element (list_init()), nodes from slabs (list_init_pool()) and chunks of
+ *      32 and 64 elements (list_init_chunked()), and times appending them, BENCH_ACCESSES
+ *      list_get_at() at random positions, BENCH_SEEKS list_seek() of a missing element,
+ *      the sort by comparator, the sort back the other way, the sort by keyer and
+ *      BENCH_ACCESSES list_insert_at() and list_delete_at() at random positions. The heap is
+ *      scattered first, as in a program that has been running for a while.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "acdll.h"
+#include "bench.h"
+
+/** Accesses, insertions and deletions at random positions timed */
+#define BENCH_ACCESSES 2000
+
+/** Seeks of a missing element timed */
+#define BENCH_SEEKS 5
+
+/** Comparator of the numbers */
+static int bench_comparator(const void *a, const void *b) {
+	long x = *(const long *) a, y = *(const long *) b;
+
+	return (x > y) - (x < y);
+}
+
+/** Keyer of the numbers */
+static double bench_keyer(const void *el) {
+	return (double) *(const long *) el;
+}
+
+/** Seeker of a number */
+static int bench_seeker(const void *el, const void *indicator) {
+	return *(const long *) el == *(const long *) indicator;
+}
+
+/**
+ * Check a list is in ascending order
+ * \param l     list to check
+ * \return      number of elements less than the one before them
+ */
+static unsigned int bench_unsorted(list_t *l) {
+	unsigned int bad = 0;
+	long prev = -1, x;
+
+	list_iterator_start(l);
+	while (list_iterator_hasnext(l)) {
+		x = *(const long *) list_iterator_next(l);
+		if (x < prev)
+			bad++;
+		prev = x;
+	}
+	list_iterator_stop(l);
+
+	return bad;
+}
+
+/**
+ * Time the operations on one storage
+ * \param name      name of the storage
+ * \param storage   0 for nodes, 1 for pooled nodes, 2 for chunks
+ * \param chunk     elements by chunk, with chunks
+ * \param v         numbers
+ * \param n         count of numbers
+ */
+static void bench_run(const char *name, int storage, unsigned int chunk, long *v, unsigned int n) {
+	list_t l;
+	double t, ms[7];
+	long missing = -1;
+	/* keeps the accesses from being optimized out */
+	volatile long sink = 0;
+	unsigned int i, pos, bad;
+
+	if (storage == 0)
+		list_init(&l);
+	else if (storage == 1)
+		list_init_pool(&l, 0);
+	else
+		list_init_chunked(&l, chunk);
+	list_attributes_comparator(&l, bench_comparator);
+	list_attributes_seeker(&l, bench_seeker);
+
+	t = bench_now();
+	for (i = 0; i < n; i++)
+		list_append(&l, &v[i]);
+	ms[0] = (bench_now() - t) * 1e3;
+
+	t = bench_now();
+	srand(1);
+	for (i = 0; i < BENCH_ACCESSES; i++)
+		sink += *(const long *) list_get_at(&l, rand() % n);
+	ms[1] = (bench_now() - t) * 1e3;
+
+	t = bench_now();
+	for (i = 0; i < BENCH_SEEKS; i++)
+		sink += (list_seek(&l, &missing) != NULL);
+	ms[2] = (bench_now() - t) * 1e3;
+
+	t = bench_now();
+	list_sort(&l, -1);
+	ms[3] = (bench_now() - t) * 1e3;
+	bad = bench_unsorted(&l);
+
+	t = bench_now();
+	list_sort(&l, 1);
+	ms[4] = (bench_now() - t) * 1e3;
+
+	list_attributes_keyer(&l, bench_keyer);
+	t = bench_now();
+	list_sort(&l, -1);
+	ms[5] = (bench_now() - t) * 1e3;
+	bad += bench_unsorted(&l);
+
+	t = bench_now();
+	srand(2);
+	for (i = 0; i < BENCH_ACCESSES; i++) {
+		pos = rand() % n;
+		list_insert_at(&l, &v[0], pos);
+		list_delete_at(&l, pos);
+	}
+	ms[6] = (bench_now() - t) * 1e3;
+
+	printf("%-10s %8.1f %9.1f %8.1f %8.1f %9.1f %9.1f %10.1f   %u out of order\n", name, ms[0], ms[1], ms[2], ms[3],
+			ms[4], ms[5], ms[6], bad);
+
+	list_destroy(&l);
+}
+
+/** Main entry function
+ * \param argc	number of parameters inserted in command line
+ * \param argv 	array of all parameters inserted in command line
+ * \return 		0 in case of success; errorcode in case of an error
+ */
+int main(int argc, char** argv) {
+	unsigned int n = (argc > 1 ? (unsigned int) atoi(argv[1]) : 100000), i;
+	long *v;
+	void **junk;
+
+	if (n == 0)
+		n = 1;
+	v = (long *) malloc(n * sizeof(long));
+	junk = (void **) malloc(n * sizeof(void *));
+	if (!v || !junk) {
+		perror("out of memory");
+		return (1);
+	}
+	srand(7);
+	for (i = 0; i < n; i++)
+		v[i] = rand();
+
+	/* scatter the heap: blocks of a few sizes, every other one freed */
+	for (i = 0; i < n; i++)
+		junk[i] = malloc(24 + (i % 5) * 8);
+	for (i = 0; i < n; i += 2)
+		free(junk[i]);
+
+	printf("%u elements, times in ms\n", n);
+	printf("%-10s %8s %9s %8s %8s %9s %9s %10s\n", "storage", "append", "get_at", "seek", "sort", "sort rev",
+			"keyed", "ins+del");
+	bench_run("node", 0, 0, v, n);
+	bench_run("node pool", 1, 0, v, n);
+	bench_run("chunk 32", 2, 32, v, n);
+	bench_run("chunk 64", 2, 64, v, n);
+
+	for (i = 1; i < n; i += 2)
+		free(junk[i]);
+	free(junk);
+	free(v);
+
+	return (0);
+}
@@ -0,0 +1,380 @@
+/**
+ *      \file coords.c
+ * 		\brief Implementation file for the Coordinate Table
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "coords.h"
+#include "utils.h"
+
+/** Initial number of rows allocated */
+#define COORDS_MIN_SIZE 1024
+/** Number of rows whose distances are calculated at once by the scans */
+#define COORDS_BLOCK 256
+
+/** Degrees in one radian, the same used by distance() */
+#define COORDS_DEGREES 57.29578
+
+/** Radius of the Earth in metres, the same used by distance() */
+#define COORDS_EARTH_METRES 6371000.0
+
+/** Array of the names of the distance measures, by eCOORDS_MODE */
+static const char *coords_mode_names[] = { "exact", "chord", "equirect" };
+
+/**
+ * Grow an aligned column of the table, keeping its content.
+ * \param col       reference to the column
+ * \param elsize    size of each row of the column
+ * \param numels    number of rows in use
+ * \param size      new number of rows
+ * \return          0 for success. -1 for failure
+ */
+static int coords_grow_column(void **col, size_t elsize, unsigned int numels, unsigned int size) {
+	void *tmp;
+
+	if (posix_memalign(&tmp, COORDS_ALIGN, size * elsize) != 0)
+		return -1;
+	if (*col != NULL) {
+		memcpy(tmp, *col, numels * elsize);
+		free(*col);
+	}
+	*col = tmp;
+
+	return 0;
+}
+
+/** Set the position of a row */
+static inline void coords_set(coords_t *c, unsigned int i, float latitude, float longitude) {
+	double d_lat = (double) (latitude / COORDS_DEGREES);
+	double d_lon = (double) (longitude / COORDS_DEGREES);
+
+	c->latitude[i] = latitude;
+	c->longitude[i] = longitude;
+	c->x[i] = cos(d_lat) * cos(d_lon);
+	c->y[i] = cos(d_lat) * sin(d_lon);
+	c->z[i] = sin(d_lat);
+}
+
+/** Find the row of an element, or -1 if not found */
+static int coords_find(const coords_t *c, const void *data) {
+	unsigned int i;
+
+	for (i = 0; i < c->numels; i++)
+		if (c->data[i] == data)
+			return (int) i;
+
+	return -1;
+}
+
+int coords_init(coords_t *c) {
+	if (c == NULL)
+		return -1;
+
+	memset(c, 0, sizeof(*c));
+
+	return 0;
+}
+
+void coords_destroy(coords_t *c) {
+	free(c->latitude);
+	free(c->longitude);
+	free(c->x);
+	free(c->y);
+	free(c->z);
+	free(c->data);
+	coords_init(c);
+}
+
+void coords_clear(coords_t *c) {
+	c->numels = 0;
+}
+
+int coords_append(coords_t *c, float latitude, float longitude, void *data) {
+	if (c->numels == c->size) {
+		unsigned int size = (c->size == 0 ? COORDS_MIN_SIZE : c->size * 2);
+
+		if (coords_grow_column((void **) &c->latitude, sizeof(float), c->numels, size) != 0
+				|| coords_grow_column((void **) &c->longitude, sizeof(float), c->numels, size) != 0
+				|| coords_grow_column((void **) &c->x, sizeof(double), c->numels, size) != 0
+				|| coords_grow_column((void **) &c->y, sizeof(double), c->numels, size) != 0
+				|| coords_grow_column((void **) &c->z, sizeof(double), c->numels, size) != 0
+				|| coords_grow_column((void **) &c->data, sizeof(void *), c->numels, size) != 0)
+			return -1;
+		c->size = size;
+	}
+
+	coords_set(c, c->numels, latitude, longitude);
+	c->data[c->numels] = data;
+	c->numels++;
+
+	return 0;
+}
+
+int coords_remove(coords_t *c, const void *data) {
+	int i = coords_find(c, data);
+
+	if (i < 0)
+		return -1;
+
+	return coords_remove_row(c, (unsigned int) i);
+}
+
+int coords_remove_row(coords_t *c, unsigned int row) {
+	unsigned int last;
+
+	if (row >= c->numels)
+		return -1;
+
+	last = --c->numels;
+	c->latitude[row] = c->latitude[last];
+	c->longitude[row] = c->longitude[last];
+	c->x[row] = c->x[last];
+	c->y[row] = c->y[last];
+	c->z[row] = c->z[last];
+	c->data[row] = c->data[last];
+
+	return 0;
+}
+
+int coords_move(coords_t *c, const void *data, float latitude, float longitude) {
+	int i = coords_find(c, data);
+
+	if (i < 0)
+		return -1;
+
+	return coords_move_row(c, (unsigned int) i, latitude, longitude);
+}
+
+int coords_move_row(coords_t *c, unsigned int row, float latitude, float longitude) {
+	if (row >= c->numels)
+		return -1;
+
+	coords_set(c, row, latitude, longitude);
+
+	return 0;
+}
+
+void coords_mode(coords_t *c, eCOORDS_MODE mode) {
+	c->mode = mode;
+}
+
+const char *coords_mode_name(eCOORDS_MODE mode) {
+	if (mode < COORDS_EXACT || mode > COORDS_EQUIRECT)
+		return "?";
+	return coords_mode_names[mode];
+}
+
+int coords_mode_find(const char *s) {
+	int i;
+
+	for (i = COORDS_EXACT; i <= COORDS_EQUIRECT; i++) {
+		if (strcmp(s, coords_mode_names[i]) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+void coords_distances(const coords_t *c, float latitude, float longitude, double *out) {
+	distance_batch(latitude, longitude, c->latitude, c->longitude, out, c->numels);
+}
+
+/**
+ * Calculate the ordering measure, in the mode of the table, from a GPS point to a run of rows.
+ * \param c         table to operate
+ * \param latitude  GPS latitude of the point
+ * \param longitude GPS longitude of the point
+ * \param i         first row
+ * \param n         number of rows
+ * \param out       array of n measures to fill
+ */
+static void coords_measure(const coords_t *c, float latitude, float longitude, unsigned int i, unsigned int n,
+		double *out) {
+	double d_lat = (double) (latitude / COORDS_DEGREES);
+	double d_lon = (double) (longitude / COORDS_DEGREES);
+	unsigned int j;
+
+	switch (c->mode) {
+	case COORDS_CHORD: {
+		double ux = cos(d_lat) * cos(d_lon), uy = cos(d_lat) * sin(d_lon), uz = sin(d_lat);
+		const double *x = c->x + i, *y = c->y + i, *z = c->z + i;
+
+		for (j = 0; j < n; j++)
+			out[j] = (x[j] - ux) * (x[j] - ux) + (y[j] - uy) * (y[j] - uy) + (z[j] - uz) * (z[j] - uz);
+		break;
+	}
+	case COORDS_EQUIRECT: {
+		double k = cos(d_lat);
+		const float *lat = c->latitude + i, *lon = c->longitude + i;
+
+		for (j = 0; j < n; j++) {
+			double dy = lat[j] - latitude;
+			double dx = lon[j] - longitude;
+
+			/* the shorter way around the 180 meridian */
+			if (dx > 180)
+				dx -= 360;
+			else if (dx < -180)
+				dx += 360;
+			dx *= k;
+			out[j] = dx * dx + dy * dy;
+		}
+		break;
+	}
+	default:
+		distance_batch(latitude, longitude, c->latitude + i, c->longitude + i, out, n);
+		break;
+	}
+}
+
+void coords_sortkeys(const coords_t *c, float latitude, float longitude, struct list_sortkey_s *keys) {
+	double d[COORDS_BLOCK];
+	unsigned int i, j, n;
+
+	for (i = 0; i < c->numels; i += n) {
+		n = (c->numels - i < COORDS_BLOCK ? c->numels - i : COORDS_BLOCK);
+		coords_measure(c, latitude, longitude, i, n, d);
+		for (j = 0; j < n; j++) {
+			keys[i + j].key = d[j];
+			keys[i + j].data = c->data[i + j];
+		}
+	}
+}
+
+void coords_radixkeys(const coords_t *c, float latitude, float longitude, struct list_radixkey_s *keys) {
+	double d[COORDS_BLOCK];
+	unsigned int i, j, n;
+
+	for (i = 0; i < c->numels; i += n) {
+		n = (c->numels - i < COORDS_BLOCK ? c->numels - i : COORDS_BLOCK);
+		coords_measure(c, latitude, longitude, i, n, d);
+		for (j = 0; j < n; j++) {
+			double m;
+
+			/* metres along the measure: the squared ones are not linear near the user */
+			switch (c->mode) {
+			case COORDS_CHORD:
+				m = sqrt(d[j]) * COORDS_EARTH_METRES;
+				break;
+			case COORDS_EQUIRECT:
+				m = sqrt(d[j]) / COORDS_DEGREES * COORDS_EARTH_METRES;
+				break;
+			default:
+				m = d[j] * 1000;
+				break;
+			}
+			keys[i + j].key = (m < UINT32_MAX ? (uint32_t) (m + 0.5) : UINT32_MAX);
+			keys[i + j].data = c->data[i + j];
+		}
+	}
+}
+
+/** Row selected by coords_select() */
+struct coords_hit_s {
+	/** Measure from the query point */
+	double key;
+	/** Row of the table */
+	unsigned int row;
+};
+
+/** Restore the max-heap property of keys, from position i down */
+static void coords_heap_down(struct coords_hit_s *heap, unsigned int n, unsigned int i) {
+	struct coords_hit_s tmp = heap[i];
+	unsigned int m;
+
+	for (; (m = 2 * i + 1) < n; i = m) {
+		if (m + 1 < n && heap[m + 1].key > heap[m].key)
+			m++;
+		if (heap[m].key <= tmp.key)
+			break;
+		heap[i] = heap[m];
+	}
+	heap[i] = tmp;
+}
+
+unsigned int coords_select(const coords_t *c, float latitude, float longitude, unsigned int k,
+		element_seeker seeker, const void *indicator, void **out) {
+	double dist[COORDS_BLOCK];
+	struct coords_hit_s *heap;
+	unsigned int i, j, n = 0;
+
+	if (k == 0)
+		return 0;
+
+	heap = (struct coords_hit_s *) malloc(k * sizeof(struct coords_hit_s));
+	if (heap == NULL)
+		return 0;
+
+	/* heap[0] is the farthest selected row */
+	for (i = 0; i < c->numels; i++) {
+		double d;
+
+		if (i % COORDS_BLOCK == 0)
+			coords_measure(c, latitude, longitude, i, (c->numels - i < COORDS_BLOCK ? c->numels - i : COORDS_BLOCK),
+					dist);
+		d = dist[i % COORDS_BLOCK];
+
+		if (n == k && d >= heap[0].key)
+			continue;
+		if (seeker != NULL && seeker(c->data[i], indicator) == 0)
+			continue;
+
+		if (n < k) {
+			for (j = n++; j > 0 && heap[(j - 1) / 2].key < d; j = (j - 1) / 2)
+				heap[j] = heap[(j - 1) / 2];
+			heap[j].key = d;
+			heap[j].row = i;
+		} else {
+			heap[0].key = d;
+			heap[0].row = i;
+			coords_heap_down(heap, k, 0);
+		}
+	}
+
+	/* heap sort: move the farthest to the end */
+	for (j = n; j > 1; j--) {
+		struct coords_hit_s tmp = heap[0];
+
+		heap[0] = heap[j - 1];
+		heap[j - 1] = tmp;
+		coords_heap_down(heap, j - 1, 0);
+	}
+
+	/* the projection does not keep the order: rank the few selected rows by the exact distance */
+	if (c->mode == COORDS_EQUIRECT) {
+		for (i = 0; i < n; i++) {
+			struct coords_hit_s tmp = heap[i];
+
+			tmp.key = distance(latitude, longitude, c->latitude[tmp.row], c->longitude[tmp.row]);
+			for (j = i; j > 0 && heap[j - 1].key > tmp.key; j--)
+				heap[j] = heap[j - 1];
+			heap[j] = tmp;
+		}
+	}
+
+	for (i = 0; i < n; i++)
+		out[i] = c->data[heap[i].row];
+	free(heap);
+
+	return n;
+}
@@ -0,0 +1,223 @@
+/**
+ *      \file coords.h
+ * 		\brief Heather file for the Coordinate Table
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifndef _COORDS_H
+#define	_COORDS_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "acdll.h"
+
+/** Alignment, in bytes, of every column of the table (a cache line) */
+#define COORDS_ALIGN 64
+
+/** Enumerator for the measures used to order the rows by distance */
+typedef enum {
+	/** Great circle distance, as given by distance_batch() */
+	COORDS_EXACT,
+	/** Squared chord between unit vectors: same order as the exact distance, without trigonometry */
+	COORDS_CHORD,
+	/** Squared equirectangular projection around the point: approximate order, cheapest */
+	COORDS_EQUIRECT
+} eCOORDS_MODE;
+
+/**
+ * \brief Type defenition for struct coords_s
+ * \see coords_s
+ */
+typedef struct coords_s coords_t;
+
+/** Coordinate Table: the GPS position of a set of elements stored by columns
+ * \remarks Distance scans read a few contiguous, cache aligned arrays instead of
+ * following list nodes to every element. Rows have no particular order.
+ */
+struct coords_s {
+	/** GPS Latitude of each row */
+	float *latitude;
+	/** GPS Longitude of each row */
+	float *longitude;
+	/** Unit vector of each row, X component */
+	double *x;
+	/** Unit vector of each row, Y component */
+	double *y;
+	/** Unit vector of each row, Z component */
+	double *z;
+	/** Element data pointer of each row */
+	void **data;
+	/** Number of rows */
+	unsigned int numels;
+	/** Number of rows allocated */
+	unsigned int size;
+	/** Measure used to order the rows by coords_sortkeys() and coords_select() */
+	eCOORDS_MODE mode;
+};
+
+/**
+ * Initialize a table object for use.
+ * \param c     must point to a user-provided memory location
+ * \return      0 for success. -1 for failure
+ */
+int coords_init(coords_t *c);
+
+/**
+ * Completely remove the table from memory.
+ * \param c     table to destroy
+ * \remarks The element data is not freed.
+ */
+void coords_destroy(coords_t *c);
+
+/**
+ * Remove all rows from the table.
+ * \param c     table to operate
+ */
+void coords_clear(coords_t *c);
+
+/**
+ * Add a row to the table.
+ * \param c         table to operate
+ * \param latitude  GPS latitude of the element
+ * \param longitude GPS longitude of the element
+ * \param data      pointer to user data
+ * \return          0 for success. -1 for failure
+ */
+int coords_append(coords_t *c, float latitude, float longitude, void *data);
+
+/**
+ * Remove the row of an element from the table.
+ * \param c     table to operate
+ * \param data  pointer to user data
+ * \return      0 for success. -1 if the element was not found
+ * \remarks The last row takes the place of the removed one.
+ */
+int coords_remove(coords_t *c, const void *data);
+
+/**
+ * Remove a row from the table, given its number.
+ * \param c     table to operate
+ * \param row   [0,numels-1] row to remove
+ * \return      0 for success. -1 if there is no such row
+ * \remarks The last row takes the place of the removed one: the caller keeping rows of
+ * elements finds in c->data[row] the element whose row changed, if row < c->numels.
+ */
+int coords_remove_row(coords_t *c, unsigned int row);
+
+/**
+ * Change the GPS position of an element in the table.
+ * \param c         table to operate
+ * \param data      pointer to user data
+ * \param latitude  new GPS latitude of the element
+ * \param longitude new GPS longitude of the element
+ * \return          0 for success. -1 if the element was not found
+ */
+int coords_move(coords_t *c, const void *data, float latitude, float longitude);
+
+/**
+ * Change the GPS position of a row of the table, given its number.
+ * \param c         table to operate
+ * \param row       [0,numels-1] row to change
+ * \param latitude  new GPS latitude of the element
+ * \param longitude new GPS longitude of the element
+ * \return          0 for success. -1 if there is no such row
+ */
+int coords_move_row(coords_t *c, unsigned int row, float latitude, float longitude);
+
+/**
+ * Set the measure used to order the rows by distance.
+ * \param c     table to operate
+ * \param mode  measure to use; the table starts with COORDS_EXACT
+ */
+void coords_mode(coords_t *c, eCOORDS_MODE mode);
+
+/**
+ * Get the name of a distance measure.
+ * \param mode  measure
+ * \return      its name, or "?" for an unknown one
+ */
+const char *coords_mode_name(eCOORDS_MODE mode);
+
+/**
+ * Get a distance measure by its name.
+ * \param s     name of the measure, as given by coords_mode_name()
+ * \return      the measure, or -1 if not found
+ */
+int coords_mode_find(const char *s);
+
+/**
+ * Calculate the distance from a GPS point to every row of the table.
+ * \param c         table to operate
+ * \param latitude  GPS latitude of the point
+ * \param longitude GPS longitude of the point
+ * \param out       array of at least c->numels distances to fill, in Km, by row
+ * \see distance_batch
+ */
+void coords_distances(const coords_t *c, float latitude, float longitude, double *out);
+
+/**
+ * Fill the sort keys of a list with the distance from a GPS point to every row of the table.
+ * \param c         table to operate
+ * \param latitude  GPS latitude of the point
+ * \param longitude GPS longitude of the point
+ * \param keys      array of at least c->numels keys to fill, by row
+ * \remarks The keys are distances in Km only in COORDS_EXACT mode; otherwise they just
+ * order the rows.
+ * \see list_sort_keys
+ */
+void coords_sortkeys(const coords_t *c, float latitude, float longitude, struct list_sortkey_s *keys);
+
+/**
+ * Fill the integer sort keys of a list with the distance, in metres, from a GPS point
+ * to every row of the table.
+ * \param c         table to operate
+ * \param latitude  GPS latitude of the point
+ * \param longitude GPS longitude of the point
+ * \param keys      array of at least c->numels keys to fill, by row
+ * \remarks The keys are rounded to the metre, so rows closer than that may tie. In
+ * COORDS_CHORD and COORDS_EQUIRECT modes they are metres along the chord or the flat
+ * projection, which only order the rows as coords_sortkeys() does.
+ * \see list_sort_radix
+ */
+void coords_radixkeys(const coords_t *c, float latitude, float longitude, struct list_radixkey_s *keys);
+
+/**
+ * Select the k rows nearest to a GPS point, among those accepted by a seeker.
+ * \param c         table to operate
+ * \param latitude  GPS latitude of the point
+ * \param longitude GPS longitude of the point
+ * \param k         maximum number of elements to select
+ * \param seeker    function seeker for the elements to select, or NULL for all
+ * \param indicator data to pass to the seeker along with elements
+ * \param out       array of at least k references to fill, nearest first
+ * \return          number of elements stored in out
+ * \remarks The seeker, and so the element data, is only called for rows near enough
+ * to enter the selection. In COORDS_EQUIRECT mode the selected rows are ordered again by
+ * their exact distance.
+ */
+unsigned int coords_select(const coords_t *c, float latitude, float longitude, unsigned int k,
+		element_seeker seeker, const void *indicator, void **out);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _COORDS_H */
@@ -0,0 +1,859 @@
+/**
+ *      \file import.c
+ * 		\brief Implementation file for the CSV importer of the Restaurant List
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "import.h"
+
+/** Most threads an import parses on */
+#define IMPORT_MAX_THREADS 64
+/** Number of fields of a line */
+#define IMPORT_FIELDS 11
+/** Number of text fields of a line */
+#define IMPORT_TEXTS 8
+#ifndef IMPORT_STREAM_MIN_BLOCK
+/** Least bytes of the file each block of a streaming import holds */
+#define IMPORT_STREAM_MIN_BLOCK (64 * 1024)
+#endif
+
+/** Field of the restaurant for each text field of a line, in file order */
+static const eRESTAURANTE_FIELDS import_texts[IMPORT_TEXTS] = { NAME, STREET, TOWN, LOCALITY, E_MAIL, URL,
+		FOOD_TYPE, OBS };
+/** Column of each text field of a line */
+static const unsigned int import_text_columns[IMPORT_TEXTS] = { 2, 3, 4, 6, 7, 8, 9, 10 };
+
+/** Fields of a line, pointing into the file */
+struct import_line_s {
+	/** GPS Longitude */
+	float longitude;
+	/** GPS Latitude */
+	float latitude;
+	/** Zip code */
+	int zip_code;
+	/** Start of each text field, by import_texts */
+	const char *text[IMPORT_TEXTS];
+	/** Length of each text field; 0 if empty */
+	unsigned int len[IMPORT_TEXTS];
+};
+
+/** Line aligned chunk of the file, parsed by one thread */
+struct import_chunk_s {
+	/** First line of the chunk */
+	const char *begin;
+	/** End of the last line of the chunk */
+	const char *end;
+	/** Number of lines imported */
+	unsigned int rows;
+	/** Number of lines rejected */
+	unsigned int rejected;
+	/** Bytes taken by the text of the lines imported, with their terminators */
+	size_t bytes;
+	/** Restaurants to fill, one per line imported */
+	struct restaurant_s *rs;
+	/** Text records of the restaurants */
+	struct restaurant_text_s *texts;
+	/** Room for the text */
+	char *strings;
+	/** Food type of each restaurant, in strings; NULL if empty */
+	const char **foods;
+	/** Thread parsing the chunk */
+	pthread_t thread;
+	/** True if the thread was started */
+	int threaded;
+};
+
+/** Block of the file going through the stages of a streaming import */
+struct import_block_s {
+	/** Bytes of the file, with room for a terminator past the last */
+	char *buf;
+	/** Offset of the first line of the block */
+	size_t begin;
+	/** Offset of the end of the last line of the block */
+	size_t end;
+	/** Fields of the lines imported, pointing into buf */
+	struct import_line_s *lines;
+	/** Number of lines imported */
+	unsigned int numlines;
+	/** Number of lines allocated in lines */
+	unsigned int size;
+	/** Number of lines rejected */
+	unsigned int rejected;
+	/** 1 once parsed, -1 if the parse ran out of memory, 0 before */
+	int parsed;
+};
+
+/** Stages of a streaming import, and the queues of blocks between them
+ * \remarks Each block goes from the free queue to the reader, to the read queue, to a
+ * parser and back to the read queue, where the writer takes it in file order. There are
+ * only so many blocks: the reader waits for free ones whenever the others fall behind.
+ */
+struct import_stream_s {
+	/** CSV file */
+	int fd;
+	/** Bytes of the file a block holds */
+	size_t size;
+	/** Blocks */
+	struct import_block_s *blocks;
+	/** Number of blocks */
+	unsigned int numblocks;
+	/** Free queue: blocks for the reader to fill */
+	struct import_block_s **free;
+	/** Number of blocks in the free queue */
+	unsigned int numfree;
+	/** Read queue: blocks read, in file order, as a ring of numblocks */
+	struct import_block_s **queue;
+	/** Number of blocks ever put in the read queue */
+	unsigned long read;
+	/** Number of blocks ever taken by the parsers */
+	unsigned long taken;
+	/** Number of blocks ever written */
+	unsigned long written;
+	/** Lines rejected by the reader, for being longer than a block */
+	unsigned int rejected;
+	/** True once the reader is done */
+	int eof;
+	/** True if reading the file failed */
+	int error;
+	/** True when the reader and the parsers are to stop */
+	int stop;
+	/** Lock of the queues */
+	pthread_mutex_t lock;
+	/** Signaled on every change to the queues */
+	pthread_cond_t cond;
+};
+
+/** Parse a decimal number, with an optional sign and fraction
+ * \param s     start of the number
+ * \param end   end of the number
+ * \param out   number parsed
+ * \return      0 if the whole of [s, end) is a number; -1 otherwise
+ */
+static int import_number(const char *s, const char *end, double *out) {
+	double v = 0, scale = 1;
+	int neg = 0, digits = 0;
+
+	if (s < end && (*s == '-' || *s == '+'))
+		neg = (*s++ == '-');
+	for (; s < end && *s >= '0' && *s <= '9'; s++, digits++)
+		v = v * 10 + (*s - '0');
+	if (s < end && *s == '.') {
+		for (s++; s < end && *s >= '0' && *s <= '9'; s++, digits++)
+			v += (*s - '0') * (scale /= 10);
+	}
+	if (digits == 0 || s != end)
+		return -1;
+
+	*out = (neg ? -v : v);
+	return 0;
+}
+
+/** Split a line in its fields
+ * \param p     start of the line
+ * \param end   end of the line, without its terminator
+ * \param ln    fields of the line
+ * \return      0 if the line holds a restaurant; -1 if it is rejected
+ */
+static int import_line(const char *p, const char *end, struct import_line_s *ln) {
+	const char *f[IMPORT_FIELDS], *q;
+	unsigned int n[IMPORT_FIELDS], i;
+	double lon, lat, zip;
+
+	for (i = 0; i < IMPORT_FIELDS; i++) {
+		q = (const char *) memchr(p, ';', end - p);
+		if (q == NULL) {
+			/* only the last field may end the line without ';' */
+			if (i < IMPORT_FIELDS - 1)
+				return -1;
+			q = end;
+		}
+		f[i] = p;
+		n[i] = q - p;
+		p = (q < end ? q + 1 : q);
+	}
+
+	if (import_number(f[0], f[0] + n[0], &lon) != 0 || import_number(f[1], f[1] + n[1], &lat) != 0
+			|| import_number(f[5], f[5] + n[5], &zip) != 0)
+		return -1;
+	if (lon < -180 || lon > 180 || lat < -90 || lat > 90 || zip != (int) zip)
+		return -1;
+	ln->longitude = (float) lon;
+	ln->latitude = (float) lat;
+	ln->zip_code = (int) zip;
+
+	for (i = 0; i < IMPORT_TEXTS; i++) {
+		ln->text[i] = f[import_text_columns[i]];
+		ln->len[i] = n[import_text_columns[i]];
+	}
+	/* a town equal to the locality is left empty, as the menu shows them both */
+	if (ln->len[2] == ln->len[3] && memcmp(ln->text[2], ln->text[3], ln->len[2]) == 0)
+		ln->len[2] = 0;
+
+	return 0;
+}
+
+/** Get to the next line of a chunk
+ * \param p     start of the line
+ * \param end   end of the chunk
+ * \param eol   end of the line, without its terminator
+ * \return      start of the next line
+ */
+static inline const char *import_next_line(const char *p, const char *end, const char **eol) {
+	const char *q = (const char *) memchr(p, '\n', end - p);
+
+	if (q == NULL)
+		q = end;
+	*eol = (q > p && q[-1] == '\r' ? q - 1 : q);
+
+	return (q < end ? q + 1 : q);
+}
+
+/** Count the lines of a chunk imported and rejected, and the bytes their text takes,
+ * as the routine of its thread
+ * \param arg   the chunk, a struct import_chunk_s
+ * \return      NULL
+ */
+static void *import_count(void *arg) {
+	struct import_chunk_s *c = (struct import_chunk_s *) arg;
+	struct import_line_s ln;
+	const char *p, *next, *eol;
+	unsigned int i;
+
+	for (p = c->begin; p < c->end; p = next) {
+		next = import_next_line(p, c->end, &eol);
+		if (eol == p)
+			continue;
+		if (import_line(p, eol, &ln) != 0) {
+			c->rejected++;
+			continue;
+		}
+		c->rows++;
+		for (i = 0; i < IMPORT_TEXTS; i++) {
+			if (ln.len[i] > 0)
+				c->bytes += ln.len[i] + 1;
+		}
+	}
+
+	return NULL;
+}
+
+/** Fill the restaurants of the lines of a chunk, as the routine of its thread
+ * \param arg   the chunk, a struct import_chunk_s, with room for the restaurants counted
+ * \return      NULL
+ */
+static void *import_fill(void *arg) {
+	struct import_chunk_s *c = (struct import_chunk_s *) arg;
+	struct import_line_s ln;
+	const char *p, *next, *eol;
+	char *s = c->strings, **field;
+	unsigned int i, row = 0;
+	prestaurant_t r;
+
+	for (p = c->begin; p < c->end; p = next) {
+		next = import_next_line(p, c->end, &eol);
+		if (eol == p || import_line(p, eol, &ln) != 0)
+			continue;
+
+		r = &c->rs[row];
+		memset(r, 0, sizeof(*r));
+		r->text = &c->texts[row];
+		memset(r->text, 0, sizeof(*r->text));
+		r->arena = 1;
+		r->longitude = ln.longitude;
+		r->latitude = ln.latitude;
+		r->text->zip_code = ln.zip_code;
+		c->foods[row] = NULL;
+
+		for (i = 0; i < IMPORT_TEXTS; i++) {
+			if (ln.len[i] == 0)
+				continue;
+			memcpy(s, ln.text[i], ln.len[i]);
+			s[ln.len[i]] = '\0';
+			field = restaurant_text_field(r, import_texts[i]);
+			if (field != NULL) {
+				*field = s;
+				/* the text lives in the arena of the Restaurant List */
+				r->text->borrowed |= 1 << import_texts[i];
+			} else {
+				/* the food types table is not shared by the threads: resolved on insert */
+				c->foods[row] = s;
+			}
+			s += ln.len[i] + 1;
+		}
+		row++;
+	}
+
+	return NULL;
+}
+
+/** Run a routine on every chunk, each on a thread of its own
+ * \param chunks    chunks
+ * \param n         number of chunks
+ * \param routine   routine
+ * \remarks The first chunk, and any whose thread could not be started, run on the calling thread.
+ */
+static void import_run(struct import_chunk_s *chunks, unsigned int n, void *(*routine)(void *)) {
+	unsigned int i;
+
+	for (i = 1; i < n; i++)
+		chunks[i].threaded = (pthread_create(&chunks[i].thread, NULL, routine, &chunks[i]) == 0);
+	routine(&chunks[0]);
+	for (i = 1; i < n; i++) {
+		if (chunks[i].threaded)
+			pthread_join(chunks[i].thread, NULL);
+		else
+			routine(&chunks[i]);
+	}
+}
+
+/** Read as much of a file as fits a buffer
+ * \param fd    file
+ * \param buf   buffer
+ * \param len   size of the buffer
+ * \return      bytes read, less than len only at the end of the file; -1 on errors
+ */
+static ssize_t import_stream_fill(int fd, char *buf, size_t len) {
+	size_t got = 0;
+	ssize_t rt;
+
+	while (got < len) {
+		rt = read(fd, buf + got, len - got);
+		if (rt < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (rt == 0)
+			break;
+		got += rt;
+	}
+
+	return (ssize_t) got;
+}
+
+/** Take a block from the free queue of a streaming import, waiting for one
+ * \param s     streaming import
+ * \return      the block, or NULL if the import is to stop
+ */
+static struct import_block_s *import_stream_take(struct import_stream_s *s) {
+	struct import_block_s *b = NULL;
+
+	pthread_mutex_lock(&s->lock);
+	while (!s->stop && s->numfree == 0)
+		pthread_cond_wait(&s->cond, &s->lock);
+	if (!s->stop)
+		b = s->free[--s->numfree];
+	pthread_mutex_unlock(&s->lock);
+
+	return b;
+}
+
+/** Read the file of a streaming import into blocks, cut at the end of their last line,
+ * as the routine of the reader thread
+ * \param arg   the streaming import, a struct import_stream_s
+ * \return      NULL
+ */
+static void *import_stream_read(void *arg) {
+	struct import_stream_s *s = (struct import_stream_s *) arg;
+	struct import_block_s *b, *next;
+	size_t carry = 0, len, nl;
+	ssize_t got;
+	int skipping = 0, error = 0;
+
+	b = import_stream_take(s);
+	while (b != NULL) {
+		/* the block starts with what the previous one had past its last line */
+		got = import_stream_fill(s->fd, b->buf + carry, s->size - carry);
+		if (got < 0) {
+			perror("read");
+			error = 1;
+			break;
+		}
+		len = carry + got;
+		b->begin = 0;
+		if (skipping) {
+			/* the rest of a line longer than a block */
+			while (b->begin < len && b->buf[b->begin] != '\n')
+				b->begin++;
+			if (b->begin < len) {
+				b->begin++;
+				skipping = 0;
+			}
+		}
+
+		if (len < s->size) {
+			/* end of the file: the last line may lack its terminator */
+			b->end = len;
+			pthread_mutex_lock(&s->lock);
+			s->queue[s->read++ % s->numblocks] = b;
+			pthread_mutex_unlock(&s->lock);
+			break;
+		}
+
+		for (nl = len; nl > b->begin && b->buf[nl - 1] != '\n'; nl--)
+			;
+		if (nl == b->begin) {
+			/* no line ends in the block: read on into the same block */
+			if (b->begin == 0) {
+				s->rejected++;
+				skipping = 1;
+				carry = 0;
+			} else {
+				carry = len - b->begin;
+				memmove(b->buf, b->buf + b->begin, carry);
+			}
+			continue;
+		}
+
+		b->end = nl;
+		next = import_stream_take(s);
+		if (next == NULL)
+			break;
+		carry = len - nl;
+		memcpy(next->buf, b->buf + nl, carry);
+		pthread_mutex_lock(&s->lock);
+		s->queue[s->read++ % s->numblocks] = b;
+		pthread_cond_broadcast(&s->cond);
+		pthread_mutex_unlock(&s->lock);
+		b = next;
+	}
+
+	pthread_mutex_lock(&s->lock);
+	s->error = error;
+	s->eof = 1;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->lock);
+
+	return NULL;
+}
+
+/** Split the lines of a block of a streaming import
+ * \param b     block
+ * \return      0 for success. -1 if out of memory
+ * \remarks The text fields are ended in place, in the block.
+ */
+static int import_stream_parse_block(struct import_block_s *b) {
+	struct import_line_s *ln;
+	const char *p, *next, *eol, *end = b->buf + b->end;
+	unsigned int i;
+
+	b->numlines = 0;
+	b->rejected = 0;
+	for (p = b->buf + b->begin; p < end; p = next) {
+		next = import_next_line(p, end, &eol);
+		if (eol == p)
+			continue;
+		if (b->numlines == b->size) {
+			unsigned int size = (b->size > 0 ? b->size * 2 : 1024);
+
+			ln = (struct import_line_s *) realloc(b->lines, size * sizeof(struct import_line_s));
+			if (ln == NULL)
+				return -1;
+			b->lines = ln;
+			b->size = size;
+		}
+		ln = &b->lines[b->numlines];
+		if (import_line(p, eol, ln) != 0) {
+			b->rejected++;
+			continue;
+		}
+		for (i = 0; i < IMPORT_TEXTS; i++) {
+			if (ln->len[i] > 0)
+				((char *) ln->text[i])[ln->len[i]] = '\0';
+		}
+		b->numlines++;
+	}
+
+	return 0;
+}
+
+/** Parse the blocks of a streaming import, as the routine of a parser thread
+ * \param arg   the streaming import, a struct import_stream_s
+ * \return      NULL
+ */
+static void *import_stream_parse(void *arg) {
+	struct import_stream_s *s = (struct import_stream_s *) arg;
+	struct import_block_s *b;
+	int parsed;
+
+	pthread_mutex_lock(&s->lock);
+	for (;;) {
+		while (!s->stop && s->taken == s->read && !s->eof)
+			pthread_cond_wait(&s->cond, &s->lock);
+		if (s->stop || s->taken == s->read)
+			break;
+		b = s->queue[s->taken++ % s->numblocks];
+		pthread_mutex_unlock(&s->lock);
+
+		parsed = (import_stream_parse_block(b) == 0 ? 1 : -1);
+
+		pthread_mutex_lock(&s->lock);
+		b->parsed = parsed;
+		pthread_cond_broadcast(&s->cond);
+	}
+	pthread_mutex_unlock(&s->lock);
+
+	return NULL;
+}
+
+/** Write the restaurants of the lines of a parsed block to a dump
+ * \param ds        dump
+ * \param b         block
+ * \param filler    filler of the other fields, or NULL
+ * \param rows      number of restaurants written before, updated
+ * \return          0 for success. -1 for failure
+ */
+static int import_stream_write(struct list_dump_stream_s *ds, const struct import_block_s *b, import_filler filler,
+		unsigned int *rows) {
+	const struct import_line_s *ln;
+	struct restaurant_s r;
+	struct restaurant_text_s t;
+	const char *food;
+	char **field;
+	void *rec;
+	unsigned int i, j, len;
+
+	for (i = 0; i < b->numlines; i++) {
+		ln = &b->lines[i];
+		memset(&r, 0, sizeof(r));
+		memset(&t, 0, sizeof(t));
+		r.text = &t;
+		r.id = *rows;
+		r.longitude = ln->longitude;
+		r.latitude = ln->latitude;
+		t.zip_code = ln->zip_code;
+		food = "";
+		for (j = 0; j < IMPORT_TEXTS; j++) {
+			if (ln->len[j] == 0)
+				continue;
+			field = restaurant_text_field(&r, import_texts[j]);
+			if (field != NULL) {
+				/* the text lives in the block until written */
+				*field = (char *) ln->text[j];
+				t.borrowed |= 1 << import_texts[j];
+			} else {
+				/* written by name: the food types of the Restaurant List are not touched */
+				food = ln->text[j];
+			}
+		}
+		if (filler != NULL)
+			filler(&r);
+
+		rec = restaurant_serialize(&r, r.food_type != 0 ? restaurant_food_type_name(r.food_type) : food, &len);
+		if (rec == NULL || list_dump_stream_put(ds, rec, len) != 0) {
+			free(rec);
+			return -1;
+		}
+		free(rec);
+		(*rows)++;
+	}
+
+	return 0;
+}
+
+int import_csv(const char *filename, unsigned int threads, import_filler filler, struct import_stats_s *st) {
+	struct import_chunk_s chunks[IMPORT_MAX_THREADS];
+	struct timespec t0, t1;
+	struct stat sb;
+	const char *addr = NULL, *eol, **foods = NULL;
+	char *block = NULL, *q;
+	prestaurant_t *rs = NULL;
+	unsigned int i, j, n, rows = 0, rejected = 0;
+	size_t size, bytes = 0;
+	long cpus;
+	int fd, rt = -1;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0 || fstat(fd, &sb) != 0) {
+		perror(filename);
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	size = (size_t) sb.st_size;
+	if (size > 0) {
+		addr = (const char *) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr == (const char *) MAP_FAILED) {
+			perror(filename);
+			close(fd);
+			return -1;
+		}
+		madvise((void *) addr, size, MADV_SEQUENTIAL);
+	}
+
+	if (threads == 0) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (cpus > 0 ? (unsigned int) cpus : 1);
+	}
+	n = (threads < IMPORT_MAX_THREADS ? threads : IMPORT_MAX_THREADS);
+	if (n > size / IMPORT_MIN_CHUNK)
+		n = size / IMPORT_MIN_CHUNK;
+	if (n == 0)
+		n = 1;
+
+	/* split at the first line starting past every n-th of the file */
+	memset(chunks, 0, n * sizeof(struct import_chunk_s));
+	for (i = 0; i < n; i++) {
+		chunks[i].begin = (i == 0 ? addr : chunks[i - 1].end);
+		eol = (i == n - 1 ? NULL : (const char *) memchr(addr + size / n * (i + 1), '\n',
+				size - size / n * (i + 1)));
+		chunks[i].end = (eol != NULL ? eol + 1 : addr + size);
+		if (chunks[i].end < chunks[i].begin)
+			chunks[i].end = chunks[i].begin;
+	}
+
+	import_run(chunks, n, import_count);
+	for (i = 0; i < n; i++) {
+		rows += chunks[i].rows;
+		rejected += chunks[i].rejected;
+		bytes += chunks[i].bytes;
+	}
+
+	if (rows > 0) {
+		/* one block for every restaurant, its text record and its text */
+		block = (char *) list_arena_alloc(&list_restaurants,
+				(size_t) rows * (sizeof(struct restaurant_s) + sizeof(struct restaurant_text_s)) + bytes);
+		foods = (const char **) malloc(rows * sizeof(const char *));
+		if (block == NULL || foods == NULL) {
+			perror("out of memory");
+			goto out;
+		}
+		q = block + (size_t) rows * (sizeof(struct restaurant_s) + sizeof(struct restaurant_text_s));
+		for (i = 0, j = 0; i < n; j += chunks[i].rows, i++) {
+			chunks[i].rs = (struct restaurant_s *) block + j;
+			chunks[i].texts = (struct restaurant_text_s *) (block + (size_t) rows * sizeof(struct restaurant_s)) + j;
+			chunks[i].foods = foods + j;
+			chunks[i].strings = q;
+			q += chunks[i].bytes;
+		}
+		import_run(chunks, n, import_fill);
+
+		/* food types and the filler on the calling thread, in file order; the restaurants
+		 * follow one another in the block, as do their food types */
+		rs = (prestaurant_t *) malloc(rows * sizeof(prestaurant_t));
+		if (rs == NULL) {
+			perror("out of memory");
+			goto out;
+		}
+		for (j = 0; j < rows; j++) {
+			rs[j] = (struct restaurant_s *) block + j;
+			if (foods[j] != NULL)
+				restaurant_set_text(rs[j], FOOD_TYPE, foods[j]);
+			if (filler != NULL)
+				filler(rs[j]);
+		}
+		if (restaurant_insert_array(rs, rows) < 0) {
+			perror("out of memory");
+			goto out;
+		}
+	}
+	rt = (int) rows;
+
+out:
+	free(rs);
+	free(foods);
+	if (addr != NULL)
+		munmap((void *) addr, size);
+	close(fd);
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	if (st != NULL) {
+		st->rows = (rt < 0 ? 0 : rows);
+		st->rejected = rejected;
+		st->threads = n;
+		st->seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	}
+
+	return rt;
+}
+
+int import_csv_stream(const char *filename, const char *dumpname, unsigned int threads, size_t memory,
+		import_filler filler, struct import_stats_s *st) {
+	struct import_stream_s s;
+	struct list_dump_stream_s ds;
+	struct import_block_s *b;
+	pthread_t reader, parsers[IMPORT_MAX_THREADS];
+	struct timespec t0, t1;
+	unsigned int i, n, started = 0, rows = 0, rejected = 0;
+	long cpus;
+	int out = -1, dumping = 0, reading = 0, failed = 0, rt = -1, err;
+	char *tmpname;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	memset(&s, 0, sizeof(s));
+	s.fd = open(filename, O_RDONLY);
+	if (s.fd < 0) {
+		perror(filename);
+		return -1;
+	}
+	posix_fadvise(s.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	/* the dump is written aside and renamed over dumpname once complete: a failure leaves no partial one */
+	tmpname = (char *) malloc(strlen(dumpname) + sizeof(IMPORT_STREAM_TMP_SUFFIX));
+	if (!tmpname) {
+		perror("out of memory");
+		close(s.fd);
+		return -1;
+	}
+	strcpy(tmpname, dumpname);
+	strcat(tmpname, IMPORT_STREAM_TMP_SUFFIX);
+	out = open(tmpname, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (out < 0 || list_dump_stream_open(&ds, out, 0) != 0) {
+		perror(tmpname);
+		goto out;
+	}
+	dumping = 1;
+
+	if (threads == 0) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (cpus > 0 ? (unsigned int) cpus : 1);
+	}
+	n = (threads < IMPORT_MAX_THREADS ? threads : IMPORT_MAX_THREADS);
+
+	/* a block being read, one being written, and two for each parser: one parsed, one queued */
+	s.numblocks = 2 * n + 2;
+	s.size = (memory > 0 ? memory : IMPORT_STREAM_MEMORY) / s.numblocks;
+	if (s.size < IMPORT_STREAM_MIN_BLOCK)
+		s.size = IMPORT_STREAM_MIN_BLOCK;
+	s.blocks = (struct import_block_s *) calloc(s.numblocks, sizeof(struct import_block_s));
+	s.free = (struct import_block_s **) malloc(s.numblocks * sizeof(struct import_block_s *));
+	s.queue = (struct import_block_s **) malloc(s.numblocks * sizeof(struct import_block_s *));
+	if (s.blocks == NULL || s.free == NULL || s.queue == NULL) {
+		perror("out of memory");
+		goto out;
+	}
+	for (i = 0; i < s.numblocks; i++) {
+		s.blocks[i].buf = (char *) malloc(s.size + 1);
+		if (s.blocks[i].buf == NULL) {
+			perror("out of memory");
+			goto out;
+		}
+		s.free[s.numfree++] = &s.blocks[i];
+	}
+
+	pthread_mutex_init(&s.lock, NULL);
+	pthread_cond_init(&s.cond, NULL);
+	err = pthread_create(&reader, NULL, import_stream_read, &s);
+	reading = (err == 0);
+	for (i = 0; i < n && reading; i++) {
+		err = pthread_create(&parsers[started], NULL, import_stream_parse, &s);
+		if (err == 0)
+			started++;
+	}
+	if (!reading || started == 0) {
+		errno = err;
+		perror("pthread_create");
+		failed = 1;
+	}
+
+	/* write the blocks in file order, as the parsers are done with them */
+	pthread_mutex_lock(&s.lock);
+	while (!failed) {
+		while (s.written == s.read && !s.eof)
+			pthread_cond_wait(&s.cond, &s.lock);
+		if (s.written == s.read)
+			break;
+		b = s.queue[s.written % s.numblocks];
+		while (b->parsed == 0)
+			pthread_cond_wait(&s.cond, &s.lock);
+		pthread_mutex_unlock(&s.lock);
+
+		if (b->parsed < 0) {
+			perror("out of memory");
+			failed = 1;
+		} else if (import_stream_write(&ds, b, filler, &rows) != 0) {
+			perror(tmpname);
+			failed = 1;
+		}
+		rejected += b->rejected;
+
+		pthread_mutex_lock(&s.lock);
+		b->parsed = 0;
+		s.written++;
+		s.free[s.numfree++] = b;
+		pthread_cond_broadcast(&s.cond);
+	}
+	/* done, or failed: the reader and the parsers are no longer waited for */
+	s.stop = 1;
+	pthread_cond_broadcast(&s.cond);
+	pthread_mutex_unlock(&s.lock);
+
+	if (reading)
+		pthread_join(reader, NULL);
+	for (i = 0; i < started; i++)
+		pthread_join(parsers[i], NULL);
+	pthread_cond_destroy(&s.cond);
+	pthread_mutex_destroy(&s.lock);
+	rejected += s.rejected;
+
+	dumping = 0;
+	if (list_dump_stream_close(&ds) != 0 && !failed) {
+		perror(tmpname);
+		failed = 1;
+	}
+	if (!failed && !s.error) {
+		if (rename(tmpname, dumpname) == 0)
+			rt = (int) rows;
+		else
+			perror(dumpname);
+	}
+
+out:
+	if (dumping)
+		list_dump_stream_close(&ds);
+	if (out >= 0 && rt < 0)
+		unlink(tmpname);
+	free(tmpname);
+	if (s.blocks != NULL) {
+		for (i = 0; i < s.numblocks; i++) {
+			free(s.blocks[i].buf);
+			free(s.blocks[i].lines);
+		}
+	}
+	free(s.blocks);
+	free(s.free);
+	free(s.queue);
+	if (out >= 0)
+		close(out);
+	close(s.fd);
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	if (st != NULL) {
+		st->rows = (rt < 0 ? 0 : rows);
+		st->rejected = rejected;
+		st->threads = started;
+		st->seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	}
+
+	return rt;
+}
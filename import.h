@@ -0,0 +1,119 @@
+/**
+ *      \file import.h
+ * 		\brief Heather file for the CSV importer of the Restaurant List
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifndef _IMPORT_H
+#define	_IMPORT_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "restaurant.h"
+
+#ifndef IMPORT_MIN_CHUNK
+/** Least number of bytes of the file each thread of an import parses */
+#define IMPORT_MIN_CHUNK (1 << 20)
+#endif
+
+#ifndef IMPORT_STREAM_MEMORY
+/** Default bytes of the file a streaming import holds at once */
+#define IMPORT_STREAM_MEMORY (64 << 20)
+#endif
+
+#ifndef IMPORT_STREAM_TMP_SUFFIX
+/** Suffix of the name import_csv_stream() writes a dump under until it is complete */
+#define IMPORT_STREAM_TMP_SUFFIX ".part"
+#endif
+
+/**
+ * Filler of the fields a CSV line has no column for, called on each restaurant
+ * imported, in file order, just before it is inserted in the Restaurant List.
+ * \param r     restaurant imported
+ */
+typedef void (*import_filler)(prestaurant_t r);
+
+/** Outcome of an import
+ * \see import_csv
+ */
+struct import_stats_s {
+	/** Lines imported as restaurants */
+	unsigned int rows;
+	/** Lines rejected: too few fields, or coordinates or zip code that are not numbers */
+	unsigned int rejected;
+	/** Threads the file was parsed on */
+	unsigned int threads;
+	/** Time the import took, in seconds */
+	double seconds;
+};
+
+/**
+ * Import the restaurants of a CSV file of points of interest into the Restaurant List.
+ *
+ * Each line holds, ended by ';', the longitude, latitude, name, street, town, zip code,
+ * locality, e-mail, URL, food type and observations of a restaurant. The file is mapped
+ * in memory and split in line aligned chunks, parsed on one thread each; the restaurants
+ * and their text are then allocated at once, from the arena of the Restaurant List, and
+ * inserted in file order.
+ *
+ * \param filename  CSV file
+ * \param threads   most threads to parse on; 0 for one per online processor
+ * \param filler    filler of the other fields; NULL to leave them empty
+ * \param st        filled with the outcome of the import; may be NULL
+ * \return          number of restaurants imported, or -1 if the file cannot be read
+ * \remarks A town equal to the locality is left empty.
+ */
+int import_csv(const char *filename, unsigned int threads, import_filler filler, struct import_stats_s *st);
+
+/**
+ * Convert a CSV file of points of interest into a dump file of restaurants, in a fixed
+ * amount of memory.
+ *
+ * The lines are those of import_csv(), but the restaurants never make it to the
+ * Restaurant List: a reader thread reads the file in blocks, parser threads split
+ * the lines of each block, and the calling thread writes their restaurants, in file
+ * order, to the dump file. The stages hand the blocks over through bounded queues, so
+ * the reader waits for the writer whenever the writer falls behind, and the file may
+ * be much larger than the memory.
+ *
+ * \param filename  CSV file
+ * \param dumpname  dump file to write, as restaurant_save() does; it is overwritten
+ * \param threads   parser threads; 0 for one per online processor
+ * \param memory    bytes of the CSV file held at once; 0 for IMPORT_STREAM_MEMORY
+ * \param filler    filler of the other fields; NULL to leave them empty
+ * \param st        filled with the outcome of the conversion; may be NULL
+ * \return          number of restaurants written, or -1 if a file cannot be read or written
+ * \remarks The restaurants are numbered from 0, in file order. Loading the dump with
+ * restaurant_load_file() builds their spatial indexes. A line longer than a block is
+ * rejected.
+ * \remarks The dump is written to dumpname with IMPORT_STREAM_TMP_SUFFIX appended, and
+ * renamed to dumpname once complete: on failure it is removed, and a dump already at
+ * dumpname is left as it was. The food types go to the dump by name, without being added
+ * to those of the Restaurant List, unless the filler sets one.
+ */
+int import_csv_stream(const char *filename, const char *dumpname, unsigned int threads, size_t memory,
+		import_filler filler, struct import_stats_s *st);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _IMPORT_H */
@@ -0,0 +1,376 @@
+/**
+ *      \file loadgen.c
+ * 		\brief Load generator for the query server of the Restaurant List
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ *
+ *      \par Usage
+ *      loadgen SOCKET QUERIES [CLIENTS [SECONDS [DEPTH]]] \n
+ *      Connects CLIENTS clients to the server on SOCKET, each writing the queries of the
+ *      file QUERIES, in turn and over again, for SECONDS seconds, with DEPTH queries
+ *      waiting for their answers at a time, and reports the queries answered per second
+ *      and the latency of their answers as seen by the clients.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/** Client of the server */
+struct loadgen_client_s {
+	/** Thread of the client */
+	pthread_t thread;
+	/** First query it writes */
+	unsigned int first;
+	/** Latencies of its answers, in microseconds */
+	double *lat;
+	/** Number of latencies in lat */
+	unsigned long answers;
+	/** Number of latencies allocated in lat */
+	unsigned long size;
+	/** Answers to malformed queries */
+	unsigned long errors;
+	/** The client failed */
+	int failed;
+};
+
+/** Path of the server socket */
+static const char *loadgen_path;
+/** Query lines, each with its end */
+static char **loadgen_queries;
+/** Number of query lines */
+static unsigned int loadgen_nqueries;
+/** Queries a client has waiting for their answers at a time */
+static unsigned int loadgen_depth = 1;
+/** Time the clients stop writing queries */
+static struct timespec loadgen_deadline;
+
+/**
+ * Microseconds from a time to another
+ * \param a     earlier time
+ * \param b     later time
+ * \return      microseconds from a to b
+ */
+static double loadgen_micros(const struct timespec *a, const struct timespec *b) {
+	return (b->tv_sec - a->tv_sec) * 1e6 + (b->tv_nsec - a->tv_nsec) / 1e3;
+}
+
+/**
+ * Compare two latencies
+ * \param a     latency
+ * \param b     latency
+ * \return      <0, 0, or >0 as a is lower than, equal to or higher than b
+ */
+static int loadgen_cmp(const void *a, const void *b) {
+	double x = *(const double *) a, y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * Percentile of sorted latencies, by the nearest rank
+ * \param lat   latencies, sorted
+ * \param n     number of latencies
+ * \param p     percentile, 0 to 100
+ * \return      latency of the percentile; 0 without latencies
+ */
+static double loadgen_percentile(const double *lat, unsigned long n, double p) {
+	unsigned long i;
+
+	if (n == 0)
+		return 0;
+	i = (unsigned long) (p / 100 * n + 0.999999);
+	return lat[i > 0 ? i - 1 : 0];
+}
+
+/**
+ * Read the query lines of a file; those that hold no query get no answer and are left out
+ * \param filename  file of queries
+ * \return          number of queries read, or -1 if the file cannot be read
+ */
+static int loadgen_read(const char *filename) {
+	FILE *fp;
+	char *line = NULL, *p, **tmp;
+	size_t size = 0, len;
+	ssize_t r;
+	unsigned int room = 0;
+
+	fp = fopen(filename, "r");
+	if (!fp) {
+		perror(filename);
+		return -1;
+	}
+	while ((r = getline(&line, &size, fp)) > 0) {
+		for (p = line; *p == ' ' || *p == '\t'; p++)
+			;
+		if (*p == '\n' || *p == '\r' || *p == '#' || *p == '\0')
+			continue;
+		len = (size_t) r;
+		if (loadgen_nqueries == room) {
+			room = (room > 0 ? room * 2 : 1024);
+			tmp = (char **) realloc(loadgen_queries, room * sizeof(char *));
+			if (tmp == NULL) {
+				perror("out of memory");
+				break;
+			}
+			loadgen_queries = tmp;
+		}
+		p = (char *) malloc(len + 2);
+		if (p == NULL) {
+			perror("out of memory");
+			break;
+		}
+		memcpy(p, line, len);
+		if (p[len - 1] != '\n')
+			p[len++] = '\n';
+		p[len] = '\0';
+		loadgen_queries[loadgen_nqueries++] = p;
+	}
+	free(line);
+	fclose(fp);
+
+	return (int) loadgen_nqueries;
+}
+
+/**
+ * Write a whole buffer to a socket
+ * \param fd    socket
+ * \param buf   bytes to write
+ * \param len   number of bytes
+ * \return      0, or -1 if it cannot be written
+ */
+static int loadgen_write(int fd, const char *buf, size_t len) {
+	ssize_t r;
+
+	while (len > 0) {
+		r = write(fd, buf, len);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += r;
+		len -= r;
+	}
+
+	return 0;
+}
+
+/**
+ * Client thread: writes queries and reads their answers till the deadline
+ * \param arg   client
+ * \return      NULL
+ */
+static void *loadgen_run(void *arg) {
+	struct loadgen_client_s *cl = (struct loadgen_client_s *) arg;
+	struct sockaddr_un addr;
+	struct timespec *sent = NULL, now;
+	FILE *rf = NULL;
+	char *line = NULL;
+	size_t size = 0;
+	unsigned int next = cl->first, head = 0, inflight = 0, nhits, i;
+	double *tmp;
+	int fd, stopping = 0;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, loadgen_path, sizeof(addr.sun_path) - 1);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		perror(loadgen_path);
+		cl->failed = 1;
+		if (fd >= 0)
+			close(fd);
+		return NULL;
+	}
+	rf = fdopen(dup(fd), "r");
+	sent = (struct timespec *) malloc(loadgen_depth * sizeof(struct timespec));
+	if (rf == NULL || sent == NULL) {
+		perror("out of memory");
+		cl->failed = 1;
+		goto out;
+	}
+
+	for (;;) {
+		/* keep depth queries waiting, till the deadline */
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (loadgen_micros(&loadgen_deadline, &now) >= 0)
+			stopping = 1;
+		while (!stopping && inflight < loadgen_depth) {
+			sent[(head + inflight) % loadgen_depth] = now;
+			if (loadgen_write(fd, loadgen_queries[next], strlen(loadgen_queries[next])) < 0) {
+				perror("write");
+				cl->failed = 1;
+				goto out;
+			}
+			next = (next + 1) % loadgen_nqueries;
+			inflight++;
+		}
+		if (inflight == 0)
+			break;
+
+		/* an answer is a line Q with the number of restaurants found, then one line
+		 * R for each, or a line E for a malformed query */
+		if (getline(&line, &size, rf) <= 0) {
+			fprintf(stderr, "server closed the connection\n");
+			cl->failed = 1;
+			goto out;
+		}
+		if (line[0] == 'Q') {
+			if (sscanf(line, "Q\t%*u\t%u", &nhits) != 1) {
+				fprintf(stderr, "bad answer: %s", line);
+				cl->failed = 1;
+				goto out;
+			}
+			for (i = 0; i < nhits; i++) {
+				if (getline(&line, &size, rf) <= 0) {
+					fprintf(stderr, "server closed the connection\n");
+					cl->failed = 1;
+					goto out;
+				}
+			}
+		} else {
+			cl->errors++;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		if (cl->answers == cl->size) {
+			cl->size = (cl->size > 0 ? cl->size * 2 : 4096);
+			tmp = (double *) realloc(cl->lat, cl->size * sizeof(double));
+			if (tmp == NULL) {
+				perror("out of memory");
+				cl->failed = 1;
+				goto out;
+			}
+			cl->lat = tmp;
+		}
+		cl->lat[cl->answers++] = loadgen_micros(&sent[head], &now);
+		head = (head + 1) % loadgen_depth;
+		inflight--;
+	}
+
+out:
+	free(line);
+	free(sent);
+	if (rf != NULL)
+		fclose(rf);
+	close(fd);
+
+	return NULL;
+}
+
+/** Main entry function
+ * \param argc	number of parameters inserted in command line
+ * \param argv 	array of all parameters inserted in command line
+ * \return 		0 in case of success; errorcode in case of an error
+ */
+int main(int argc, char** argv) {
+	struct loadgen_client_s *clients;
+	struct timespec t0, t1;
+	unsigned int nclients = 4, i;
+	unsigned long answers = 0, errors = 0, n;
+	double seconds = 5, *lat;
+	int failed = 0;
+
+	if (argc < 3 || argc > 6) {
+		printf("Usage: %s SOCKET QUERIES [CLIENTS [SECONDS [DEPTH]]]\n", argv[0]);
+		return (1);
+	}
+	loadgen_path = argv[1];
+	if (argc > 3)
+		nclients = atoi(argv[3]);
+	if (argc > 4)
+		seconds = atof(argv[4]);
+	if (argc > 5)
+		loadgen_depth = atoi(argv[5]);
+	if (nclients == 0 || seconds <= 0 || loadgen_depth == 0) {
+		printf("CLIENTS, SECONDS and DEPTH must be positive\n");
+		return (1);
+	}
+
+	if (loadgen_read(argv[2]) <= 0) {
+		fprintf(stderr, "%s: no queries\n", argv[2]);
+		return (1);
+	}
+
+	clients = (struct loadgen_client_s *) calloc(nclients, sizeof(struct loadgen_client_s));
+	if (clients == NULL) {
+		perror("out of memory");
+		return (1);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	loadgen_deadline = t0;
+	loadgen_deadline.tv_sec += (time_t) seconds;
+	loadgen_deadline.tv_nsec += (long) ((seconds - (time_t) seconds) * 1e9);
+	if (loadgen_deadline.tv_nsec >= 1000000000L) {
+		loadgen_deadline.tv_sec++;
+		loadgen_deadline.tv_nsec -= 1000000000L;
+	}
+
+	for (i = 0; i < nclients; i++) {
+		/* the clients start at different queries */
+		clients[i].first = (unsigned int) ((unsigned long) i * loadgen_nqueries / nclients);
+		if (pthread_create(&clients[i].thread, NULL, loadgen_run, &clients[i]) != 0) {
+			perror("pthread_create");
+			return (1);
+		}
+	}
+	for (i = 0; i < nclients; i++) {
+		pthread_join(clients[i].thread, NULL);
+		answers += clients[i].answers;
+		errors += clients[i].errors;
+		failed |= clients[i].failed;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	seconds = loadgen_micros(&t0, &t1) / 1e6;
+
+	lat = (double *) malloc((answers > 0 ? answers : 1) * sizeof(double));
+	if (lat == NULL) {
+		perror("out of memory");
+		return (1);
+	}
+	for (i = 0, n = 0; i < nclients; i++) {
+		memcpy(lat + n, clients[i].lat, clients[i].answers * sizeof(double));
+		n += clients[i].answers;
+		free(clients[i].lat);
+	}
+	qsort(lat, answers, sizeof(double), loadgen_cmp);
+
+	printf("%lu answers in %.3f s from %u clients, %u queries in flight each: %.0f queries/s\n", answers, seconds,
+			nclients, loadgen_depth, seconds > 0 ? answers / seconds : 0);
+	printf("latency p50 %.1f us, p90 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us; %lu malformed queries\n",
+			loadgen_percentile(lat, answers, 50), loadgen_percentile(lat, answers, 90),
+			loadgen_percentile(lat, answers, 99), loadgen_percentile(lat, answers, 99.9),
+			answers > 0 ? lat[answers - 1] : 0, errors);
+
+	free(lat);
+	free(clients);
+	for (i = 0; i < loadgen_nqueries; i++)
+		free(loadgen_queries[i]);
+	free(loadgen_queries);
+
+	return (failed ? 1 : 0);
+}
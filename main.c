@@ -21,8 +21,15 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
 #include "main.h"
 #include "restaurant.h"
+#include "import.h"
+#include "query.h"
+#include "server.h"
 #include "main_menu.h"
 #include "utils.h"
 
@@ -32,10 +39,12 @@ void get_user_gps_pos() {
 	user_longitude = kget_float("Longitude :");
 	user_latitude = kget_float("Latitude :");
 }
-/** Get user GPS position from file  */
+/** Get user GPS position from file
+ * \return number of the coordinates found, 2 for both. -1 if the file is missing
+ */
 int get_user_gps_pos_from_file() {
 	FILE *fp;
-	int n = 0;
+	int lon = 0, lat = 0;
 	float vl;
 	char str[80];
 
@@ -44,20 +53,54 @@ int get_user_gps_pos_from_file() {
 		printf("File not fount :%s/%s .\n", exe_path, "user.txt");
 		return -1;
 	}
-	while (!feof(fp)) {
-		fgets(str, 80, fp);
-
-		if (sscanf(str, "longitude=%f\n5", &vl) != 0) {
+	while (fgets(str, 80, fp) != NULL) {
+		if (sscanf(str, "longitude=%f", &vl) == 1) {
 			user_longitude = vl;
-			n++;
+			lon = 1;
 		}
-		if (sscanf(str, "latitude=%f\n", &vl) != 0) {
+		if (sscanf(str, "latitude=%f", &vl) == 1) {
 			user_latitude = vl;
-			n++;
+			lat = 1;
 		}
 	}
 	fclose(fp);
-	return n;
+	return lon + lat;
+}
+
+/**
+ * Parse a count of the command line
+ * \param s     argument to parse
+ * \param n     count parsed
+ * \return      0 for success. -1 if s is not a number from 0 to UINT_MAX
+ */
+int parse_count(const char *s, unsigned int *n) {
+	unsigned long v;
+	char *end;
+
+	/* strtoul() would take a sign, and wrap "-1" around */
+	if (*s < '0' || *s > '9')
+		return -1;
+	errno = 0;
+	v = strtoul(s, &end, 10);
+	if (*end != '\0' || errno != 0 || v > UINT_MAX)
+		return -1;
+	*n = (unsigned int) v;
+
+	return 0;
+}
+
+/** Print the command line usage */
+void usage() {
+	printf("Usage: %s [options]\n", exe_path);
+	printf("  -k N                 list only the N nearest restaurants\n");
+	printf("  --load FILE          import the restaurants from FILE\n");
+	printf("  --distance MODE      order by exact, chord or equirect distance\n");
+	printf("  --threads N          sort, import and serve on N threads, 0 for one per processor\n");
+	printf("  --open               list the open restaurants and exit\n");
+	printf("  --find FIELD VALUE   list the restaurants with FIELD equal to VALUE and exit\n");
+	printf("  --convert CSV FILE   convert the points of interest in CSV into FILE and exit\n");
+	printf("  --queries FILE       answer the queries in FILE, - for stdin, and exit\n");
+	printf("  --serve SOCKET       answer queries on the Unix domain SOCKET, on --threads workers\n");
 }
 
 /** Main entry function
@@ -66,12 +109,121 @@ int get_user_gps_pos_from_file() {
  * \return 		0 in case of success; errorcode in case of an error
  */
 int main(int argc, char** argv) {
+	int i;
+	int query = 0;
+	int field = -1;
+	const char *value = NULL;
+	const char *csv = NULL;
+	struct import_stats_s st;
+	struct query_stats_s qst;
+	struct server_stats_s sst;
+	FILE *fp;
+
 	exe_path = argv[0];
 
-	if (get_user_gps_pos_from_file() < 2)
+	restaurant_init();
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+			if (parse_count(argv[++i], &restaurant_top_k) < 0) {
+				usage();
+				return (1);
+			}
+		} else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+			if (restaurant_load_file(argv[++i]) < 0) {
+				perror(argv[i]);
+				return (1);
+			}
+		} else if (strcmp(argv[i], "--distance") == 0 && i + 1 < argc) {
+			int mode = coords_mode_find(argv[++i]);
+			if (mode < 0) {
+				printf("Unknown distance mode: %s\n", argv[i]);
+				return (1);
+			}
+			restaurant_distance_mode = mode;
+		} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			if (parse_count(argv[++i], &restaurant_threads) < 0) {
+				usage();
+				return (1);
+			}
+		} else if (strcmp(argv[i], "--open") == 0) {
+			query = 'o';
+		} else if (strcmp(argv[i], "--find") == 0 && i + 2 < argc) {
+			query = 'f';
+			field = restaurant_field_find(argv[++i]);
+			value = argv[++i];
+			if (field < 0) {
+				printf("Unknown field: %s\n", argv[i - 1]);
+				return (1);
+			}
+		} else if (strcmp(argv[i], "--convert") == 0 && i + 2 < argc) {
+			query = 'c';
+			csv = argv[++i];
+			value = argv[++i];
+		} else if (strcmp(argv[i], "--queries") == 0 && i + 1 < argc) {
+			query = 'q';
+			value = argv[++i];
+		} else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+			query = 's';
+			value = argv[++i];
+		} else {
+			usage();
+			return (1);
+		}
+	}
+
+	/* batches bring their own positions, and may read stdin */
+	if (query == 'q') {
+		fp = (strcmp(value, "-") == 0 ? stdin : fopen(value, "r"));
+		if (!fp) {
+			perror(value);
+			return (1);
+		}
+		i = query_batch(fp, stdout, &qst);
+		if (fp != stdin)
+			fclose(fp);
+		if (i < 0)
+			return (1);
+		fprintf(stderr, "Answered %u queries in %.3f s (%.0f queries/s), %u lines rejected; p50 %.1f us, p99 %.1f us\n",
+				qst.queries, qst.seconds, qst.seconds > 0 ? qst.queries / qst.seconds : 0, qst.rejected, qst.p50,
+				qst.p99);
+		return (0);
+	}
+	if (query == 's') {
+		fprintf(stderr, "Serving %u restaurants on %s\n", list_size(&list_restaurants), value);
+		if (server_run(value, restaurant_threads, &sst) < 0)
+			return (1);
+		fprintf(stderr, "Answered %lu queries in %.3f s on %lu connections, %lu lines rejected\n", sst.queries,
+				sst.seconds, sst.connections, sst.rejected);
+		return (0);
+	}
+	if (query == 'c') {
+		if (import_csv_stream(csv, value, restaurant_threads, 0, NULL, &st) < 0)
+			return (1);
+		printf("Converted %u restaurants in %.3f s (%.0f rows/s) on %u threads, %u lines rejected\n", st.rows,
+				st.seconds, st.seconds > 0 ? st.rows / st.seconds : 0, st.threads, st.rejected);
+		return (0);
+	}
+
+	if (get_user_gps_pos_from_file() < 2) {
+		/* the non-interactive queries must not wait on a prompt */
+		if (query != 0) {
+			printf("user.txt must give the longitude and the latitude of the user\n");
+			return (1);
+		}
 		get_user_gps_pos();
+	}
+
+	/* non-interactive queries */
+	if (query == 'o') {
+		restaurant_list_all_open();
+		return (0);
+	}
+	if (query == 'f') {
+		restaurant_find_all(field, value);
+		return (0);
+	}
 
-	restaurant_init();
 	while (main_menu() > 0) {
 	}
 
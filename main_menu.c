@@ -26,6 +26,7 @@
 #include <string.h>
 #include "main_menu.h"
 #include "restaurant.h"
+#include "import.h"
 #include "utils.h"
 #include "main.h"
 
@@ -39,6 +40,9 @@
 #define MENU_OPTION_07_STR "* 7 - Find restaurants              *\n"
 #define MENU_OPTION_08_STR "* 8 - List Open restaurants         *\n"
 #define MENU_OPTION_09_STR "* 9 - List all restaurants          *\n"
+#define MENU_OPTION_10_STR "* 10- List nearest restaurants      *\n"
+#define MENU_OPTION_11_STR "* 11- Set number of results         *\n"
+#define MENU_OPTION_12_STR "* 12- Set distance mode             *\n"
 #define MENU_OPTION_99_STR "* 99- Load test data                *\n"
 #define MENU_OPTION_SEP_STR "*************************************\n"
 
@@ -62,6 +66,33 @@ prestaurant_t rest_find() {
 	return restaurant_find(i, vlt);
 }
 
+/** Read a text field of a restaurant from the keyboard
+ * \param r         pointer to the restaurant
+ * \param f         field to read
+ * \param mess      message to show
+ * \param max_count maximum number of characters
+ */
+static void menu_get_text(prestaurant_t r, eRESTAURANTE_FIELDS f, const char *mess, int max_count) {
+	char *s = kget_char(mess, max_count);
+
+	if (s != NULL) {
+		restaurant_set_text(r, f, s);
+		free(s);
+	}
+}
+
+/** Read a vacation date of a restaurant from the keyboard
+ * \param mess  message to show
+ * \param date  date to fill
+ */
+static void menu_get_date(const char *mess, struct restaurant_date_s *date) {
+	struct tm tmp;
+
+	kget_day_month(mess, &tmp);
+	date->day = tmp.tm_mday;
+	date->month = tmp.tm_mon;
+}
+
 /** Menu option for exit the main programm */
 void menu_exit() {
 	printf(MENU_OPTION_SEP_STR);
@@ -91,43 +122,43 @@ void menu_insert() {
 			r->latitude = kget_float(mess);
 			break;
 		case NAME:
-			strcpy(r->name, kget_char(mess, 255));
+			menu_get_text(r, NAME, mess, 255);
 			break;
 		case STREET:
-			strcpy(r->street, kget_char(mess, 255));
+			menu_get_text(r, STREET, mess, 255);
 			break;
 		case TOWN:
-			strcpy(r->town, kget_char(mess, 255));
+			menu_get_text(r, TOWN, mess, 255);
 			break;
 		case ZIP_CODE:
-			r->zip_code = kget_int(mess);
+			r->text->zip_code = kget_int(mess);
 			break;
 		case LOCALITY:
-			strcpy(r->locality, kget_char(mess, 255));
+			menu_get_text(r, LOCALITY, mess, 255);
 			break;
 		case E_MAIL:
-			strcpy(r->e_mail, kget_char(mess, 255));
+			menu_get_text(r, E_MAIL, mess, 255);
 			break;
 		case URL:
-			strcpy(r->url, kget_char(mess, 255));
+			menu_get_text(r, URL, mess, 255);
 			break;
 		case FOOD_TYPE:
-			strcpy(r->food_type, kget_char(mess, 100));
+			menu_get_text(r, FOOD_TYPE, mess, 100);
 			break;
 		case WEEKLY_REST:
 			r->weekly_rest = kget_int(" Weekly rest (0 -> Sun ... 6 -> Sat):");
 			break;
 		case VACATION_FROM:
-			kget_day_month(" Start Vacation (dd/mm):", &r->vacation_from);
+			menu_get_date(" Start Vacation (dd/mm):", &r->vacation_from);
 			break;
 		case VACATION_TO:
-			kget_day_month(" End Vacation (dd/mm):", &r->vacation_to);
+			menu_get_date(" End Vacation (dd/mm):", &r->vacation_to);
 			break;
 		case PHONE:
-			r->phone = kget_int(mess);
+			r->text->phone = kget_int(mess);
 			break;
 		case OBS:
-			strcpy(r->obs, kget_char(mess, 500));
+			menu_get_text(r, OBS, mess, 500);
 			break;
 		}
 	}
@@ -164,7 +195,7 @@ void menu_delete() {
  * \see rest_find
  */
 void menu_edit() {
-	prestaurant_t r;
+	prestaurant_t r, c;
 	printf(MENU_OPTION_SEP_STR);
 	printf(MENU_OPTION_03_STR);
 	printf(MENU_OPTION_SEP_STR);
@@ -176,10 +207,11 @@ void menu_edit() {
 		char *s;
 		restaurant_print(r);
 		s = kget_char("Edit this restaurant (y/n)?", 2);
-		if (strcmp(s, "y") == 0) {
+		if (strcmp(s, "y") == 0 && (c = restaurant_copy(r)) != NULL) {
 			int i;
 			char mess[80];
 
+			/* the copy is edited: r may be held by a snapshot, and is replaced once done */
 			do {
 				for (i = LONGITUDE; i <= OBS; i++) {
 					printf(" %5i -> %s\n", i, restaurant_get_field_name(i));
@@ -190,52 +222,57 @@ void menu_edit() {
 				sprintf(mess, "\n%s == ", restaurant_get_field_name(i));
 				switch (i) {
 				case LONGITUDE:
-					r->longitude = kget_float(mess);
+					c->longitude = kget_float(mess);
 					break;
 				case LATITUDE:
-					r->latitude = kget_float(mess);
+					c->latitude = kget_float(mess);
 					break;
 				case NAME:
-					strcpy(r->name, kget_char(mess, 255));
+					menu_get_text(c, NAME, mess, 255);
 					break;
 				case STREET:
-					strcpy(r->street, kget_char(mess, 255));
+					menu_get_text(c, STREET, mess, 255);
 					break;
 				case TOWN:
-					strcpy(r->town, kget_char(mess, 255));
+					menu_get_text(c, TOWN, mess, 255);
 					break;
 				case ZIP_CODE:
-					r->zip_code = kget_int(mess);
+					c->text->zip_code = kget_int(mess);
 					break;
 				case LOCALITY:
-					strcpy(r->locality, kget_char(mess, 255));
+					menu_get_text(c, LOCALITY, mess, 255);
 					break;
 				case E_MAIL:
-					strcpy(r->e_mail, kget_char(mess, 255));
+					menu_get_text(c, E_MAIL, mess, 255);
 					break;
 				case URL:
-					strcpy(r->url, kget_char(mess, 255));
+					menu_get_text(c, URL, mess, 255);
 					break;
 				case FOOD_TYPE:
-					strcpy(r->food_type, kget_char(mess, 100));
+					menu_get_text(c, FOOD_TYPE, mess, 100);
 					break;
 				case WEEKLY_REST:
-					r->weekly_rest = kget_int(mess);
+					c->weekly_rest = kget_int(mess);
 					break;
 				case VACATION_FROM:
-					kget_day_month("(dd/mm) ", &r->vacation_from);
+					menu_get_date("(dd/mm) ", &c->vacation_from);
 					break;
 				case VACATION_TO:
-					kget_day_month("(dd/mm) ", &r->vacation_to);
+					menu_get_date("(dd/mm) ", &c->vacation_to);
 					break;
 				case PHONE:
-					r->phone = kget_int(mess);
+					c->text->phone = kget_int(mess);
 					break;
 				case OBS:
-					strcpy(r->obs, kget_char(mess, 500));
+					menu_get_text(c, OBS, mess, 500);
 					break;
 				}
 			} while (i != 99);
+
+			if (restaurant_replace(r, c) != 0) {
+				printf("\nNOT CHANGED!!\n");
+				restaurant_free(c);
+			}
 		}
 	}
 
@@ -324,66 +361,91 @@ void menu_list() {
 	restaurant_list_all();
 }
 
-/** Menu option to load from a GPS Points of interest file more than 10000 restaurants 
- * \note some data is random but the GPS, name and adress are real.\n
- * The POI(Points Of Interest) was from GIS Sapo Services in http://services.sapo.pt/Metadata/Service/GIS
+/** Menu option to list the restaurants nearest to the user
+ * \see restaurant_list_nearest
  */
-void menu_test() {
+void menu_list_nearest() {
+	int k;
 	printf(MENU_OPTION_SEP_STR);
-	printf(MENU_OPTION_99_STR);
+	printf(MENU_OPTION_10_STR);
 	printf(MENU_OPTION_SEP_STR);
-	puts("<Start>");
-	{
-		const char filename[] = "poi.csv";
-		int itm[4];
-		FILE *file = fopen(filename, "r");
-		if (file != NULL) {
-			char line[9999];
-			while (fgets(line, sizeof line, file) != NULL) {
-				prestaurant_t r = restaurant_new();
-				sscanf(line, "%f;%f;%[^;];%[^;];%[^;];%i;%[^;];%[^;];%[^;];%[^;];%[^;];\n", &r->longitude, &r->latitude,
-						r->name, r->street, r->town, &r->zip_code, r->locality, r->e_mail, r->url, r->food_type, r->obs);
-
-				if (strcmp(r->town, r->locality) == 0)
-					strcpy(r->town, "");
-
-				r->weekly_rest = get_random(0, 6);
-
-				itm[0] = get_random(1, 28);
-				itm[1] = get_random(1, 28);
-				itm[2] = get_random(1, 12);
-				itm[3] = get_random(1, 12);
-
-				if (itm[0] < itm[1]) {
-					r->vacation_from.tm_mday = itm[0];
-					r->vacation_to.tm_mday = itm[1];
-				} else {
-					r->vacation_from.tm_mday = itm[1];
-					r->vacation_to.tm_mday = itm[0];
-				}
-				if (itm[2] < itm[3]) {
-					r->vacation_from.tm_mon = itm[2];
-					r->vacation_to.tm_mon = itm[3];
-				} else {
-					r->vacation_from.tm_mon = itm[3];
-					r->vacation_to.tm_mon = itm[2];
-				}
-				r->phone = get_random(12345678, 99999999);
-				restaurant_insert(r);
+	k = kget_int("Number of restaurants :");
+	if (k > 0)
+		restaurant_list_nearest(k);
+}
+
+/** Menu option to set how many restaurants the open and find listings show
+ * \see restaurant_top_k
+ */
+void menu_top_k() {
+	int k;
+	printf(MENU_OPTION_SEP_STR);
+	printf(MENU_OPTION_11_STR);
+	printf(MENU_OPTION_SEP_STR);
+	k = kget_int("Number of results (0 for all) :");
+	restaurant_top_k = (k > 0 ? k : 0);
+}
 
-				//restaurant_print(r);
+/** Menu option to set the measure used to order the restaurants by distance
+ * \see restaurant_distance_mode
+ */
+void menu_distance_mode() {
+	int m;
+	printf(MENU_OPTION_SEP_STR);
+	printf(MENU_OPTION_12_STR);
+	printf(MENU_OPTION_SEP_STR);
+	printf("%i - %s\n", COORDS_EXACT, coords_mode_name(COORDS_EXACT));
+	printf("%i - %s\n", COORDS_CHORD, coords_mode_name(COORDS_CHORD));
+	printf("%i - %s\n", COORDS_EQUIRECT, coords_mode_name(COORDS_EQUIRECT));
+	m = kget_int("Distance mode :");
+	if (m >= COORDS_EXACT && m <= COORDS_EQUIRECT)
+		restaurant_distance_mode = m;
+}
 
-				//if (ln++ > 5)
-				//    break;
+/** Fill the fields poi.csv has no column for with random values
+ * \param r	restaurant imported
+ */
+static void menu_test_fill(prestaurant_t r) {
+	int itm[4];
 
+	r->weekly_rest = get_random(0, 6);
 
-			}
-			fclose(file);
-		} else {
-			perror(filename);
-		}
+	itm[0] = get_random(1, 28);
+	itm[1] = get_random(1, 28);
+	itm[2] = get_random(1, 12);
+	itm[3] = get_random(1, 12);
 
+	if (itm[0] < itm[1]) {
+		r->vacation_from.day = itm[0];
+		r->vacation_to.day = itm[1];
+	} else {
+		r->vacation_from.day = itm[1];
+		r->vacation_to.day = itm[0];
+	}
+	if (itm[2] < itm[3]) {
+		r->vacation_from.month = itm[2];
+		r->vacation_to.month = itm[3];
+	} else {
+		r->vacation_from.month = itm[3];
+		r->vacation_to.month = itm[2];
 	}
+	r->text->phone = get_random(12345678, 99999999);
+}
+
+/** Menu option to load from a GPS Points of interest file more than 10000 restaurants 
+ * \note some data is random but the GPS, name and adress are real.\n
+ * The POI(Points Of Interest) was from GIS Sapo Services in http://services.sapo.pt/Metadata/Service/GIS
+ */
+void menu_test() {
+	struct import_stats_s st;
+
+	printf(MENU_OPTION_SEP_STR);
+	printf(MENU_OPTION_99_STR);
+	printf(MENU_OPTION_SEP_STR);
+	puts("<Start>");
+	if (import_csv("poi.csv", restaurant_threads, menu_test_fill, &st) >= 0)
+		printf("Imported %u restaurants in %.3f s (%.0f rows/s) on %u threads, %u lines rejected\n", st.rows,
+				st.seconds, (st.seconds > 0 ? st.rows / st.seconds : 0), st.threads, st.rejected);
 	puts("<Done>");
 }
 
@@ -397,6 +459,15 @@ int main_menu() {
 	printf("  Latitude  	: %08.5f\n", user_latitude);
 	printf("  List Size 	: [%04i]\n", list_size(&list_restaurants));
 	printf("  Week Day      : %s\n", day_of_week_text(today_day_of_week()));
+	if (restaurant_top_k > 0)
+		printf("  Results       : %u nearest\n", restaurant_top_k);
+	else
+		printf("  Results       : all\n");
+	printf("  Distance      : %s\n", coords_mode_name(restaurant_distance_mode));
+	if (restaurant_threads > 0)
+		printf("  Sort Threads  : %u\n", restaurant_threads);
+	else
+		printf("  Sort Threads  : one per processor\n");
 	printf("*************** MENU ****************\n");
 	printf(MENU_OPTION_01_STR);
 	printf(MENU_OPTION_02_STR);
@@ -407,6 +478,9 @@ int main_menu() {
 	printf(MENU_OPTION_07_STR);
 	printf(MENU_OPTION_08_STR);
 	printf(MENU_OPTION_09_STR);
+	printf(MENU_OPTION_10_STR);
+	printf(MENU_OPTION_11_STR);
+	printf(MENU_OPTION_12_STR);
 	printf(MENU_OPTION_99_STR);
 	printf(MENU_OPTION_SEP_STR);
 	printf(MENU_OPTION_00_STR);
@@ -445,6 +519,15 @@ int main_menu() {
 	case 9:
 		menu_list();
 		break;
+	case 10:
+		menu_list_nearest();
+		break;
+	case 11:
+		menu_top_k();
+		break;
+	case 12:
+		menu_distance_mode();
+		break;
 	case 99:
 		menu_test();
 		break;
@@ -0,0 +1,263 @@
+/**
+ *      \file query.c
+ * 		\brief Implementation file for the batch queries of the Restaurant List
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <time.h>
+
+#include "query.h"
+#include "utils.h"
+
+/** Longest field name of a query */
+#define QUERY_FIELD_MAX 32
+
+/** Get the next word of a query line
+ * \param p     position in the line
+ * \param len   length of the word, 0 at the end of the line
+ * \return      start of the word
+ */
+static const char *query_word(const char *p, size_t *len) {
+	const char *q;
+
+	while (isspace((unsigned char) *p))
+		p++;
+	for (q = p; *q != '\0' && !isspace((unsigned char) *q); q++)
+		;
+	*len = q - p;
+
+	return p;
+}
+
+int query_parse(const char *line, struct query_s *q) {
+	char field[QUERY_FIELD_MAX], *end;
+	const char *p, *w;
+	double latitude, longitude;
+	unsigned long k;
+	size_t len;
+
+	w = query_word(line, &len);
+	if (len == 0 || *w == '#')
+		return 0;
+
+	latitude = strtod(w, &end);
+	if (end == w)
+		return -1;
+	longitude = strtod(end, &end);
+	p = query_word(end, &len);
+	if (len == 0 || !isdigit((unsigned char) *p))
+		return -1;
+	k = strtoul(p, &end, 10);
+	if (end != p + len || k == 0 || k > UINT_MAX)
+		return -1;
+	/* also false for NaN */
+	if (!(latitude >= -90 && latitude <= 90 && longitude >= -180 && longitude <= 180))
+		return -1;
+
+	q->latitude = (float) latitude;
+	q->longitude = (float) longitude;
+	q->k = (unsigned int) k;
+	q->filter.open = 0;
+	q->filter.field = -1;
+	q->filter.value = q->value;
+	q->value[0] = '\0';
+
+	w = query_word(end, &len);
+	if (len == 4 && strncmp(w, "open", len) == 0) {
+		q->filter.open = 1;
+		w = query_word(w + len, &len);
+	}
+	if (len > 0) {
+		if (len >= sizeof(field))
+			return -1;
+		memcpy(field, w, len);
+		field[len] = '\0';
+		q->filter.field = restaurant_field_find(field);
+		if (q->filter.field < 0)
+			return -1;
+
+		/* the value is the rest of the line, spaces and all but the surrounding ones */
+		for (p = w + len; isspace((unsigned char) *p); p++)
+			;
+		for (len = strlen(p); len > 0 && isspace((unsigned char) p[len - 1]); len--)
+			;
+		if (len >= sizeof(q->value))
+			return -1;
+		memcpy(q->value, p, len);
+		q->value[len] = '\0';
+	}
+
+	return 1;
+}
+
+unsigned int query_run(const restaurant_snapshot_t *snap, const struct query_s *q, prestaurant_t *out) {
+	if (snap != NULL)
+		return restaurant_snapshot_select(snap, q->latitude, q->longitude, q->k, &q->filter, out);
+	return restaurant_select(q->latitude, q->longitude, q->k, &q->filter, out);
+}
+
+void query_write(FILE *f, unsigned int n, const struct query_s *q, prestaurant_t *hits, unsigned int nhits,
+		double micros) {
+	unsigned int i;
+
+	if (q == NULL) {
+		fprintf(f, "E\t%u\tmalformed query\n", n);
+		return;
+	}
+
+	fprintf(f, "Q\t%u\t%u\t%.1f\n", n, nhits, micros);
+	for (i = 0; i < nhits; i++) {
+		fprintf(f, "R\t%u\t%u\t%u\t%.4f\t%.6f\t%.6f\t%s\n", n, i + 1, hits[i]->id, distance(q->latitude,
+				q->longitude, hits[i]->latitude, hits[i]->longitude), hits[i]->longitude, hits[i]->latitude,
+				restaurant_get_text(hits[i], NAME));
+	}
+}
+
+/** Comparator of latencies, for qsort() */
+static int query_latency_cmp(const void *a, const void *b) {
+	double x = *(const double *) a, y = *(const double *) b;
+
+	return (x > y) - (x < y);
+}
+
+/** Get a percentile of sorted latencies, by the nearest rank
+ * \param lat   latencies, in ascending order
+ * \param n     number of latencies
+ * \param pct   percentile, 0 to 100
+ * \return      the latency, or 0 if there are none
+ */
+static double query_percentile(const double *lat, unsigned int n, double pct) {
+	unsigned int rank;
+
+	if (n == 0)
+		return 0;
+	rank = (unsigned int) (pct / 100 * n + 0.999999);
+
+	return lat[rank > 0 ? rank - 1 : 0];
+}
+
+void query_prepare() {
+	prestaurant_t r;
+
+	/* the first query after a change builds the k-d tree */
+	restaurant_knn(0, 0, 1, &r);
+}
+
+int query_answer(FILE *f, const restaurant_snapshot_t *snap, unsigned int n, const char *line, struct query_hits_s *h, double *micros) {
+	struct query_s q;
+	struct timespec t0, t1;
+	prestaurant_t *tmp;
+	unsigned int nhits, numels = (snap != NULL ? restaurant_snapshot_size(snap) : list_size(&list_restaurants));
+	int rt;
+
+	rt = query_parse(line, &q);
+	if (rt == 0)
+		return 0;
+	if (rt < 0) {
+		query_write(f, n, NULL, NULL, 0, 0);
+		return -1;
+	}
+
+	/* no more restaurants can be found than there are */
+	if (q.k > numels)
+		q.k = (numels > 0 ? numels : 1);
+	if (q.k > h->size) {
+		tmp = (prestaurant_t *) realloc(h->hits, q.k * sizeof(prestaurant_t));
+		if (tmp == NULL) {
+			perror("out of memory");
+			return -2;
+		}
+		h->hits = tmp;
+		h->size = q.k;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	nhits = query_run(snap, &q, h->hits);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	*micros = (t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) / 1e3;
+
+	query_write(f, n, &q, h->hits, nhits, *micros);
+
+	return 1;
+}
+
+int query_batch(FILE *in, FILE *out, struct query_stats_s *st) {
+	char line[QUERY_LINE_MAX];
+	struct query_hits_s h = { NULL, 0 };
+	double *lat = NULL, *tmp, micros, total = 0;
+	unsigned int n = 0, queries = 0, rejected = 0, size = 0;
+	size_t len;
+	int c, rt = -1;
+
+	query_prepare();
+
+	while (fgets(line, sizeof(line), in) != NULL) {
+		n++;
+		len = strlen(line);
+		if (len == sizeof(line) - 1 && line[len - 1] != '\n') {
+			/* too long: skip the rest of it */
+			while ((c = fgetc(in)) != EOF && c != '\n')
+				;
+			rejected++;
+			query_write(out, n, NULL, NULL, 0, 0);
+			continue;
+		}
+
+		if (queries == size) {
+			size = (size > 0 ? size * 2 : 1024);
+			tmp = (double *) realloc(lat, size * sizeof(double));
+			if (tmp == NULL) {
+				perror("out of memory");
+				goto out;
+			}
+			lat = tmp;
+		}
+
+		c = query_answer(out, NULL, n, line, &h, &micros);
+		if (c == -2)
+			goto out;
+		if (c < 0)
+			rejected++;
+		if (c > 0) {
+			lat[queries++] = micros;
+			total += micros;
+		}
+	}
+	rt = (int) queries;
+
+out:
+	if (st != NULL) {
+		if (queries > 0)
+			qsort(lat, queries, sizeof(double), query_latency_cmp);
+		st->queries = queries;
+		st->rejected = rejected;
+		st->seconds = total / 1e6;
+		st->p50 = query_percentile(lat, queries, 50);
+		st->p99 = query_percentile(lat, queries, 99);
+	}
+	free(lat);
+	free(h.hits);
+
+	return rt;
+}
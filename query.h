@@ -0,0 +1,157 @@
+/**
+ *      \file query.h
+ * 		\brief Heather file for the batch queries of the Restaurant List
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifndef _QUERY_H
+#define	_QUERY_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include "restaurant.h"
+
+/** Longest query line, terminator included */
+#define QUERY_LINE_MAX 1024
+
+/** Query of the restaurants nearest to a GPS point
+ * \par Query Format
+ * LATITUDE LONGITUDE K [open] [FIELD VALUE] \n
+ * for the K restaurants nearest to the point, only among those open today with open, and
+ * only among those with FIELD equal to VALUE, the rest of the line, with FIELD. \n
+ * Blank lines and lines starting with '#' hold no query.
+ * \see query_parse
+ */
+struct query_s {
+	/** GPS Latitude of the point */
+	float latitude;
+	/** GPS Longitude of the point */
+	float longitude;
+	/** Maximum number of restaurants to find */
+	unsigned int k;
+	/** Restaurants to select; its value points into value */
+	struct restaurant_filter_s filter;
+	/** Value of the field filter */
+	char value[QUERY_LINE_MAX];
+};
+
+/** Room for the restaurants found by queries, grown as they need it
+ * \see query_answer
+ */
+struct query_hits_s {
+	/** Restaurants found */
+	prestaurant_t *hits;
+	/** Number of restaurants allocated in hits */
+	unsigned int size;
+};
+
+/** Outcome of a batch of queries
+ * \see query_batch
+ */
+struct query_stats_s {
+	/** Queries answered */
+	unsigned int queries;
+	/** Lines rejected, for not being queries */
+	unsigned int rejected;
+	/** Time taken answering the queries, output left out, in seconds */
+	double seconds;
+	/** Median latency of the queries, in microseconds */
+	double p50;
+	/** 99th percentile latency of the queries, in microseconds */
+	double p99;
+};
+
+/**
+ * Parse a query.
+ * \param line  query line, with or without its terminator
+ * \param q     query to fill
+ * \return      1 for a query, 0 for a line with none, -1 for a malformed query
+ */
+int query_parse(const char *line, struct query_s *q);
+
+/**
+ * Answer a query.
+ * \param snap  snapshot to query; NULL for the Restaurant List itself
+ * \param q     query
+ * \param out   array of at least q->k restaurants to fill, nearest first
+ * \return      number of restaurants stored in out
+ * \see restaurant_select
+ * \see restaurant_snapshot_select
+ */
+unsigned int query_run(const restaurant_snapshot_t *snap, const struct query_s *q, prestaurant_t *out);
+
+/**
+ * Write the answer to a query.
+ * \param f         file to write to
+ * \param n         number of the query, echoed in every line
+ * \param q         query
+ * \param hits      restaurants found, nearest first
+ * \param nhits     number of restaurants in hits
+ * \param micros    time taken answering the query, in microseconds
+ *
+ * \par Answer Format
+ * One line for the query, then one per restaurant, with tab separated fields: \n
+ * Q  n  nhits  micros \n
+ * R  n  rank  id  distance  longitude  latitude  name \n
+ * with the exact distance in Km and rank from 1. A malformed query gets a single line: \n
+ * E  n  error
+ */
+void query_write(FILE *f, unsigned int n, const struct query_s *q, prestaurant_t *hits, unsigned int nhits,
+		double micros);
+
+/**
+ * Get the Restaurant List ready to answer queries, on any number of threads at once.
+ * \remarks The k-d tree is built now rather than by the first query. Queries only read
+ * the Restaurant List, which must not change while they run.
+ */
+void query_prepare();
+
+/**
+ * Answer a query line, timing it.
+ * \param f         file to write the answer to
+ * \param snap      snapshot to query; NULL for the Restaurant List itself
+ * \param n         number of the query
+ * \param line      query line
+ * \param h         room for the restaurants found; starts empty, freed by the caller
+ * \param micros    time taken answering the query, in microseconds
+ * \return          1 for a query answered, 0 for a line with none, -1 for a malformed
+ *                  query, -2 if out of memory; only queries get an answer
+ * \see query_write
+ */
+int query_answer(FILE *f, const restaurant_snapshot_t *snap, unsigned int n, const char *line, struct query_hits_s *h, double *micros);
+
+/**
+ * Answer every query of a file against the Restaurant List.
+ * \param in    file to read the queries from, one per line
+ * \param out   file to write the answers to
+ * \param st    filled with the outcome of the batch; may be NULL
+ * \return      number of queries answered, or -1 if out of memory
+ * \remarks The queries are numbered by their line in the file.
+ * \see query_write
+ */
+int query_batch(FILE *in, FILE *out, struct query_stats_s *st);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _QUERY_H */
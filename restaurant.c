@@ -23,11 +23,18 @@
 #include "acdll.h"
 
 #include <stdio.h>
+#include <errno.h>
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <stdint.h>
+#include <arpa/inet.h>
 
 #include "restaurant.h"
+#include "coords.h"
+#include "spatial.h"
+#include "snapshot.h"
 #include "utils.h"
 #include "main.h"
 
@@ -44,12 +51,169 @@ struct restaurant_seeker_s {
 	char *value;
 };
 
+/** Record of a restaurant in the version 1 dump files: the original, flat, restaurant struct
+ *  \see fn_unserializer_restaurant
+ */
+struct restaurant_record_s {
+	unsigned int id;
+	float longitude;
+	float latitude;
+	char name[255];
+	char street[255];
+	char town[255];
+	int zip_code;
+	char locality[255];
+	char e_mail[255];
+	char url[255];
+	char food_type[100];
+	int weekly_rest;
+	struct tm vacation_from;
+	struct tm vacation_to;
+	int phone;
+	char obs[500];
+};
+
+/** Length of the fixed part of a restaurant in the version 2 dump files: id, longitude, latitude,
+ *  zip code and phone as 32 bit integers, then weekly rest and vacation days and months as bytes.
+ *  \see fn_serializer_restaurant
+ */
+#define RESTAURANT_RECORD_FIXED 25
+
+/** Text fields of a restaurant in the version 2 dump files, in their order after the fixed part */
+static const eRESTAURANTE_FIELDS restaurant_record_texts[] = { NAME, STREET, TOWN, LOCALITY, E_MAIL, URL, FOOD_TYPE,
+		OBS };
+
+/** Number of fields in restaurant_record_texts */
+#define RESTAURANT_RECORD_TEXTS (sizeof(restaurant_record_texts) / sizeof(restaurant_record_texts[0]))
+
+/** Today's day of the week and date, taken once for a whole scan of open restaurants
+ *  \see fn_seeker_restaurant_open
+ */
+struct restaurant_today_s {
+	/** Day of the week */
+	int week_day;
+	/** Month * 100 + day of the month */
+	int date;
+};
+
+/** Filter of restaurant_select(), with today's date taken once for the whole scan
+ *  \see fn_seeker_restaurant_filter
+ */
+struct restaurant_select_s {
+	/** Filter to pass */
+	const struct restaurant_filter_s *filter;
+	/** Today's date, for the open filter */
+	struct restaurant_today_s today;
+	/** Field and value, for the field filter */
+	restaurant_seeker_t seeker;
+};
+
 /** File mane for import and export Restaurants */
 #define IMPORT_EXPORT_FILE_NAME "list_restaurants.dat"
 
 /** auxiliar variable to store the next ID for the Restaurant List. */
 unsigned int restaurant_index = 0;
 
+unsigned int restaurant_top_k = 0;
+
+eCOORDS_MODE restaurant_distance_mode = COORDS_EXACT;
+
+unsigned int restaurant_threads = 0;
+
+/** Coordinate table of the Restaurant List, kept in sync by insert, delete, edit and load */
+static coords_t restaurant_coords;
+
+/** Spatial index of the Restaurant List, kept in sync by insert, delete, edit and load */
+static spatial_grid_t restaurant_grid;
+
+/** k-d tree of the Restaurant List, rebuilt by the next query after any change */
+static spatial_kdtree_t restaurant_kdtree;
+/** True if the Restaurant List changed since restaurant_kdtree was built */
+static int restaurant_kdtree_dirty = 1;
+
+/** Conditions of the last sort of the Restaurant List by distance, to tell if it still holds */
+struct restaurant_sort_s {
+	/** True if the list was sorted, and no restaurant moved since */
+	int valid;
+	/** GPS latitude of the user the list was sorted for */
+	float latitude;
+	/** GPS longitude of the user the list was sorted for */
+	float longitude;
+	/** Measure the list was sorted by */
+	eCOORDS_MODE mode;
+	/** Generation of the list once sorted */
+	unsigned long generation;
+};
+
+/** Last sort of the Restaurant List, see restaurant_list_sort() */
+static struct restaurant_sort_s restaurant_sorted = { 0 };
+
+/** Mapped dump files the restaurants may borrow strings from, released by restaurant_clear() */
+static struct list_mapping_s *restaurant_mappings = NULL;
+/** Number of mappings in restaurant_mappings */
+static unsigned int restaurant_mappings_num = 0;
+
+/** Number of slots the id table starts with */
+#define RESTAURANT_IDS_MINSIZE 64
+
+/** Size from which the list is sorted by distance rounded to the metre, by a radix sort */
+#define RESTAURANT_RADIX_MINELS 1024
+
+/** The list is sorted again in full once more than 1 in this many restaurants were added since the last sort */
+#define RESTAURANT_REPAIR_RATIO 256
+
+/** Factor restaurant_select() widens its search among the nearest restaurants by, each time */
+#define RESTAURANT_SELECT_WIDEN 4
+
+/** restaurant_select() scans every restaurant rather than look among more than 1 in this many */
+#define RESTAURANT_SELECT_SCAN 64
+
+/** Slot of the id table: a restaurant of the Restaurant List and its row in restaurant_coords */
+struct restaurant_id_slot_s {
+	/** Id of the restaurant */
+	unsigned int id;
+	/** Row of the restaurant in restaurant_coords */
+	unsigned int row;
+	/** The restaurant, or NULL for an empty slot */
+	prestaurant_t r;
+};
+
+/** Snapshot of the Restaurant List: copies of its indexes, over the restaurants of the time
+ *  \see restaurant_snapshot_publish
+ */
+struct restaurant_snapshot_s {
+	/** Version of the snapshot; first, so versions are snapshots */
+	struct snapshot_s version;
+	/** Coordinate table: the restaurants, by row */
+	coords_t coords;
+	/** k-d tree of the restaurants */
+	spatial_kdtree_t kdtree;
+	/** Id table, by rows of coords */
+	struct restaurant_id_slot_s *ids;
+	/** Number of slots in ids */
+	unsigned int ids_size;
+};
+
+/** Snapshots of the Restaurant List published */
+static snapshots_t restaurant_snapshots;
+
+/** Id table: open addressed hash table of the restaurants by id, kept in sync by insert, delete and load */
+static struct restaurant_id_slot_s *restaurant_ids = NULL;
+/** Number of slots in restaurant_ids, a power of two */
+static unsigned int restaurant_ids_size = 0;
+/** Number of restaurants in restaurant_ids */
+static unsigned int restaurant_ids_num = 0;
+
+/** Number of food types in each page of the food types table */
+#define RESTAURANT_FOOD_TYPES_PAGE 256
+
+/** Food types table: names of the food types by their number, in pages that never move, so
+ *  readers of a snapshot can look up the food types of its restaurants while new ones are
+ *  added; 0 is no food type */
+static char **restaurant_food_types[0x10000 / RESTAURANT_FOOD_TYPES_PAGE];
+/** Number of food types in restaurant_food_types */
+static unsigned int restaurant_food_types_num = 0;
+
 /** Array of the fields names of the Restaurante Struct */
 const char *restaurant_fields_names[] = { "ID", "LONGITUDE", "LATITUDE", "NAME", "STREET", "TOWN", "ZIP_CODE", "LOCALITY",
 		"E_MAIL", "URL", "FOOD_TYPE", "WEEKLY_REST", "VACATIONS_FROM", "VACATIONS_TO", "PHONE", "OBS" };
@@ -76,33 +240,51 @@ int fn_comparator_restaurant_distance(const void *p1, const void *p2) {
 	return 0;
 }
 
+/** Funtion Keyer for distance to user
+ * \param el pointer to Restaurant
+ * \return distance of the restaurant to the user
+ */
+double fn_keyer_restaurant_distance(const void *el) {
+	prestaurant_t r = (prestaurant_t) el;
+
+	return distance(user_latitude, user_longitude, r->latitude, r->longitude);
+}
+
+/** Fill today's day of the week and date */
+static void restaurant_today(struct restaurant_today_s *today) {
+	time_t timer = time(NULL);
+	struct tm tm;
+
+	/* not localtime(): queries may take it on many threads at once */
+	localtime_r(&timer, &tm);
+	today->week_day = tm.tm_wday;
+	today->date = (tm.tm_mon + 1) * 100 + tm.tm_mday + 1;
+}
+
 /**
  * Function Seeker for opened restaurants 
  * \param el 		pointer to the element in the Restaurant List
- * \param indicator NOT USED
+ * \param indicator pointer to a restaurant_today_s with today's date, or NULL to get it
  * \return 1 if the restaurent is not in vacations or is the the week rest , otherwise 0.
  */
 int fn_seeker_restaurant_open(const void *el, const void *indicator) {
 	prestaurant_t r = ((prestaurant_t) el);
-	struct tm *tmp;
-	struct tm today;
-	time_t timer;
-	timer=time(NULL);
-	int dt1, dt2, dt3;
+	const struct restaurant_today_s *today = (const struct restaurant_today_s *) indicator;
+	struct restaurant_today_s now;
+	int dt1, dt2;
 
-	tmp = localtime(&timer);
+	if (today == NULL) {
+		restaurant_today(&now);
+		today = &now;
+	}
 
-	if (r->weekly_rest == today_day_of_week() )
+	if (r->weekly_rest == today->week_day)
 		return 0;
 
-	today.tm_mday = tmp->tm_mday +1;
-	today.tm_mon = tmp->tm_mon+1;
+	dt1 = r->vacation_from.month * 100 + r->vacation_from.day;
+	dt2 = r->vacation_to.month * 100 + r->vacation_to.day;
 
-	dt1 = r->vacation_from.tm_mon * 100 + r->vacation_from.tm_mday;
-	dt2 = r->vacation_to.tm_mon * 100 + r->vacation_to.tm_mday;
-	dt3 = today.tm_mon * 100 + today.tm_mday;
-
-	if ( !(dt3 >= dt1 && dt3 <=dt2))
+	if ( !(today->date >= dt1 && today->date <=dt2))
 		return 1;
 
 	return 0;
@@ -129,28 +311,17 @@ int fn_seeker_restaurant(const void *el, const void *indicator) {
 		return (float_equal(r->latitude, (float) atof(value->value)));
 		break;
 	case NAME:
-		return (!strcmp(r->name, value->value));
-		break;
 	case STREET:
-		return (!strcmp(r->street, value->value));
-		break;
 	case TOWN:
-		return (!strcmp(r->town, value->value));
-		break;
-	case ZIP_CODE:
-		return (r->zip_code == atoi(value->value));
-		break;
 	case LOCALITY:
-		return (!strcmp(r->locality, value->value));
-		break;
 	case E_MAIL:
-		return (!strcmp(r->e_mail, value->value));
-		break;
 	case URL:
-		return (!strcmp(r->url, value->value));
-		break;
 	case FOOD_TYPE:
-		return (!strcmp(r->food_type, value->value));
+	case OBS:
+		return (!strcmp(restaurant_get_text(r, value->field), value->value));
+		break;
+	case ZIP_CODE:
+		return (r->text->zip_code == atoi(value->value));
 		break;
 	case WEEKLY_REST:
 		return (r->weekly_rest == atoi(value->value));
@@ -162,30 +333,473 @@ int fn_seeker_restaurant(const void *el, const void *indicator) {
 		return 0;//(vacation_cmp(&r->vacation_to, (struct tm*)(value->value)));
 		break;
 	case PHONE:
-		return (r->phone == atoi(value->value));
-		break;
-	case OBS:
-		return (!strcmp(r->obs, value->value));
+		return (r->text->phone == atoi(value->value));
 		break;
 	}
 
 	return 0;
 }
 
+/**
+ * Function Seeker for the filters of restaurant_select().
+ * \param el 		pointer to the element in the Restaurant List.
+ * \param indicator pointer to a restaurant_select_s with the filter.
+ * \return 1 if the restaurant passes the filter, otherwise 0.
+ */
+static int fn_seeker_restaurant_filter(const void *el, const void *indicator) {
+	const struct restaurant_select_s *s = (const struct restaurant_select_s *) indicator;
+
+	if (s->filter->open && !fn_seeker_restaurant_open(el, &s->today))
+		return 0;
+	if (s->filter->field >= 0 && !fn_seeker_restaurant(el, &s->seeker))
+		return 0;
+
+	return 1;
+}
+
 /** Get the size of elements int the restaurant List
  * \param el	pointer to the element in the Restaurant List
  * \return 		size of the Restaurent list element
- * \remarks 	Since it is user fixes String size all elements have the same size.	
+ * \remarks 	The text fields are not counted; they are dumped by fn_serializer_restaurant().
  */
 size_t fn_data_size_restaurant(const void *el) {
 	return sizeof(struct restaurant_s);
 }
 
+/** Copy a fixed size field of a dump record into a new string, or NULL if it is empty */
+static char *restaurant_record_dup(const char *src, size_t size) {
+	size_t len = strnlen(src, size);
+	char *s;
+
+	if (len == 0)
+		return NULL;
+
+	s = (char *) malloc(len + 1);
+	if (!s) {
+		perror("out of memory");
+		return NULL;
+	}
+	memcpy(s, src, len);
+	s[len] = '\0';
+
+	return s;
+}
+
+/** Write a 32 bit value in network byte order */
+static unsigned char *restaurant_record_put32(unsigned char *p, const void *v) {
+	uint32_t n;
+
+	memcpy(&n, v, sizeof(n));
+	n = htonl(n);
+	memcpy(p, &n, sizeof(n));
+
+	return p + sizeof(n);
+}
+
+/** Read a 32 bit value in network byte order */
+static const unsigned char *restaurant_record_get32(const unsigned char *p, void *v) {
+	uint32_t n;
+
+	memcpy(&n, p, sizeof(n));
+	n = ntohl(n);
+	memcpy(v, &n, sizeof(n));
+
+	return p + sizeof(n);
+}
+
+void *restaurant_serialize(prestaurant_t r, const char *food_type, unsigned int *serializ_len) {
+	unsigned char *rec, *p;
+	const char *v;
+	unsigned int i, len = RESTAURANT_RECORD_FIXED;
+	size_t n;
+
+	*serializ_len = 0;
+	for (i = 0; i < RESTAURANT_RECORD_TEXTS; i++) {
+		v = (restaurant_record_texts[i] == FOOD_TYPE ? food_type : restaurant_get_text(r, restaurant_record_texts[i]));
+		len += strlen(v) + 1;
+	}
+
+	rec = (unsigned char *) malloc(len);
+	if (!rec) {
+		perror("out of memory");
+		return NULL;
+	}
+
+	p = restaurant_record_put32(rec, &r->id);
+	p = restaurant_record_put32(p, &r->longitude);
+	p = restaurant_record_put32(p, &r->latitude);
+	p = restaurant_record_put32(p, &r->text->zip_code);
+	p = restaurant_record_put32(p, &r->text->phone);
+	*p++ = r->weekly_rest;
+	*p++ = r->vacation_from.day;
+	*p++ = r->vacation_from.month;
+	*p++ = r->vacation_to.day;
+	*p++ = r->vacation_to.month;
+	for (i = 0; i < RESTAURANT_RECORD_TEXTS; i++) {
+		v = (restaurant_record_texts[i] == FOOD_TYPE ? food_type : restaurant_get_text(r, restaurant_record_texts[i]));
+		n = strlen(v) + 1;
+		memcpy(p, v, n);
+		p += n;
+	}
+
+	*serializ_len = len;
+	return rec;
+}
+
+/** Function Serializer for the restaurant List
+ * \param el			pointer to the element in the Restaurant List
+ * \param serializ_len	length of the record returned
+ * \return 			new record for the version 2 dump files
+ * \remarks The record is the fixed part followed by the text fields, each NUL terminated.
+ * \see RESTAURANT_RECORD_FIXED
+ */
+void *fn_serializer_restaurant(const void *el, unsigned int *serializ_len) {
+	prestaurant_t r = (prestaurant_t) el;
+
+	return restaurant_serialize(r, restaurant_food_type_name(r->food_type), serializ_len);
+}
+
+/** Allocate a restaurant being restored, along with its text record, from the arena of the
+ * Restaurant List
+ * \return new empty restaurant
+ * \see restaurant_free
+ */
+static prestaurant_t restaurant_new_restored() {
+	prestaurant_t r = (prestaurant_t) list_arena_alloc(&list_restaurants,
+			sizeof(struct restaurant_s) + sizeof(struct restaurant_text_s));
+	if (!r) {
+		perror("out of memory");
+		return NULL;
+	}
+
+	memset(r, '\0', sizeof(struct restaurant_s) + sizeof(struct restaurant_text_s));
+	r->text = (prestaurant_text_t) (r + 1);
+	r->arena = 1;
+
+	return r;
+}
+
+/** Build a restaurant from a record of the version 1 dump files
+ * \param rec   record read from the file
+ * \return      new restaurant
+ */
+static prestaurant_t restaurant_unserialize_v1(const struct restaurant_record_s *rec) {
+	prestaurant_t r = restaurant_new_restored();
+
+	if (!r)
+		return NULL;
+
+	r->id = rec->id;
+	r->longitude = rec->longitude;
+	r->latitude = rec->latitude;
+	r->text->name = restaurant_record_dup(rec->name, sizeof(rec->name));
+	r->text->street = restaurant_record_dup(rec->street, sizeof(rec->street));
+	r->text->town = restaurant_record_dup(rec->town, sizeof(rec->town));
+	r->text->zip_code = rec->zip_code;
+	r->text->locality = restaurant_record_dup(rec->locality, sizeof(rec->locality));
+	r->text->e_mail = restaurant_record_dup(rec->e_mail, sizeof(rec->e_mail));
+	r->text->url = restaurant_record_dup(rec->url, sizeof(rec->url));
+	r->text->phone = rec->phone;
+	r->text->obs = restaurant_record_dup(rec->obs, sizeof(rec->obs));
+	if (strnlen(rec->food_type, sizeof(rec->food_type)) < sizeof(rec->food_type))
+		restaurant_set_text(r, FOOD_TYPE, rec->food_type);
+	r->weekly_rest = rec->weekly_rest;
+	r->vacation_from.day = rec->vacation_from.tm_mday;
+	r->vacation_from.month = rec->vacation_from.tm_mon;
+	r->vacation_to.day = rec->vacation_to.tm_mday;
+	r->vacation_to.month = rec->vacation_to.tm_mon;
+
+	return r;
+}
+
+/** Function Unserializer for the restaurant List
+ * \param data		pointer to a record read from a dump file
+ * \param data_len	length of the record; set to the size of the restaurant returned
+ * \return 		new restaurant, or NULL if the record is not valid
+ * \see fn_serializer_restaurant
+ */
+void *fn_unserializer_restaurant(const void *data, unsigned int *data_len) {
+	const unsigned char *p = (const unsigned char *) data;
+	const unsigned char *end = p + *data_len;
+	prestaurant_t r;
+	unsigned int i;
+
+	if (list_restore_version(&list_restaurants) == 1) {
+		if (*data_len != sizeof(struct restaurant_record_s))
+			return NULL;
+		r = restaurant_unserialize_v1((const struct restaurant_record_s *) data);
+		*data_len = sizeof(struct restaurant_s);
+		return r;
+	}
+
+	if (*data_len < RESTAURANT_RECORD_FIXED)
+		return NULL;
+	r = restaurant_new_restored();
+	if (!r)
+		return NULL;
+
+	p = restaurant_record_get32(p, &r->id);
+	p = restaurant_record_get32(p, &r->longitude);
+	p = restaurant_record_get32(p, &r->latitude);
+	p = restaurant_record_get32(p, &r->text->zip_code);
+	p = restaurant_record_get32(p, &r->text->phone);
+	r->weekly_rest = *p++;
+	r->vacation_from.day = *p++;
+	r->vacation_from.month = *p++;
+	r->vacation_to.day = *p++;
+	r->vacation_to.month = *p++;
+
+	if (!list_restore_mapped(&list_restaurants)) {
+		/* the record goes away after the call: keep its strings in the arena, all at once */
+		unsigned char *text = (unsigned char *) list_arena_alloc(&list_restaurants, end - p);
+
+		if (!text) {
+			perror("out of memory");
+			restaurant_free(r);
+			return NULL;
+		}
+		memcpy(text, p, end - p);
+		end = text + (end - p);
+		p = text;
+	}
+
+	for (i = 0; i < RESTAURANT_RECORD_TEXTS; i++) {
+		eRESTAURANTE_FIELDS f = restaurant_record_texts[i];
+		const unsigned char *nul = (const unsigned char *) memchr(p, '\0', end - p);
+
+		if (nul == NULL) {
+			restaurant_free(r);
+			return NULL;
+		}
+		if (f != FOOD_TYPE) {
+			/* the mapping and the arena live until restaurant_clear(): point straight into them */
+			if (nul != p) {
+				*restaurant_text_field(r, f) = (char *) p;
+				r->text->borrowed |= 1 << f;
+			}
+		} else {
+			restaurant_set_text(r, f, (const char *) p);
+		}
+		p = nul + 1;
+	}
+
+	*data_len = sizeof(struct restaurant_s);
+	return r;
+}
+
+static void restaurant_snapshot_free(void *p);
+
 /* set initial settings fot the list of restaurants */
 void restaurant_init() {
-	list_init(&list_restaurants);
+	list_init_pool(&list_restaurants, 0);
+	list_attributes_indexed(&list_restaurants, 1);
+	list_attributes_locator(&list_restaurants, 1);
 	list_attributes_copy(&list_restaurants, fn_data_size_restaurant, 0);
 	list_attributes_comparator(&list_restaurants, fn_comparator_restaurant_distance);
+	list_attributes_keyer(&list_restaurants, fn_keyer_restaurant_distance);
+	list_attributes_serializer(&list_restaurants, fn_serializer_restaurant, fn_unserializer_restaurant);
+	coords_init(&restaurant_coords);
+	spatial_grid_init(&restaurant_grid, SPATIAL_GRID_CELL_DEG);
+	spatial_kdtree_init(&restaurant_kdtree);
+	snapshots_init(&restaurant_snapshots, restaurant_snapshot_free);
+}
+
+/** Hash of a restaurant id
+ * \param id id of the restaurant
+ * \return first slot of the id table to probe
+ */
+static inline unsigned int restaurant_ids_hash(unsigned int id) {
+	/* ids are handed out in sequence: as they are, they fill the slots in order, with no collision */
+	return id & (restaurant_ids_size - 1);
+}
+
+/** Find a restaurant in an id table, the one of the Restaurant List or a copy of it
+ * \param ids  slots of the table
+ * \param size number of slots in ids, a power of two
+ * \param id   id of the restaurant
+ * \return its slot, or NULL if not found
+ */
+static struct restaurant_id_slot_s *restaurant_ids_lookup(struct restaurant_id_slot_s *ids, unsigned int size,
+		unsigned int id) {
+	unsigned int i;
+
+	if (size == 0)
+		return NULL;
+
+	for (i = id & (size - 1); ids[i].r != NULL; i = (i + 1) & (size - 1)) {
+		if (ids[i].id == id)
+			return &ids[i];
+	}
+
+	return NULL;
+}
+
+/** Find a restaurant in the id table
+ * \param id id of the restaurant
+ * \return its slot, or NULL if not found
+ */
+static struct restaurant_id_slot_s *restaurant_ids_find(unsigned int id) {
+	return restaurant_ids_lookup(restaurant_ids, restaurant_ids_size, id);
+}
+
+/** Add a restaurant to the id table, which must have room for it
+ * \param r   pointer to the restaurant
+ * \param row row of the restaurant in restaurant_coords
+ */
+static void restaurant_ids_add(prestaurant_t r, unsigned int row) {
+	unsigned int i;
+
+	for (i = restaurant_ids_hash(r->id); restaurant_ids[i].r != NULL; i = (i + 1) & (restaurant_ids_size - 1))
+		;
+	restaurant_ids[i].id = r->id;
+	restaurant_ids[i].row = row;
+	restaurant_ids[i].r = r;
+	restaurant_ids_num++;
+}
+
+/** Make room in the id table for a number of restaurants
+ * \param n number of restaurants
+ * \return 0 for success. -1 for failure
+ */
+static int restaurant_ids_reserve(unsigned int n) {
+	struct restaurant_id_slot_s *old = restaurant_ids;
+	unsigned int oldsize = restaurant_ids_size, size, i;
+
+	/* at most three slots in four are in use, to keep the probes short */
+	if (oldsize > 0 && n <= oldsize / 4 * 3)
+		return 0;
+	for (size = (oldsize > 0 ? oldsize : RESTAURANT_IDS_MINSIZE); n > size / 4 * 3; size *= 2)
+		;
+
+	restaurant_ids = (struct restaurant_id_slot_s *) calloc(size, sizeof(struct restaurant_id_slot_s));
+	if (!restaurant_ids) {
+		perror("out of memory");
+		restaurant_ids = old;
+		return -1;
+	}
+	restaurant_ids_size = size;
+	restaurant_ids_num = 0;
+	for (i = 0; i < oldsize; i++) {
+		if (old[i].r != NULL)
+			restaurant_ids_add(old[i].r, old[i].row);
+	}
+	free(old);
+
+	return 0;
+}
+
+/** Add a restaurant to the id table
+ * \param r   pointer to the restaurant
+ * \param row row of the restaurant in restaurant_coords
+ * \remarks A restaurant repeating an id already in the table is left out: it is only found
+ * by scanning the list.
+ */
+static void restaurant_ids_put(prestaurant_t r, unsigned int row) {
+	if (restaurant_ids_find(r->id) == NULL && restaurant_ids_reserve(restaurant_ids_num + 1) == 0)
+		restaurant_ids_add(r, row);
+}
+
+/** Empty a slot of the id table
+ * \param s the slot
+ */
+static void restaurant_ids_remove(struct restaurant_id_slot_s *s) {
+	unsigned int mask = restaurant_ids_size - 1, i = (unsigned int) (s - restaurant_ids), j, k;
+
+	/* move back the slots probed past this one, so that no probe stops short of them */
+	for (j = (i + 1) & mask; restaurant_ids[j].r != NULL; j = (j + 1) & mask) {
+		k = restaurant_ids_hash(restaurant_ids[j].id);
+		if (((j - k) & mask) >= ((j - i) & mask)) {
+			restaurant_ids[i] = restaurant_ids[j];
+			i = j;
+		}
+	}
+	restaurant_ids[i].r = NULL;
+	restaurant_ids_num--;
+}
+
+/** Rebuild the coordinate table, the spatial index and the id table from all the restaurants
+ *  in the Restaurant List */
+static void restaurant_reindex() {
+	coords_clear(&restaurant_coords);
+	spatial_grid_clear(&restaurant_grid);
+	if (restaurant_ids_size > 0)
+		memset(restaurant_ids, 0, restaurant_ids_size * sizeof(struct restaurant_id_slot_s));
+	restaurant_ids_num = 0;
+	restaurant_ids_reserve(list_size(&list_restaurants));
+
+	list_iterator_start(&list_restaurants);
+	while (list_iterator_hasnext(&list_restaurants)) {
+		prestaurant_t r = (prestaurant_t) list_iterator_next(&list_restaurants);
+
+		coords_append(&restaurant_coords, r->latitude, r->longitude, r);
+		spatial_grid_insert(&restaurant_grid, r->latitude, r->longitude, r);
+		restaurant_ids_put(r, restaurant_coords.numels - 1);
+		/* new restaurants must not take the ids of those loaded */
+		if (r->id >= restaurant_index)
+			restaurant_index = r->id + 1;
+	}
+	list_iterator_stop(&list_restaurants);
+	restaurant_kdtree_dirty = 1;
+}
+
+/** Bulk build a k-d tree over the rows of a coordinate table
+ * \param t    k-d tree to build
+ * \param c    coordinate table
+ * \return 0 for success. -1 for failure
+ */
+static int restaurant_kdtree_build(spatial_kdtree_t *t, const coords_t *c) {
+	struct spatial_item_s *items;
+	unsigned int i, n = c->numels;
+	int rt;
+
+	items = (struct spatial_item_s *) malloc((n + 1) * sizeof(struct spatial_item_s));
+	if (!items) {
+		perror("out of memory");
+		return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		items[i].latitude = c->latitude[i];
+		items[i].longitude = c->longitude[i];
+		items[i].data = c->data[i];
+	}
+
+	rt = spatial_kdtree_build(t, items, n);
+	free(items);
+
+	return rt;
+}
+
+/** Bulk build the k-d tree again if the Restaurant List changed since it was built
+ * \return 0 for success. -1 for failure
+ */
+static int restaurant_kdtree_update() {
+	if (!restaurant_kdtree_dirty)
+		return 0;
+	if (restaurant_kdtree_build(&restaurant_kdtree, &restaurant_coords) != 0)
+		return -1;
+	restaurant_kdtree_dirty = 0;
+
+	return 0;
+}
+
+/** Free a snapshot of the Restaurant List, once no reader holds it
+ * \param p the snapshot
+ */
+static void restaurant_snapshot_free(void *p) {
+	struct restaurant_snapshot_s *s = (struct restaurant_snapshot_s *) p;
+
+	coords_destroy(&s->coords);
+	spatial_kdtree_destroy(&s->kdtree);
+	free(s->ids);
+	free(s);
+}
+
+/** Free a restaurant retired from the Restaurant List, once no snapshot holding it is pinned
+ * \param p the restaurant
+ */
+static void restaurant_free_retired(void *p) {
+	restaurant_free((prestaurant_t) p);
 }
 
 /* creates a new empty restaurant */
@@ -199,33 +813,404 @@ prestaurant_t restaurant_new() {
 	/* First clear the result structure.  */
 	memset(r, '\0', sizeof(*r));
 
+	r->text = (prestaurant_text_t) calloc(1, sizeof(struct restaurant_text_s));
+	if (!r->text) {
+		perror("out of memory");
+		free(r);
+		return NULL;
+	}
+
 	return r;
 
 }
 
+void restaurant_free(prestaurant_t r) {
+	int f;
+
+	if (!r)
+		return;
+
+	for (f = NAME; f <= OBS; f++) {
+		char **field = restaurant_text_field(r, f);
+
+		if (field != NULL && !(r->text->borrowed & (1 << f)))
+			free(*field);
+	}
+	/* restored restaurants go with the arena; the flag, as the writer may be growing the arena meanwhile */
+	if (!r->arena) {
+		free(r->text);
+		free(r);
+	}
+}
+
+prestaurant_t restaurant_copy(prestaurant_t r) {
+	prestaurant_t c = restaurant_new();
+	prestaurant_text_t t;
+	char **field;
+	int f;
+
+	if (!c)
+		return NULL;
+
+	t = c->text;
+	*c = *r;
+	c->text = t;
+	c->arena = 0;
+	t->zip_code = r->text->zip_code;
+	t->phone = r->text->phone;
+	for (f = NAME; f <= OBS; f++) {
+		field = restaurant_text_field(r, f);
+		if (field != NULL && *field != NULL && restaurant_set_text(c, f, *field) != 0) {
+			restaurant_free(c);
+			return NULL;
+		}
+	}
+
+	return c;
+}
+
+/** Get the food type number of a name, adding it to the food types table if new
+ * \param name name of the food type
+ * \return the food type number, or 0 for an empty name or if the table is full
+ */
+static unsigned short restaurant_food_type_id(const char *name) {
+	char ***page;
+	char *dup;
+	unsigned int i;
+
+	if (name == NULL || name[0] == '\0')
+		return 0;
+
+	for (i = 1; i < restaurant_food_types_num; i++) {
+		if (strcmp(restaurant_food_types[i / RESTAURANT_FOOD_TYPES_PAGE][i % RESTAURANT_FOOD_TYPES_PAGE], name) == 0)
+			return i;
+	}
+
+	if (restaurant_food_types_num == 0)
+		restaurant_food_types_num = 1;
+	if (restaurant_food_types_num > 0xFFFF)
+		return 0;
+
+	page = &restaurant_food_types[i / RESTAURANT_FOOD_TYPES_PAGE];
+	if (*page == NULL) {
+		*page = (char **) calloc(RESTAURANT_FOOD_TYPES_PAGE, sizeof(char *));
+		if (!*page) {
+			perror("out of memory");
+			return 0;
+		}
+	}
+	dup = strdup(name);
+	if (!dup) {
+		perror("out of memory");
+		return 0;
+	}
+	(*page)[i % RESTAURANT_FOOD_TYPES_PAGE] = dup;
+
+	return restaurant_food_types_num++;
+}
+
+const char *restaurant_food_type_name(unsigned short id) {
+	char **page = restaurant_food_types[id / RESTAURANT_FOOD_TYPES_PAGE];
+
+	/* not restaurant_food_types_num: the writer may be adding food types meanwhile */
+	if (id == 0 || page == NULL || page[id % RESTAURANT_FOOD_TYPES_PAGE] == NULL)
+		return "";
+
+	return page[id % RESTAURANT_FOOD_TYPES_PAGE];
+}
+
+char **restaurant_text_field(prestaurant_t r, eRESTAURANTE_FIELDS f) {
+	switch (f) {
+	case NAME:
+		return &r->text->name;
+	case STREET:
+		return &r->text->street;
+	case TOWN:
+		return &r->text->town;
+	case LOCALITY:
+		return &r->text->locality;
+	case E_MAIL:
+		return &r->text->e_mail;
+	case URL:
+		return &r->text->url;
+	case OBS:
+		return &r->text->obs;
+	default:
+		return NULL;
+	}
+}
+
+const char *restaurant_get_text(prestaurant_t r, eRESTAURANTE_FIELDS f) {
+	char **field;
+
+	if (f == FOOD_TYPE)
+		return restaurant_food_type_name(r->food_type);
+
+	field = restaurant_text_field(r, f);
+	if (field == NULL)
+		return NULL;
+
+	return (*field == NULL ? "" : *field);
+}
+
+int restaurant_set_text(prestaurant_t r, eRESTAURANTE_FIELDS f, const char *v) {
+	char **field;
+	char *tmp = NULL;
+
+	if (f == FOOD_TYPE) {
+		r->food_type = restaurant_food_type_id(v);
+		return (r->food_type == 0 && v != NULL && v[0] != '\0' ? -1 : 0);
+	}
+
+	field = restaurant_text_field(r, f);
+	if (field == NULL)
+		return -1;
+
+	if (v != NULL && v[0] != '\0') {
+		tmp = strdup(v);
+		if (!tmp) {
+			perror("out of memory");
+			return -1;
+		}
+	}
+	if (!(r->text->borrowed & (1 << f)))
+		free(*field);
+	r->text->borrowed &= ~(1 << f);
+	*field = tmp;
+
+	return 0;
+}
+
 int restaurant_insert(prestaurant_t r) {
+	int rt;
+
 	r->id = restaurant_index++;
-	return list_append(&list_restaurants, r);
+	rt = list_append(&list_restaurants, r);
+	if (rt > 0) {
+		coords_append(&restaurant_coords, r->latitude, r->longitude, r);
+		restaurant_ids_put(r, restaurant_coords.numels - 1);
+		spatial_grid_insert(&restaurant_grid, r->latitude, r->longitude, r);
+		restaurant_kdtree_dirty = 1;
+	}
+
+	return rt;
+}
+
+int restaurant_insert_array(prestaurant_t *rs, unsigned int n) {
+	unsigned int i;
+
+	if (restaurant_ids_reserve(restaurant_ids_num + n) != 0
+			|| list_append_array(&list_restaurants, (void *const *) rs, n) < 0)
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		rs[i]->id = restaurant_index++;
+		coords_append(&restaurant_coords, rs[i]->latitude, rs[i]->longitude, rs[i]);
+		restaurant_ids_put(rs[i], restaurant_coords.numels - 1);
+		spatial_grid_insert(&restaurant_grid, rs[i]->latitude, rs[i]->longitude, rs[i]);
+	}
+	restaurant_kdtree_dirty = 1;
+
+	return (int) n;
 }
 
 void restaurant_delete(prestaurant_t r) {
-	list_delete_at(&list_restaurants, r->id);
+	struct restaurant_id_slot_s *s = restaurant_ids_find(r->id);
+	unsigned int row;
+
+	/* the restaurant is freed, so it must really leave the list: its id is not its position */
+	if (list_delete(&list_restaurants, r) != 0)
+		return;
+	if (s != NULL && s->r == r) {
+		row = s->row;
+		restaurant_ids_remove(s);
+		coords_remove_row(&restaurant_coords, row);
+		/* the last row took its place */
+		if (row < restaurant_coords.numels) {
+			s = restaurant_ids_find(((prestaurant_t) restaurant_coords.data[row])->id);
+			if (s != NULL && s->r == restaurant_coords.data[row])
+				s->row = row;
+		}
+	} else {
+		coords_remove(&restaurant_coords, r);
+	}
+	spatial_grid_remove(&restaurant_grid, r->latitude, r->longitude, r);
+	restaurant_kdtree_dirty = 1;
+	/* snapshots may still hold it */
+	snapshot_retire(&restaurant_snapshots, r, restaurant_free_retired);
+}
+
+int restaurant_replace(prestaurant_t old, prestaurant_t r) {
+	struct restaurant_id_slot_s *s = restaurant_ids_find(old->id);
+	int pos = list_locate(&list_restaurants, old);
+
+	r->id = old->id;
+	if (pos < 0 || list_insert_at(&list_restaurants, r, (unsigned int) pos) < 0)
+		return -1;
+	list_delete_at(&list_restaurants, (unsigned int) pos + 1);
+
+	if (s != NULL && s->r == old) {
+		s->r = r;
+		coords_move_row(&restaurant_coords, s->row, r->latitude, r->longitude);
+		restaurant_coords.data[s->row] = r;
+	} else {
+		coords_remove(&restaurant_coords, old);
+		coords_append(&restaurant_coords, r->latitude, r->longitude, r);
+	}
+	spatial_grid_remove(&restaurant_grid, old->latitude, old->longitude, old);
+	spatial_grid_insert(&restaurant_grid, r->latitude, r->longitude, r);
+	restaurant_kdtree_dirty = 1;
+	restaurant_sorted.valid = 0;
+	snapshot_retire(&restaurant_snapshots, old, restaurant_free_retired);
+
+	return 0;
 }
 
 void restaurant_clear() {
+	/* first: the restaurants retired are freed with them */
+	snapshots_destroy(&restaurant_snapshots);
+	coords_destroy(&restaurant_coords);
+	spatial_grid_destroy(&restaurant_grid);
+	spatial_kdtree_destroy(&restaurant_kdtree);
+	restaurant_kdtree_dirty = 1;
+	free(restaurant_ids);
+	restaurant_ids = NULL;
+	restaurant_ids_size = restaurant_ids_num = 0;
+	restaurant_sorted.valid = 0;
+
+	list_iterator_start(&list_restaurants);
+	while (list_iterator_hasnext(&list_restaurants))
+		restaurant_free((prestaurant_t) list_iterator_next(&list_restaurants));
+	list_iterator_stop(&list_restaurants);
 	list_destroy(&list_restaurants);
+
+	/* no restaurant borrows from the mappings any more */
+	while (restaurant_mappings_num > 0)
+		list_mapping_release(&restaurant_mappings[--restaurant_mappings_num]);
+	free(restaurant_mappings);
+	restaurant_mappings = NULL;
 }
 prestaurant_t restaurant_find(eRESTAURANTE_FIELDS f, const char *v) {
+	struct restaurant_id_slot_s *s;
 	restaurant_seeker_t vl;
 	vl.field = f;
 	vl.value = (char*)v;
 
+	if (f == ID) {
+		s = restaurant_ids_find((unsigned int) atoi(v));
+		return (s != NULL ? s->r : NULL);
+	}
+
 	list_attributes_seeker(&list_restaurants, fn_seeker_restaurant);
 
 	return (prestaurant_t) list_seek(&list_restaurants, &vl);
 
 }
 
+/**
+ * Prints an open restaurant in a tabular form.
+ * \param r pointer to the restaurant
+ */
+static void restaurant_list_one_open(prestaurant_t r) {
+	printf("%5i|%09.4f|%09.4f|%09.4f|%-40s|%-4s|%i/%i -> %i/%i\n", r->id, distance(user_latitude, user_longitude,
+			r->latitude, r->longitude), r->longitude, r->latitude, restaurant_get_text(r, NAME),
+			day_of_week_text(r->weekly_rest), r->vacation_from.day, r->vacation_from.month,
+			r->vacation_to.day, r->vacation_to.month);
+}
+
+static void restaurant_list_one_field(prestaurant_t r, eRESTAURANTE_FIELDS f);
+
+/**
+ * Prints the restaurant_top_k restaurants nearest to the user that match a seeker.
+ * \param seeker function seeker for the restaurants to list
+ * \param indicator data to pass to the seeker
+ * \param f field to print for each restaurant, or a value past OBS to print them as open restaurants
+ * \see coords_select
+ */
+static void restaurant_list_top(element_seeker seeker, void *indicator, eRESTAURANTE_FIELDS f) {
+	prestaurant_t *found;
+	unsigned int i, n;
+
+	found = (prestaurant_t *) malloc(restaurant_top_k * sizeof(prestaurant_t));
+	if (!found) {
+		perror("out of memory");
+		return;
+	}
+
+	coords_mode(&restaurant_coords, restaurant_distance_mode);
+	n = coords_select(&restaurant_coords, user_latitude, user_longitude, restaurant_top_k, seeker, indicator,
+			(void **) found);
+
+	for (i = 0; i < n; i++) {
+		if (f > OBS)
+			restaurant_list_one_open(found[i]);
+		else
+			restaurant_list_one_field(found[i], f);
+	}
+	free(found);
+}
+
+/**
+ * Prints a restaurant found by a field in a tabular form.
+ * \param r pointer to the restaurant
+ * \param f field that was searched, printed in the last column
+ */
+static void restaurant_list_one_field(prestaurant_t r, eRESTAURANTE_FIELDS f) {
+	printf("%5i|%09.4f|%09.4f|%09.4f|%-40s|", r->id, distance(user_latitude, user_longitude, r->latitude,
+			r->longitude), r->longitude, r->latitude, restaurant_get_text(r, NAME));
+
+	switch (f) {
+	case ID:
+		printf("\n");
+		break;
+	case LONGITUDE:
+		printf("\n");
+		break;
+	case LATITUDE:
+		printf("\n");
+		break;
+	case NAME:
+		printf("\n");
+		break;
+	case STREET:
+		printf("%s\n", restaurant_get_text(r, STREET));
+		break;
+	case TOWN:
+		printf("%s\n", restaurant_get_text(r, TOWN));
+		break;
+	case ZIP_CODE:
+		printf("%i\n", r->text->zip_code);
+		break;
+	case LOCALITY:
+		printf("%s\n", restaurant_get_text(r, LOCALITY));
+		break;
+	case E_MAIL:
+		printf("%s\n", restaurant_get_text(r, E_MAIL));
+		break;
+	case URL:
+		printf("%s\n", restaurant_get_text(r, URL));
+		break;
+	case FOOD_TYPE:
+		printf("%s\n", restaurant_get_text(r, FOOD_TYPE));
+		break;
+	case WEEKLY_REST:
+		printf("%s\n", day_of_week_text(r->weekly_rest));
+		break;
+	case VACATION_FROM:
+		printf("%i/%i\n", r->vacation_from.day, r->vacation_from.month);
+		break;
+	case VACATION_TO:
+		printf("%i/%i\n", r->vacation_to.day, r->vacation_to.month);
+		break;
+	case PHONE:
+		printf("%i\n", r->text->phone);
+		break;
+	case OBS:
+		printf("%s\n", restaurant_get_text(r, OBS));
+		break;
+	}
+}
+
 void restaurant_find_all(eRESTAURANTE_FIELDS f, const char *v) {
 	restaurant_seeker_t vl;
 	vl.field = f;
@@ -234,68 +1219,20 @@ void restaurant_find_all(eRESTAURANTE_FIELDS f, const char *v) {
 	printf("<START>\n");
 	printf("ID   |Distance |Longitude|Latitude |Name                                    |%s\n", restaurant_get_field_name(f));
 
+	if (restaurant_top_k > 0) {
+		restaurant_list_top(fn_seeker_restaurant, &vl, f);
+		printf("<END>\n");
+		return;
+	}
+
 	restaurant_list_sort();
 
 	list_iterator_start(&list_restaurants);
 	while (list_iterator_hasnext(&list_restaurants)) {
 		prestaurant_t r = (prestaurant_t) list_iterator_next(&list_restaurants);
 
-		if (fn_seeker_restaurant(r, &vl) ) {
-
-			printf("%5i|%09.4f|%09.4f|%09.4f|%-40s|", r->id, distance(user_latitude, user_longitude, r->latitude,
-					r->longitude), r->longitude, r->latitude, (r->name == NULL ? "<null>" : r->name));
-
-			switch (f) {
-			case ID:
-				printf("\n");
-				break;
-			case LONGITUDE:
-				printf("\n");
-				break;
-			case LATITUDE:
-				printf("\n");
-				break;
-			case NAME:
-				printf("\n");
-				break;
-			case STREET:
-				printf("%s\n", r->street);
-				break;
-			case TOWN:
-				printf("%s\n", r->town);
-				break;
-			case ZIP_CODE:
-				printf("%i\n", r->zip_code);
-				break;
-			case LOCALITY:
-				printf("%s\n", r->locality);
-				break;
-			case E_MAIL:
-				printf("%s\n", r->e_mail);
-				break;
-			case URL:
-				printf("%s\n", r->url);
-				break;
-			case FOOD_TYPE:
-				printf("%s\n", r->food_type);
-				break;
-			case WEEKLY_REST:
-				printf("%s\n", day_of_week_text(r->weekly_rest));
-				break;
-			case VACATION_FROM:
-				printf("%i/%i\n", r->vacation_from.tm_mday, r->vacation_from.tm_mon);
-				break;
-			case VACATION_TO:
-				printf("%i/%i\n", r->vacation_to.tm_mday, r->vacation_to.tm_mon);
-				break;
-			case PHONE:
-				printf("%i\n", r->phone);
-				break;
-			case OBS:
-				printf("%s\n", r->obs);
-				break;
-			}
-		}
+		if (fn_seeker_restaurant(r, &vl) )
+			restaurant_list_one_field(r, f);
 
 	}
 	list_iterator_stop(&list_restaurants);
@@ -307,6 +1244,20 @@ const char * restaurant_get_field_name(eRESTAURANTE_FIELDS f) {
 	return restaurant_fields_names[f];
 }
 
+int restaurant_field_find(const char *s) {
+	int i;
+
+	for (i = ID; i <= OBS; i++) {
+		if (strcmp(s, restaurant_fields_names[i]) == 0)
+			return i;
+	}
+	i = atoi(s);
+	if ((i > ID || strcmp(s, "0") == 0) && i <= OBS)
+		return i;
+
+	return -1;
+}
+
 void restaurant_print(prestaurant_t r) {
 	if (!r) {
 		perror("Null Restaurant");
@@ -317,18 +1268,18 @@ void restaurant_print(prestaurant_t r) {
 	printf("ID		: %i\n", r->id);
 	printf("LONGITUDE	: %f\n", r->longitude);
 	printf("LATITUDE	: %f\n", r->latitude);
-	printf("NAME		: %s\n", r->name);
-	printf("ADRESS		: %s\n", r->street);
-	printf("		: %s\n", r->town);
-	printf("		: %i %s\n", r->zip_code, r->locality);
-	printf("EMAIL		: %s\n", r->e_mail);
-	printf("URL		: %s\n", r->url);
-	printf("FOOD TYPE	: %s\n", r->food_type);
+	printf("NAME		: %s\n", restaurant_get_text(r, NAME));
+	printf("ADRESS		: %s\n", restaurant_get_text(r, STREET));
+	printf("		: %s\n", restaurant_get_text(r, TOWN));
+	printf("		: %i %s\n", r->text->zip_code, restaurant_get_text(r, LOCALITY));
+	printf("EMAIL		: %s\n", restaurant_get_text(r, E_MAIL));
+	printf("URL		: %s\n", restaurant_get_text(r, URL));
+	printf("FOOD TYPE	: %s\n", restaurant_get_text(r, FOOD_TYPE));
 	printf("WEEKLY REST	: %s\n", day_of_week_text(r->weekly_rest));
-	printf("VACATIONS	: %i/%i -> %i/%i\n", r->vacation_from.tm_mday, r->vacation_from.tm_mon, r->vacation_to.tm_mday,
-			r->vacation_to.tm_mon);
-	printf("PHONE		: %i\n", r->phone);
-	printf("OBS		: %s\n", r->obs);
+	printf("VACATIONS	: %i/%i -> %i/%i\n", r->vacation_from.day, r->vacation_from.month, r->vacation_to.day,
+			r->vacation_to.month);
+	printf("PHONE		: %i\n", r->text->phone);
+	printf("OBS		: %s\n", restaurant_get_text(r, OBS));
 	printf("\n");
 }
 
@@ -337,8 +1288,8 @@ void restaurant_print(prestaurant_t r) {
  */
 void restaurant_list_one(prestaurant_t r) {
 	printf("%5i|%09.4f|%09.4f|%09.4f|%-40s|%-40s|%07i-%s\n", r->id, distance(user_latitude, user_longitude, r->latitude,
-			r->longitude), r->longitude, r->latitude, (r->name == NULL ? "<null>" : r->name), (r->street == NULL ? "<null>"
-			: r->street), r->zip_code, (r->locality == NULL ? "<null>" : r->locality));
+			r->longitude), r->longitude, r->latitude, restaurant_get_text(r, NAME),
+			restaurant_get_text(r, STREET), r->text->zip_code, restaurant_get_text(r, LOCALITY));
 
 }
 
@@ -358,22 +1309,27 @@ void restaurant_list_all() {
 }
 
 void restaurant_list_all_open() {
+	struct restaurant_today_s today;
+
 	printf("<START>\n");
 	printf("ID  |Distance|Longitude|Latitude|Name      |WR    |Vacation\n");
 
+	restaurant_today(&today);
+
+	if (restaurant_top_k > 0) {
+		restaurant_list_top(fn_seeker_restaurant_open, &today, OBS + 1);
+		printf("<END>\n");
+		return;
+	}
+
 	restaurant_list_sort();
 
 	list_iterator_start(&list_restaurants);
 	while (list_iterator_hasnext(&list_restaurants)) {
 		prestaurant_t r = (prestaurant_t) list_iterator_next(&list_restaurants);
 
-		if (fn_seeker_restaurant_open(r, NULL) ) {
-
-			printf("%5i|%09.4f|%09.4f|%09.4f|%-40s|%-4s|%i/%i -> %i/%i\n", r->id, distance(user_latitude, user_longitude,
-					r->latitude, r->longitude), r->longitude, r->latitude, (r->name == NULL ? "<null>" : r->name),
-					day_of_week_text(r->weekly_rest), r->vacation_from.tm_mday, r->vacation_from.tm_mon,
-					r->vacation_to.tm_mday, r->vacation_to.tm_mon);
-		}
+		if (fn_seeker_restaurant_open(r, &today) )
+			restaurant_list_one_open(r);
 
 	}
 	list_iterator_stop(&list_restaurants);
@@ -386,13 +1342,358 @@ void restaurant_save() {
 }
 
 void restaurant_load() {
-	list_restore_file(&list_restaurants, IMPORT_EXPORT_FILE_NAME);
+	restaurant_load_file(IMPORT_EXPORT_FILE_NAME);
+}
+
+int restaurant_load_file(const char *filename) {
+	struct list_mapping_s map, *tmp;
+	size_t rt;
+	int err;
+
+	/* an empty dump restores nothing, and leaves errno as it was */
+	errno = 0;
+	rt = list_restore_mmap(&list_restaurants, filename, &map);
+	if (map.addr != NULL) {
+		/* keep the mapping: the restaurants restored borrow their strings from it */
+		tmp = (struct list_mapping_s *) realloc(restaurant_mappings,
+				(restaurant_mappings_num + 1) * sizeof(struct list_mapping_s));
+		if (tmp != NULL) {
+			restaurant_mappings = tmp;
+			restaurant_mappings[restaurant_mappings_num++] = map;
+		} else {
+			perror("out of memory");
+		}
+	} else {
+		/* the file could not be mapped */
+		errno = 0;
+		rt = list_restore_file(&list_restaurants, filename);
+	}
+	err = (rt == 0 ? errno : 0);
+	/* what was restored before a failure is kept */
+	restaurant_reindex();
+	if (err != 0) {
+		errno = err;
+		return -1;
+	}
+
+	return 0;
+}
+
+unsigned int restaurant_nearest(float latitude, float longitude, unsigned int k, prestaurant_t *out) {
+	struct spatial_hit_s *hits;
+	unsigned int i, n;
+
+	if (k == 0)
+		return 0;
+
+	hits = (struct spatial_hit_s *) malloc(k * sizeof(struct spatial_hit_s));
+	if (!hits) {
+		perror("out of memory");
+		return 0;
+	}
+
+	n = spatial_grid_knn(&restaurant_grid, latitude, longitude, k, hits);
+	for (i = 0; i < n; i++)
+		out[i] = (prestaurant_t) hits[i].data;
+	free(hits);
+
+	return n;
+}
+
+unsigned int restaurant_in_radius(float latitude, float longitude, double radius, prestaurant_t *out,
+		unsigned int max) {
+	struct spatial_hit_s *hits;
+	unsigned int i, n;
+
+	if (max == 0)
+		return 0;
+
+	hits = (struct spatial_hit_s *) malloc(max * sizeof(struct spatial_hit_s));
+	if (!hits) {
+		perror("out of memory");
+		return 0;
+	}
+
+	n = spatial_grid_radius(&restaurant_grid, latitude, longitude, radius, hits, max);
+	for (i = 0; i < n; i++)
+		out[i] = (prestaurant_t) hits[i].data;
+	free(hits);
+
+	return n;
+}
+
+/** Finds the restaurants of a k-d tree nearest to a GPS point
+ * \see restaurant_knn
+ */
+static unsigned int restaurant_kdtree_knn(const spatial_kdtree_t *t, float latitude, float longitude, unsigned int k,
+		prestaurant_t *out) {
+	struct spatial_hit_s *hits;
+	unsigned int i, n;
+
+	if (k == 0)
+		return 0;
+
+	hits = (struct spatial_hit_s *) malloc(k * sizeof(struct spatial_hit_s));
+	if (!hits) {
+		perror("out of memory");
+		return 0;
+	}
+
+	n = spatial_kdtree_knn(t, latitude, longitude, k, hits);
+	for (i = 0; i < n; i++)
+		out[i] = (prestaurant_t) hits[i].data;
+	free(hits);
+
+	return n;
+}
+
+unsigned int restaurant_knn(float latitude, float longitude, unsigned int k, prestaurant_t *out) {
+	if (k == 0 || restaurant_kdtree_update() != 0)
+		return 0;
+
+	return restaurant_kdtree_knn(&restaurant_kdtree, latitude, longitude, k, out);
+}
+
+unsigned int restaurant_in_box(float min_latitude, float min_longitude, float max_latitude, float max_longitude,
+		prestaurant_t *out, unsigned int max) {
+	struct spatial_hit_s *hits;
+	unsigned int i, n;
+
+	if (max == 0 || restaurant_kdtree_update() != 0)
+		return 0;
+
+	hits = (struct spatial_hit_s *) malloc(max * sizeof(struct spatial_hit_s));
+	if (!hits) {
+		perror("out of memory");
+		return 0;
+	}
+
+	n = spatial_kdtree_box(&restaurant_kdtree, min_latitude, min_longitude, max_latitude, max_longitude,
+			user_latitude, user_longitude, hits, max);
+	for (i = 0; i < n; i++)
+		out[i] = (prestaurant_t) hits[i].data;
+	free(hits);
+
+	return n;
+}
+
+/** Finds the restaurants nearest to a GPS point that pass a filter, in the indexes of the
+ *  Restaurant List or of a snapshot
+ * \param coords   coordinate table, in the mode to scan by
+ * \param kdtree   k-d tree over its rows
+ * \param ids      id table over its rows
+ * \param ids_size number of slots in ids
+ * \see restaurant_select
+ */
+static unsigned int restaurant_select_in(const coords_t *coords, const spatial_kdtree_t *kdtree,
+		struct restaurant_id_slot_s *ids, unsigned int ids_size, float latitude, float longitude, unsigned int k,
+		const struct restaurant_filter_s *filter, prestaurant_t *out) {
+	struct restaurant_select_s s;
+	struct restaurant_id_slot_s *slot;
+	prestaurant_t *near;
+	unsigned int i, m, n, found, numels = coords->numels;
+
+	if (filter == NULL || (!filter->open && filter->field < 0))
+		return restaurant_kdtree_knn(kdtree, latitude, longitude, k, out);
+	if (k == 0)
+		return 0;
+
+	s.filter = filter;
+	restaurant_today(&s.today);
+	s.seeker.field = (eRESTAURANTE_FIELDS) filter->field;
+	s.seeker.value = (char *) filter->value;
+
+	/* at most one restaurant has an id: take it from the id table */
+	if (filter->field == ID) {
+		slot = restaurant_ids_lookup(ids, ids_size, (unsigned int) atoi(filter->value));
+		if (slot == NULL || !fn_seeker_restaurant_filter(slot->r, &s))
+			return 0;
+		out[0] = slot->r;
+		return 1;
+	}
+
+	/* most restaurants pass the usual filters: look among the nearest ones first, more
+	 * each time, until enough pass or so many were looked at that a scan is cheaper */
+	for (m = k * RESTAURANT_SELECT_WIDEN; m <= numels / RESTAURANT_SELECT_SCAN; m *= RESTAURANT_SELECT_WIDEN) {
+		near = (prestaurant_t *) malloc(m * sizeof(prestaurant_t));
+		if (!near)
+			break;
+		n = restaurant_kdtree_knn(kdtree, latitude, longitude, m, near);
+		for (i = 0, found = 0; i < n && found < k; i++) {
+			if (fn_seeker_restaurant_filter(near[i], &s))
+				out[found++] = near[i];
+		}
+		free(near);
+		if (found == k || n < m)
+			return found;
+	}
+
+	return coords_select(coords, latitude, longitude, k, fn_seeker_restaurant_filter, &s, (void **) out);
+}
+
+unsigned int restaurant_select(float latitude, float longitude, unsigned int k,
+		const struct restaurant_filter_s *filter, prestaurant_t *out) {
+	if (restaurant_kdtree_update() != 0)
+		return 0;
+	/* only written on a change, so concurrent queries just read it */
+	if (restaurant_coords.mode != restaurant_distance_mode)
+		coords_mode(&restaurant_coords, restaurant_distance_mode);
+
+	return restaurant_select_in(&restaurant_coords, &restaurant_kdtree, restaurant_ids, restaurant_ids_size, latitude,
+			longitude, k, filter, out);
+}
+
+unsigned long restaurant_snapshot_publish() {
+	struct restaurant_snapshot_s *s;
+	unsigned int i;
+
+	s = (struct restaurant_snapshot_s *) calloc(1, sizeof(struct restaurant_snapshot_s));
+	if (!s) {
+		perror("out of memory");
+		return 0;
+	}
+	coords_init(&s->coords);
+	spatial_kdtree_init(&s->kdtree);
+
+	/* the rows in the same order, so the id table copied points at the right ones */
+	for (i = 0; i < restaurant_coords.numels; i++) {
+		if (coords_append(&s->coords, restaurant_coords.latitude[i], restaurant_coords.longitude[i],
+				restaurant_coords.data[i]) != 0)
+			goto fail;
+	}
+	coords_mode(&s->coords, restaurant_distance_mode);
+	if (restaurant_kdtree_build(&s->kdtree, &s->coords) != 0)
+		goto fail;
+	if (restaurant_ids_size > 0) {
+		s->ids = (struct restaurant_id_slot_s *) malloc(restaurant_ids_size * sizeof(struct restaurant_id_slot_s));
+		if (!s->ids) {
+			perror("out of memory");
+			goto fail;
+		}
+		memcpy(s->ids, restaurant_ids, restaurant_ids_size * sizeof(struct restaurant_id_slot_s));
+		s->ids_size = restaurant_ids_size;
+	}
+
+	return snapshot_publish(&restaurant_snapshots, &s->version);
+
+fail:
+	restaurant_snapshot_free(s);
+	return 0;
+}
+
+const restaurant_snapshot_t *restaurant_snapshot_pin() {
+	return (const restaurant_snapshot_t *) snapshot_pin(&restaurant_snapshots);
+}
+
+void restaurant_snapshot_unpin(const restaurant_snapshot_t *s) {
+	if (s != NULL)
+		snapshot_unpin(&restaurant_snapshots, (struct snapshot_s *) &s->version);
+}
+
+unsigned long restaurant_snapshot_number(const restaurant_snapshot_t *s) {
+	return s->version.number;
+}
+
+unsigned int restaurant_snapshot_size(const restaurant_snapshot_t *s) {
+	return s->coords.numels;
+}
+
+prestaurant_t restaurant_snapshot_get(const restaurant_snapshot_t *s, unsigned int i) {
+	return (i < s->coords.numels ? (prestaurant_t) s->coords.data[i] : NULL);
+}
+
+unsigned int restaurant_snapshot_knn(const restaurant_snapshot_t *s, float latitude, float longitude, unsigned int k,
+		prestaurant_t *out) {
+	return restaurant_kdtree_knn(&s->kdtree, latitude, longitude, k, out);
+}
+
+unsigned int restaurant_snapshot_select(const restaurant_snapshot_t *s, float latitude, float longitude,
+		unsigned int k, const struct restaurant_filter_s *filter, prestaurant_t *out) {
+	return restaurant_select_in(&s->coords, &s->kdtree, s->ids, s->ids_size, latitude, longitude, k, filter, out);
+}
+
+void restaurant_list_nearest(unsigned int k) {
+	prestaurant_t *found;
+	unsigned int i, n;
+
+	printf("<START>\n");
+	printf("ID  |Distance|Longitude|Latitude|Name      |Street    |Zip-Code\n");
+
+	found = (prestaurant_t *) malloc((k > 0 ? k : 1) * sizeof(prestaurant_t));
+	if (!found) {
+		perror("out of memory");
+		return;
+	}
+
+	n = restaurant_knn(user_latitude, user_longitude, k, found);
+	for (i = 0; i < n; i++)
+		restaurant_list_one(found[i]);
+	free(found);
+
+	printf("<END>\n");
+}
+
+/** Sort the whole Restaurant List by distance to the user
+ * \see restaurant_list_sort
+ */
+static int restaurant_list_sort_all() {
+	struct list_sortkey_s *keys;
+	struct list_radixkey_s *rkeys;
+	int rt;
+
+	/* the keys come from the coordinate table, without reading the restaurants */
+	if (restaurant_coords.numels != list_size(&list_restaurants))
+		return list_sort(&list_restaurants, -1);
+	coords_mode(&restaurant_coords, restaurant_distance_mode);
+
+	/* long lists: metres are fine enough, and integer keys need no comparisons */
+	if (restaurant_coords.numels >= RESTAURANT_RADIX_MINELS) {
+		rkeys = (struct list_radixkey_s *) malloc(restaurant_coords.numels * sizeof(struct list_radixkey_s));
+		if (rkeys != NULL) {
+			coords_radixkeys(&restaurant_coords, user_latitude, user_longitude, rkeys);
+			rt = list_sort_radix(&list_restaurants, rkeys, restaurant_coords.numels, -1);
+			free(rkeys);
+			if (rt == 0)
+				return 0;
+		}
+	}
+
+	keys = (struct list_sortkey_s *) malloc((restaurant_coords.numels + 1) * sizeof(struct list_sortkey_s));
+	if (keys != NULL) {
+		coords_sortkeys(&restaurant_coords, user_latitude, user_longitude, keys);
+		rt = list_sort_keys(&list_restaurants, keys, restaurant_coords.numels, -1);
+	} else {
+		rt = list_sort(&list_restaurants, -1);
+	}
+	free(keys);
+	return rt;
 }
 
 void restaurant_list_sort() {
-	/* setting the custom comparator */
+	/* setting the custom comparator, and the keyer so each distance is computed once */
 	list_attributes_comparator(&list_restaurants, fn_comparator_restaurant_distance);
-	list_sort(&list_restaurants, -1);
+	list_attributes_keyer(&list_restaurants, fn_keyer_restaurant_distance);
+	list_attributes_threads(&list_restaurants, restaurant_threads);
+
+	if (restaurant_sorted.valid && restaurant_sorted.latitude == user_latitude
+			&& restaurant_sorted.longitude == user_longitude && restaurant_sorted.mode == restaurant_distance_mode) {
+		/* nothing changed since the last sort */
+		if (list_generation(&list_restaurants) == restaurant_sorted.generation)
+			return;
+		/* a few restaurants added: merge them in, by the keyer, which orders as the exact and chord measures */
+		if (restaurant_distance_mode != COORDS_EQUIRECT
+				&& (list_size(&list_restaurants) - list_sorted(&list_restaurants)) * RESTAURANT_REPAIR_RATIO
+						<= list_size(&list_restaurants)
+				&& list_sort_repair(&list_restaurants, -1) == 0) {
+			restaurant_sorted.generation = list_generation(&list_restaurants);
+			return;
+		}
+	}
 
+	restaurant_sorted.valid = (restaurant_list_sort_all() == 0);
+	restaurant_sorted.latitude = user_latitude;
+	restaurant_sorted.longitude = user_longitude;
+	restaurant_sorted.mode = restaurant_distance_mode;
+	restaurant_sorted.generation = list_generation(&list_restaurants);
 }
 
@@ -28,11 +28,54 @@ extern "C" {
 #endif
 
 #include "acdll.h"
+#include "coords.h"
 #include <time.h>
 
+/** Day and Month of a vacation date */
+struct restaurant_date_s {
+	/** Day of the month, 1 to 31 */
+	unsigned char day;
+	/** Month, 1 to 12 */
+	unsigned char month;
+};
+
+/** Pointer to Structure Restaurant Text */
+typedef struct restaurant_text_s* prestaurant_text_t;
+/** Text fields of a restaurant, only read to print or search them
+ * \remarks Every string is allocated on its own, or borrowed from a mapped dump file or
+ * from the arena of the Restaurant List; empty fields are NULL.
+ */
+struct restaurant_text_s {
+	/** Name of the restaurant */
+	char *name;
+	/** Street of the restaurant address*/
+	char *street;
+	/** Town of the restaurant address*/
+	char *town;
+	/** Locality of the restaurant address*/
+	char *locality;
+	/** Email address of the restaurant*/
+	char *e_mail;
+	/** URL for the site of the restaurant */
+	char *url;
+	/** Observations for the restaurant */
+	char *obs;
+	/** Zip Code of the restaurant address*/
+	int zip_code;
+	/** Phone number of the restaurant */
+	int phone;
+	/** Bit (1 << field) set for each string borrowed from a mapped dump file or an arena, not to be freed
+	 * \see eRESTAURANTE_FIELDS
+	 */
+	unsigned short borrowed;
+};
+
 /** Pointer to Structure Restaurant */
 typedef struct restaurant_s* prestaurant_t;
-/**Structure Restaurant */
+/**Structure Restaurant
+ * \remarks Only the fields read by the scans, sorts and open filtering are kept in the
+ * record; the text fields are in a separate record.
+ */
 struct restaurant_s {
 	/** Indentification Number */
 	unsigned int id;
@@ -40,38 +83,25 @@ struct restaurant_s {
 	float longitude;
 	/** GPS Latitude */
 	float latitude;
-	/** Name of the restaurant */
-	char name[255];
-	/** Street of the restaurant address*/
-	char street[255];
-	/** Town of the restaurant address*/
-	char town[255];
-	/** Zip Code of the restaurant address*/
-	int zip_code;
-	/** Locality of the restaurant address*/
-	char locality[255];
-	/** Email address of the restaurant*/
-	char e_mail[255];
-	/** URL for the site of the restaurant */
-	char url[255];
-	/** Brief description of the foof type for the restaurant */
-	char food_type[100];
 	/** Day of the week that the restaurant is close
 	 * \see days_of_week 
 	 */
-	int weekly_rest;
-	/** Day and Month of the start vacation of the restarurant 
-	 * \remarks Only used the tm_mday and tm_mon of the struct tm.
-	 */ 
-	struct tm vacation_from;
-	/** Day and Month of the end vacation of the restaurant 
-	* \remarks Only used the tm_mday and tm_mon of the struct tm.
-	*/ 
-	struct tm vacation_to;
-	/** Phone number of the restaurant */
-	int phone;
-	/** Observations for the restaurant */
-	char obs[500];
+	unsigned char weekly_rest;
+	/** Day and Month of the start vacation of the restarurant */
+	struct restaurant_date_s vacation_from;
+	/** Day and Month of the end vacation of the restaurant */
+	struct restaurant_date_s vacation_to;
+	/** Food type of the restaurant, by its number in the food types table
+	 * \see restaurant_food_type_name
+	 */
+	unsigned short food_type;
+	/** Non-0 if the restaurant and its text record were allocated from the arena of the
+	 * Restaurant List, by a restore or an import, and are freed along with it
+	 * \see restaurant_free
+	 */
+	unsigned char arena;
+	/** Text fields of the restaurant */
+	prestaurant_text_t text;
 };
 
 /**  Enumerator for all the fields in the restaurant Struct */
@@ -94,6 +124,24 @@ typedef enum{
 	OBS
 } eRESTAURANTE_FIELDS;
 
+/** Filter of the restaurants selected by restaurant_select() */
+struct restaurant_filter_s {
+	/** True to select only the restaurants open today */
+	int open;
+	/** Field the restaurants must match, or -1 for any
+	 * \see eRESTAURANTE_FIELDS
+	 */
+	int field;
+	/** Value the field must be equal to, as for restaurant_find() */
+	const char *value;
+};
+
+/**
+ * \brief Type defenition for struct restaurant_snapshot_s
+ * \see restaurant_snapshot_pin
+ */
+typedef struct restaurant_snapshot_s restaurant_snapshot_t;
+
 //globals
 /** \brief Glogal Restaurant List 
  *  Double linked List were is storage, in memory all Restaurant.
@@ -101,6 +149,25 @@ typedef enum{
  */
 list_t list_restaurants;
 
+/** Maximum number of restaurants printed by the open and find listings, nearest first.
+ * \remarks 0 lists all of them.
+ * \see restaurant_list_all_open
+ * \see restaurant_find_all
+ */
+extern unsigned int restaurant_top_k;
+
+/** Measure used to order the restaurants by distance to the user in the sort, open and find listings.
+ * \remarks The distance printed for each restaurant is always the exact one.
+ * \see eCOORDS_MODE
+ */
+extern eCOORDS_MODE restaurant_distance_mode;
+
+/** Number of threads sorting the Restaurant List by distance, importing poi.csv and answering --serve queries.
+ * \remarks 0 uses one per processor; lists or files too small to split take one thread anyway.
+ * \see restaurant_list_sort
+ */
+extern unsigned int restaurant_threads;
+
 //extern function
 /**
  *  Initializes the Restaurant list.
@@ -115,6 +182,14 @@ void restaurant_init();
 */
 prestaurant_t restaurant_new();
 
+/**
+ * Copy a restaurant, to edit the copy and put it in place of the original with restaurant_replace().
+ * \param r pointer to the restaurant to copy
+ * \return pointer to the copy, with the same id and its own copy of every string; NULL if out of memory
+ * \note the copy is not in the Restaurant List
+ */
+prestaurant_t restaurant_copy(prestaurant_t r);
+
 /** Get the field name for de Enum value.
  * \param f field position.
  * \return the field name
@@ -123,6 +198,60 @@ prestaurant_t restaurant_new();
  */
 const char *restaurant_get_field_name(eRESTAURANTE_FIELDS f);
 
+/** Get the field for a name, or a number.
+ * \param s field name, as given by restaurant_get_field_name(), or number
+ * \return the field, or -1 if not found
+ */
+int restaurant_field_find(const char *s);
+
+/**
+ * Free a restaurant, along with its text fields.
+ * \param r pointer to the restaurant
+ * \pre the restaurant must not be in the Restaurant List
+ * \remarks Restaurants restored from a dump live in the arena of the Restaurant List: only
+ * their own strings are freed, the rest goes with restaurant_clear(). Their arena flag tells
+ * them apart, so the list itself is not read: retired restaurants are freed on whichever
+ * thread unpins the last snapshot holding them.
+ */
+void restaurant_free(prestaurant_t r);
+
+/**
+ * Get the location of a text field of a restaurant.
+ * \param r pointer to the restaurant
+ * \param f field to get
+ * \return pointer to the field string in the text record of r, or NULL if f is not a text
+ * field, as FOOD_TYPE is not
+ * \remarks Storing a string there bypasses restaurant_set_text(): the caller tells if the
+ * restaurant owns it, with the borrowed bits of the text record.
+ */
+char **restaurant_text_field(prestaurant_t r, eRESTAURANTE_FIELDS f);
+
+/**
+ * Get a text field of a restaurant.
+ * \param r pointer to the restaurant
+ * \param f field to get: a text field or FOOD_TYPE
+ * \return the field value, "" if it is empty, or NULL if f is not a text field
+ */
+const char *restaurant_get_text(prestaurant_t r, eRESTAURANTE_FIELDS f);
+
+/**
+ * Set a text field of a restaurant.
+ * \param r pointer to the restaurant
+ * \param f field to set: a text field or FOOD_TYPE
+ * \param v value to copy into the field
+ * \return 0 for success. -1 for failure
+ * \remarks a restaurant of the Restaurant List, which a snapshot may hold, is not changed in
+ * place: a copy of it is, by restaurant_copy(), and then put in its place by restaurant_replace().
+ */
+int restaurant_set_text(prestaurant_t r, eRESTAURANTE_FIELDS f, const char *v);
+
+/**
+ * Get the name of a food type.
+ * \param id number of the food type
+ * \return the food type name, or "" for an unknown one
+ */
+const char *restaurant_food_type_name(unsigned short id);
+
 /**
  * Print all information about the restaurant.
  * \param r pointer to the restaurant.
@@ -137,11 +266,18 @@ void restaurant_list_all();
 
 /**
  * Put all elements from the Restaurant List in a especific order.
+ * \remarks From RESTAURANT_RADIX_MINELS restaurants on, the distances are rounded to the
+ * metre and radix sorted, on restaurant_threads threads: restaurants within a metre of each
+ * other keep their order.
+ * \remarks Nothing is done if neither the list, the user position nor the measure changed
+ * since the last sort; restaurants only added since are merged into the sorted ones.
  */
 void restaurant_list_sort();
 
 /**
  * List all restaurants, from the Restaurant List that are not in vacations or in his weekly rest today.
+ * \remarks if restaurant_top_k is set only the nearest ones are selected, in a single pass,
+ * without sorting the list.
  */
 void restaurant_list_all_open();
 
@@ -155,15 +291,39 @@ void restaurant_list_all_open();
 */ 
 int restaurant_insert(prestaurant_t r);
 
+/**
+ * Insert many restaurants in the Restaurant List at once.
+ * \param rs    array of the restaurants to include in the list, in order
+ * \param n     number of restaurants in rs
+ * \return      n if they were all inserted; -1 otherwise, with none inserted
+ * \remarks the IDs are automatic fill by this function.
+ * \see restaurant_insert
+ * \see list_append_array
+ */
+int restaurant_insert_array(prestaurant_t *rs, unsigned int n);
+
 /**
  * Removes a restaurant from the Restaurant List.
  * \param r pointer to the restaurant to be removed from the list.
- * \see list_delete_at
+ * \remarks the restaurant is freed, once no snapshot holding it is pinned. It is found
+ * through the id table, in O(1) whatever the order or size of the list.
+ * \see list_delete
 */ 
 void restaurant_delete(prestaurant_t r);
 
+/**
+ * Replace a restaurant of the Restaurant List with another, at the same place and with the
+ * same id: the way to change a restaurant that a snapshot may hold.
+ * \param old pointer to the restaurant to be replaced; it is freed as by restaurant_delete()
+ * \param r pointer to the restaurant replacing it, which must not be in the list
+ * \return 0 for success. -1 for failure, with the list unchanged
+ * \see restaurant_snapshot_publish
+ */
+int restaurant_replace(prestaurant_t old, prestaurant_t r);
+
 /**
  * Clear all restaurants from the Restaurant List
+ * \remarks the snapshots go too: none may be pinned.
  * \see list_destroy
  */
 void restaurant_clear();
@@ -173,6 +333,7 @@ void restaurant_clear();
  * \param f field where to look for
  * \param v Value to look for
  * \return 	Pointer to the first found restaurant.
+ * \remarks Looking for an ID takes O(1), through the id table; other fields scan the list.
  */
 prestaurant_t restaurant_find(eRESTAURANTE_FIELDS f, const char *v);
 
@@ -180,9 +341,167 @@ prestaurant_t restaurant_find(eRESTAURANTE_FIELDS f, const char *v);
  * Prints a list with all restaurants in the Restaurant List that have the field f iquals to v.
  * \param f field where to look for
  * \param v Value to look for
+ * \remarks if restaurant_top_k is set only the nearest ones are selected, in a single pass,
+ * without sorting the list.
  */
 void restaurant_find_all(eRESTAURANTE_FIELDS f, const char *v);
 
+/**
+ * Finds the restaurants nearest to a GPS point.
+ * \param latitude GPS latitude of the point
+ * \param longitude GPS longitude of the point
+ * \param k maximum number of restaurants to find
+ * \param out array of at least k restaurants to fill, nearest first
+ * \return number of restaurants stored in out
+ * \remarks only the cells of the spatial index around the point are visited.
+ * \see spatial_grid_knn
+ */
+unsigned int restaurant_nearest(float latitude, float longitude, unsigned int k, prestaurant_t *out);
+
+/**
+ * Finds the restaurants within a distance of a GPS point.
+ * \param latitude GPS latitude of the point
+ * \param longitude GPS longitude of the point
+ * \param radius maximum distance in Km
+ * \param out array of at least max restaurants to fill, nearest first
+ * \param max maximum number of restaurants to store in out
+ * \return number of restaurants stored in out
+ * \see spatial_grid_radius
+ */
+unsigned int restaurant_in_radius(float latitude, float longitude, double radius, prestaurant_t *out,
+		unsigned int max);
+
+/**
+ * Finds the restaurants nearest to a GPS point using the k-d tree.
+ * \param latitude GPS latitude of the point
+ * \param longitude GPS longitude of the point
+ * \param k maximum number of restaurants to find
+ * \param out array of at least k restaurants to fill, nearest first
+ * \return number of restaurants stored in out
+ * \remarks unlike restaurant_nearest() the cost does not depend on how crowded the area is.
+ * The k-d tree is built again by the first query after any change to the Restaurant List.
+ * \see spatial_kdtree_knn
+ */
+unsigned int restaurant_knn(float latitude, float longitude, unsigned int k, prestaurant_t *out);
+
+/**
+ * Finds the restaurants nearest to a GPS point that pass a filter.
+ * \param latitude GPS latitude of the point
+ * \param longitude GPS longitude of the point
+ * \param k maximum number of restaurants to find
+ * \param filter restaurants to select, or NULL for all
+ * \param out array of at least k restaurants to fill, nearest first
+ * \return number of restaurants stored in out
+ * \remarks without a filter this is restaurant_knn(). Otherwise the filter is tried on ever
+ * more of the nearest restaurants, from the k-d tree, until k pass; a filter few restaurants
+ * pass ends in a scan of them all, measured by restaurant_distance_mode, where only those
+ * near enough are filtered.
+ * \see coords_select
+ */
+unsigned int restaurant_select(float latitude, float longitude, unsigned int k,
+		const struct restaurant_filter_s *filter, prestaurant_t *out);
+
+/**
+ * Publish a snapshot of the Restaurant List as it is now, for the readers pinning from now on.
+ *
+ * A snapshot is an immutable copy of the set of restaurants and of the indexes queries
+ * need, built by the thread changing the list, the writer: any number of threads can then
+ * query it, and traverse it, with no lock held, while the writer goes on changing the
+ * list for the next snapshot. Snapshots older than the one published are destroyed once
+ * no reader holds them.
+ *
+ * \return number of the snapshot, from 1; 0 if out of memory
+ * \remarks The restaurants themselves are shared with the snapshots, so the writer must not
+ * change one in place once published, but replace it with restaurant_replace(); restaurants
+ * deleted or replaced are only freed once no snapshot holding them is pinned. Snapshots
+ * order their scans by the restaurant_distance_mode of the time they were published.
+ * \see snapshot_publish
+ */
+unsigned long restaurant_snapshot_publish();
+
+/**
+ * Pin the last snapshot published, so it stays as it is until unpinned.
+ * \return the snapshot, or NULL if none was published
+ * \see restaurant_snapshot_unpin
+ */
+const restaurant_snapshot_t *restaurant_snapshot_pin();
+
+/**
+ * Unpin a snapshot pinned by restaurant_snapshot_pin(); it must not be read any more.
+ * \param s snapshot; NULL, as pinned when none was published, does nothing
+ */
+void restaurant_snapshot_unpin(const restaurant_snapshot_t *s);
+
+/**
+ * Get the number of a snapshot.
+ * \param s snapshot
+ * \return number of the snapshot, as returned by restaurant_snapshot_publish()
+ */
+unsigned long restaurant_snapshot_number(const restaurant_snapshot_t *s);
+
+/**
+ * Get the number of restaurants in a snapshot.
+ * \param s snapshot
+ * \return number of restaurants
+ */
+unsigned int restaurant_snapshot_size(const restaurant_snapshot_t *s);
+
+/**
+ * Get a restaurant of a snapshot: any number of threads may traverse one at a time.
+ * \param s snapshot
+ * \param i [0,size-1] restaurant to get; restaurants have no particular order
+ * \return the restaurant, or NULL if there is no such restaurant
+ */
+prestaurant_t restaurant_snapshot_get(const restaurant_snapshot_t *s, unsigned int i);
+
+/**
+ * Finds the restaurants of a snapshot nearest to a GPS point.
+ * \param s snapshot
+ * \param latitude GPS latitude of the point
+ * \param longitude GPS longitude of the point
+ * \param k maximum number of restaurants to find
+ * \param out array of at least k restaurants to fill, nearest first
+ * \return number of restaurants stored in out
+ * \see restaurant_knn
+ */
+unsigned int restaurant_snapshot_knn(const restaurant_snapshot_t *s, float latitude, float longitude, unsigned int k,
+		prestaurant_t *out);
+
+/**
+ * Finds the restaurants of a snapshot nearest to a GPS point that pass a filter.
+ * \param s snapshot
+ * \param latitude GPS latitude of the point
+ * \param longitude GPS longitude of the point
+ * \param k maximum number of restaurants to find
+ * \param filter restaurants to select, or NULL for all
+ * \param out array of at least k restaurants to fill, nearest first
+ * \return number of restaurants stored in out
+ * \see restaurant_select
+ */
+unsigned int restaurant_snapshot_select(const restaurant_snapshot_t *s, float latitude, float longitude,
+		unsigned int k, const struct restaurant_filter_s *filter, prestaurant_t *out);
+
+/**
+ * Finds the restaurants inside a latitude/longitude box.
+ * \param min_latitude south edge of the box
+ * \param min_longitude west edge of the box
+ * \param max_latitude north edge of the box
+ * \param max_longitude east edge of the box
+ * \param out array of at least max restaurants to fill, nearest to the user first
+ * \param max maximum number of restaurants to store in out
+ * \return number of restaurants stored in out
+ * \see spatial_kdtree_box
+ */
+unsigned int restaurant_in_box(float min_latitude, float min_longitude, float max_latitude, float max_longitude,
+		prestaurant_t *out, unsigned int max);
+
+/**
+ * Prints a list with the k restaurants nearest to the user.
+ * \param k maximum number of restaurants to list
+ * \see restaurant_knn
+ */
+void restaurant_list_nearest(unsigned int k);
+
 /**
  * Imports from file restaurants into the Restaurant List
  * \see IMPORT_EXPORT_FILE_NAME
@@ -190,6 +509,17 @@ void restaurant_find_all(eRESTAURANTE_FIELDS f, const char *v);
  */
 void restaurant_load();
 
+/**
+ * Imports from a given file restaurants into the Restaurant List
+ * \param filename file previously written by restaurant_save()
+ * \remarks the file is mapped in memory and the text of the restaurants points into it
+ * until restaurant_clear().
+ * \return 0 for success. -1 for failure, with errno set, when the file is missing or is not a
+ * whole dump; the restaurants read before the failure are kept
+ * \see list_restore_mmap
+ */
+int restaurant_load_file(const char *filename);
+
 /**
  * Exports to file the Restaurant List
  * \see IMPORT_EXPORT_FILE_NAME
@@ -197,6 +527,49 @@ void restaurant_load();
  */
 void restaurant_save();
 
+/**
+ * Compare two restaurants by their distance to the user, the comparator of the Restaurant List
+ * \param p1 pointer to Restaurant 1
+ * \param p2 pointer to Restaurant 2
+ * \return <0, 0, or >0 as p1 is nearer than, as near as, or farther than p2
+ */
+int fn_comparator_restaurant_distance(const void *p1, const void *p2);
+
+/**
+ * Get the distance of a restaurant to the user, the keyer of the Restaurant List
+ * \param el pointer to Restaurant
+ * \return distance of the restaurant to the user
+ */
+double fn_keyer_restaurant_distance(const void *el);
+
+/**
+ * Tell if a restaurant is open today, the seeker of restaurant_list_all_open()
+ * \param el pointer to Restaurant
+ * \param indicator NULL, for today's date
+ * \return 1 if the restaurant is neither on vacation nor on its weekly rest today, otherwise 0
+ */
+int fn_seeker_restaurant_open(const void *el, const void *indicator);
+
+/**
+ * Serialize a restaurant as fn_serializer_restaurant() does, with a food type given by name
+ * \param r             restaurant
+ * \param food_type     name of its food type, "" for none, in place of the one of its id
+ * \param serializ_len  length of the record returned
+ * \return              new record, to be freed; NULL if out of memory
+ * \remarks Writers of dump files that do not load the restaurants, as import_csv_stream(),
+ * leave the food types of the Restaurant List alone this way.
+ */
+void *restaurant_serialize(prestaurant_t r, const char *food_type, unsigned int *serializ_len);
+
+/**
+ * Serialize a restaurant as it is written in the files of restaurant_save()
+ * \param el            restaurant
+ * \param serializ_len  length of the record returned
+ * \return              new record, to be freed; NULL if out of memory
+ * \see list_dump_stream_put
+ */
+void *fn_serializer_restaurant(const void *el, unsigned int *serializ_len);
+
 #ifdef	__cplusplus
 }
 #endif
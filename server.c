@@ -0,0 +1,678 @@
+/**
+ *      \file server.c
+ * 		\brief Implementation file for the query server of the Restaurant List
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "server.h"
+#include "query.h"
+
+#ifndef SERVER_BACKLOG
+/** Connections waiting to be accepted */
+#define SERVER_BACKLOG 128
+#endif
+
+#ifndef SERVER_EVENTS
+/** Events taken from epoll at once */
+#define SERVER_EVENTS 64
+#endif
+
+/** Size a connection buffer starts with */
+#define SERVER_BUFFER_MIN 4096
+
+/** Connection of a client */
+struct server_conn_s {
+	/** Socket; -1 once closed */
+	int fd;
+	/** Bytes read, not yet handed to a worker */
+	char *in;
+	/** Number of bytes in in */
+	size_t inlen;
+	/** Number of bytes allocated in in */
+	size_t insize;
+	/** Complete lines handed to a worker */
+	char *work;
+	/** Number of bytes in work */
+	size_t worklen;
+	/** Number of bytes allocated in work */
+	size_t worksize;
+	/** Answers of the worker to work */
+	char *answer;
+	/** Number of bytes in answer */
+	size_t answerlen;
+	/** Answers not yet written to the socket */
+	char *out;
+	/** Number of bytes of out already written */
+	size_t outpos;
+	/** Number of bytes in out */
+	size_t outlen;
+	/** Number of bytes allocated in out */
+	size_t outsize;
+	/** Lines read from the connection, numbering its queries */
+	unsigned int lines;
+	/** Queries the worker answered */
+	unsigned int queries;
+	/** Malformed queries the worker found */
+	unsigned int rejected;
+	/** With a worker, which owns work, answer, lines, queries, rejected and oom till it is done */
+	int busy;
+	/** The worker ran out of memory */
+	int oom;
+	/** in was full when last read: the socket may hold more */
+	int stalled;
+	/** The client is done writing, or the connection failed */
+	int closing;
+	/** The connection failed: its answers are dropped */
+	int failed;
+	/** Next connection in a queue of the server */
+	struct server_conn_s *next;
+	/** Previous connection of the server */
+	struct server_conn_s *link_prev;
+	/** Next connection of the server */
+	struct server_conn_s *link_next;
+};
+
+/** State of a running server */
+struct server_s {
+	/** Listening socket */
+	int lfd;
+	/** Counter the workers signal done connections on */
+	int efd;
+	/** epoll instance */
+	int epfd;
+	/** Guards the queues and stop */
+	pthread_mutex_t lock;
+	/** Signals connections to the workers */
+	pthread_cond_t cond;
+	/** Connections waiting for a worker, oldest first */
+	struct server_conn_s *jobs;
+	/** Last connection of jobs */
+	struct server_conn_s *jobs_tail;
+	/** Connections the workers are done with */
+	struct server_conn_s *done;
+	/** Connections closed while handling the current events, freed after them */
+	struct server_conn_s *dead;
+	/** Every open connection */
+	struct server_conn_s *conns;
+	/** The workers are to finish */
+	int stop;
+	/** Outcome of the run */
+	struct server_stats_s st;
+};
+
+/** Set by SIGINT and SIGTERM */
+static volatile sig_atomic_t server_interrupted = 0;
+
+/**
+ * Handler of SIGINT and SIGTERM
+ * \param sig   signal caught
+ */
+static void server_interrupt(int sig) {
+	server_interrupted = 1;
+}
+
+/**
+ * Make room for more bytes in a buffer
+ * \param buf   buffer
+ * \param size  number of bytes allocated in buf
+ * \param need  number of bytes needed
+ * \return      0, or -1 if out of memory
+ */
+static int server_reserve(char **buf, size_t *size, size_t need) {
+	size_t n = (*size > 0 ? *size : SERVER_BUFFER_MIN);
+	char *tmp;
+
+	if (need <= *size)
+		return 0;
+	while (n < need)
+		n *= 2;
+	tmp = (char *) realloc(*buf, n);
+	if (tmp == NULL) {
+		perror("out of memory");
+		return -1;
+	}
+	*buf = tmp;
+	*size = n;
+
+	return 0;
+}
+
+/**
+ * Answer the lines handed to a worker into the answer of the connection
+ * \param c     connection
+ * \param h     room for the restaurants found
+ */
+static void server_answer(struct server_conn_s *c, struct query_hits_s *h) {
+	const restaurant_snapshot_t *snap;
+	FILE *f;
+	char *p, *nl, *end = c->work + c->worklen;
+	double micros;
+	int rt;
+
+	c->queries = c->rejected = c->oom = 0;
+	c->answer = NULL;
+	c->answerlen = 0;
+	f = open_memstream(&c->answer, &c->answerlen);
+	if (f == NULL) {
+		perror("out of memory");
+		c->oom = 1;
+		return;
+	}
+
+	/* the lines handed over at once are answered from the same snapshot */
+	snap = restaurant_snapshot_pin();
+	for (p = c->work; p < end; p = nl + 1) {
+		nl = (char *) memchr(p, '\n', end - p);
+		*nl = '\0';
+		c->lines++;
+		/* as long as the batches take */
+		if (nl - p >= QUERY_LINE_MAX - 1) {
+			query_write(f, c->lines, NULL, NULL, 0, 0);
+			c->rejected++;
+			continue;
+		}
+		rt = query_answer(f, snap, c->lines, p, h, &micros);
+		if (rt == -2) {
+			c->oom = 1;
+			break;
+		}
+		if (rt < 0)
+			c->rejected++;
+		if (rt > 0)
+			c->queries++;
+	}
+	restaurant_snapshot_unpin(snap);
+
+	if (fclose(f) != 0)
+		c->oom = 1;
+}
+
+/**
+ * Worker thread: answers the connections queued by the loop
+ * \param arg   server
+ * \return      NULL
+ */
+static void *server_work(void *arg) {
+	struct server_s *s = (struct server_s *) arg;
+	struct server_conn_s *c;
+	struct query_hits_s h = { NULL, 0 };
+	uint64_t one = 1;
+
+	pthread_mutex_lock(&s->lock);
+	for (;;) {
+		while (!s->stop && s->jobs == NULL)
+			pthread_cond_wait(&s->cond, &s->lock);
+		if (s->stop)
+			break;
+		c = s->jobs;
+		s->jobs = c->next;
+		pthread_mutex_unlock(&s->lock);
+
+		server_answer(c, &h);
+
+		pthread_mutex_lock(&s->lock);
+		c->next = s->done;
+		s->done = c;
+		pthread_mutex_unlock(&s->lock);
+		if (write(s->efd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+			perror("eventfd");
+		pthread_mutex_lock(&s->lock);
+	}
+	pthread_mutex_unlock(&s->lock);
+
+	free(h.hits);
+
+	return NULL;
+}
+
+/**
+ * Close a connection; it is freed after the events being handled
+ * \param s     server
+ * \param c     connection
+ */
+static void server_close(struct server_s *s, struct server_conn_s *c) {
+	close(c->fd);
+	c->fd = -1;
+
+	if (c->link_prev != NULL)
+		c->link_prev->link_next = c->link_next;
+	else
+		s->conns = c->link_next;
+	if (c->link_next != NULL)
+		c->link_next->link_prev = c->link_prev;
+
+	c->next = s->dead;
+	s->dead = c;
+}
+
+/**
+ * Free a connection
+ * \param c     connection
+ */
+static void server_free(struct server_conn_s *c) {
+	free(c->in);
+	free(c->work);
+	free(c->answer);
+	free(c->out);
+	free(c);
+}
+
+/**
+ * Accept the connections waiting on the listening socket
+ * \param s     server
+ */
+static void server_accept(struct server_s *s) {
+	struct server_conn_s *c;
+	struct epoll_event ev;
+	int fd;
+
+	for (;;) {
+		fd = accept(s->lfd, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				perror("accept");
+			return;
+		}
+		fcntl(fd, F_SETFL, O_NONBLOCK);
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+		c = (struct server_conn_s *) calloc(1, sizeof(struct server_conn_s));
+		if (c == NULL) {
+			perror("out of memory");
+			close(fd);
+			continue;
+		}
+		c->fd = fd;
+
+		/* edge triggered: read and written till the socket would block */
+		ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		ev.data.ptr = c;
+		if (epoll_ctl(s->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+			perror("epoll_ctl");
+			close(fd);
+			free(c);
+			continue;
+		}
+
+		c->link_next = s->conns;
+		if (s->conns != NULL)
+			s->conns->link_prev = c;
+		s->conns = c;
+		s->st.connections++;
+	}
+}
+
+/**
+ * Read what a client wrote, until the socket would block or in is full
+ * \param c     connection
+ */
+static void server_read(struct server_conn_s *c) {
+	ssize_t r;
+
+	c->stalled = 0;
+	while (!c->closing) {
+		if (c->inlen == c->insize) {
+			if (c->insize >= SERVER_IN_MAX) {
+				c->stalled = 1;
+				return;
+			}
+			if (server_reserve(&c->in, &c->insize, c->inlen + 1) < 0) {
+				c->closing = c->failed = 1;
+				return;
+			}
+		}
+
+		r = read(c->fd, c->in + c->inlen, c->insize - c->inlen);
+		if (r > 0) {
+			c->inlen += r;
+		} else if (r == 0) {
+			c->closing = 1;
+			/* a last line without its end */
+			if (c->inlen > 0 && c->in[c->inlen - 1] != '\n') {
+				if (server_reserve(&c->in, &c->insize, c->inlen + 1) < 0)
+					c->failed = 1;
+				else
+					c->in[c->inlen++] = '\n';
+			}
+		} else if (errno != EINTR) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				c->closing = c->failed = 1;
+			return;
+		}
+	}
+}
+
+/**
+ * Write the answers of a connection, until the socket would block
+ * \param c     connection
+ */
+static void server_flush(struct server_conn_s *c) {
+	ssize_t r;
+
+	while (c->outpos < c->outlen && !c->failed) {
+		r = send(c->fd, c->out + c->outpos, c->outlen - c->outpos, MSG_NOSIGNAL);
+		if (r >= 0) {
+			c->outpos += r;
+		} else if (errno != EINTR) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				c->closing = c->failed = 1;
+			return;
+		}
+	}
+	c->outpos = c->outlen = 0;
+}
+
+/**
+ * Move on a connection that has no worker: write its answers, hand its complete lines
+ * to a worker, or close it once it is done
+ * \param s     server
+ * \param c     connection
+ */
+static void server_update(struct server_s *s, struct server_conn_s *c) {
+	size_t len;
+
+	if (c->busy || c->fd < 0)
+		return;
+
+	server_flush(c);
+
+	if (!c->failed && c->outlen - c->outpos < SERVER_OUT_MAX) {
+		for (len = c->inlen; len > 0 && c->in[len - 1] != '\n'; len--)
+			;
+		if (len > 0) {
+			if (server_reserve(&c->work, &c->worksize, len) < 0) {
+				c->closing = c->failed = 1;
+			} else {
+				memcpy(c->work, c->in, len);
+				c->worklen = len;
+				memmove(c->in, c->in + len, c->inlen - len);
+				c->inlen -= len;
+
+				c->busy = 1;
+				c->next = NULL;
+				pthread_mutex_lock(&s->lock);
+				if (s->jobs == NULL)
+					s->jobs = c;
+				else
+					s->jobs_tail->next = c;
+				s->jobs_tail = c;
+				pthread_cond_signal(&s->cond);
+				pthread_mutex_unlock(&s->lock);
+
+				/* the lines left room for what the socket still holds */
+				if (c->stalled)
+					server_read(c);
+				return;
+			}
+		} else if (c->stalled) {
+			fprintf(stderr, "line longer than %d bytes: connection closed\n", SERVER_IN_MAX);
+			c->closing = c->failed = 1;
+		}
+	}
+
+	if (c->closing && (c->failed || (c->outlen == 0 && c->inlen == 0)))
+		server_close(s, c);
+}
+
+/**
+ * Take the answers of the connections the workers are done with
+ * \param s     server
+ */
+static void server_done(struct server_s *s) {
+	struct server_conn_s *c, *next;
+	uint64_t n;
+
+	if (read(s->efd, &n, sizeof(n)) < 0 && errno != EAGAIN)
+		perror("eventfd");
+
+	pthread_mutex_lock(&s->lock);
+	c = s->done;
+	s->done = NULL;
+	pthread_mutex_unlock(&s->lock);
+
+	for (; c != NULL; c = next) {
+		next = c->next;
+		c->busy = 0;
+		s->st.queries += c->queries;
+		s->st.rejected += c->rejected;
+		if (c->oom)
+			c->closing = c->failed = 1;
+
+		if (!c->failed && c->answerlen > 0) {
+			if (c->outlen == 0) {
+				/* nothing waiting: the answers become the output */
+				free(c->out);
+				c->out = c->answer;
+				c->outsize = c->answerlen;
+				c->outlen = c->answerlen;
+				c->outpos = 0;
+				c->answer = NULL;
+			} else if (server_reserve(&c->out, &c->outsize, c->outlen + c->answerlen) < 0) {
+				c->closing = c->failed = 1;
+			} else {
+				memcpy(c->out + c->outlen, c->answer, c->answerlen);
+				c->outlen += c->answerlen;
+			}
+		}
+		free(c->answer);
+		c->answer = NULL;
+		c->answerlen = 0;
+
+		server_update(s, c);
+	}
+}
+
+/**
+ * Open the listening socket
+ * \param path  path of the socket
+ * \return      socket, or -1 if it cannot be opened
+ */
+static int server_listen(const char *path) {
+	struct sockaddr_un addr;
+	struct stat sb;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "%s: socket path too long\n", path);
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	/* left behind by a server that did not stop cleanly; nothing else is removed */
+	if (lstat(path, &sb) == 0 && S_ISSOCK(sb.st_mode))
+		unlink(path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, SERVER_BACKLOG) < 0) {
+		perror(path);
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int server_run(const char *path, unsigned int workers, struct server_stats_s *st) {
+	struct server_s s;
+	struct epoll_event ev, events[SERVER_EVENTS];
+	struct sigaction sa, oldint, oldterm;
+	sigset_t mask, oldmask;
+	struct timespec t0, t1;
+	struct server_conn_s *c;
+	pthread_t *threads = NULL;
+	unsigned int started = 0;
+	long cpus;
+	int i, n, rt = -1;
+
+	if (workers == 0) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		workers = (cpus > 0 ? (unsigned int) cpus : 1);
+	}
+
+	memset(&s, 0, sizeof(s));
+	s.efd = s.epfd = -1;
+	pthread_mutex_init(&s.lock, NULL);
+	pthread_cond_init(&s.cond, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	s.lfd = server_listen(path);
+	if (s.lfd < 0)
+		goto out;
+	s.efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	s.epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (s.efd < 0 || s.epfd < 0) {
+		perror("epoll");
+		goto out;
+	}
+	/* the listening socket and the counter are told apart by their address */
+	ev.events = EPOLLIN;
+	ev.data.ptr = &s.lfd;
+	if (epoll_ctl(s.epfd, EPOLL_CTL_ADD, s.lfd, &ev) < 0) {
+		perror("epoll_ctl");
+		goto out;
+	}
+	ev.data.ptr = &s.efd;
+	if (epoll_ctl(s.epfd, EPOLL_CTL_ADD, s.efd, &ev) < 0) {
+		perror("epoll_ctl");
+		goto out;
+	}
+
+	if (restaurant_snapshot_publish() == 0)
+		goto out;
+
+	threads = (pthread_t *) malloc(workers * sizeof(pthread_t));
+	if (threads == NULL) {
+		perror("out of memory");
+		goto out;
+	}
+	/* the workers block the signals, so they interrupt epoll_wait() */
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &mask, &oldmask);
+	for (started = 0; started < workers; started++) {
+		if (pthread_create(&threads[started], NULL, server_work, &s) != 0) {
+			perror("pthread_create");
+			break;
+		}
+	}
+	pthread_sigmask(SIG_SETMASK, &oldmask, NULL);
+	if (started < workers)
+		goto out;
+
+	server_interrupted = 0;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = server_interrupt;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, &oldint);
+	sigaction(SIGTERM, &sa, &oldterm);
+
+	while (!server_interrupted) {
+		n = epoll_wait(s.epfd, events, SERVER_EVENTS, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("epoll_wait");
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			if (events[i].data.ptr == &s.lfd) {
+				server_accept(&s);
+			} else if (events[i].data.ptr == &s.efd) {
+				server_done(&s);
+			} else {
+				c = (struct server_conn_s *) events[i].data.ptr;
+				/* closed by an earlier event */
+				if (c->fd < 0)
+					continue;
+				if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+					server_read(c);
+				server_update(&s, c);
+			}
+		}
+
+		while (s.dead != NULL) {
+			c = s.dead;
+			s.dead = c->next;
+			server_free(c);
+		}
+	}
+	rt = server_interrupted ? 0 : -1;
+
+	sigaction(SIGINT, &oldint, NULL);
+	sigaction(SIGTERM, &oldterm, NULL);
+
+out:
+	pthread_mutex_lock(&s.lock);
+	s.stop = 1;
+	pthread_cond_broadcast(&s.cond);
+	pthread_mutex_unlock(&s.lock);
+	while (started > 0)
+		pthread_join(threads[--started], NULL);
+	free(threads);
+
+	while (s.conns != NULL) {
+		c = s.conns;
+		s.conns = c->link_next;
+		close(c->fd);
+		server_free(c);
+	}
+	if (s.epfd >= 0)
+		close(s.epfd);
+	if (s.efd >= 0)
+		close(s.efd);
+	if (s.lfd >= 0) {
+		close(s.lfd);
+		unlink(path);
+	}
+	pthread_cond_destroy(&s.cond);
+	pthread_mutex_destroy(&s.lock);
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	s.st.seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	if (st != NULL)
+		*st = s.st;
+
+	return rt;
+}
@@ -0,0 +1,79 @@
+/**
+ *      \file server.h
+ * 		\brief Heather file for the query server of the Restaurant List
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifndef _SERVER_H
+#define	_SERVER_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#ifndef SERVER_IN_MAX
+/** Most bytes held from a connection without the end of a line; a longer line closes it */
+#define SERVER_IN_MAX (64 * 1024)
+#endif
+
+#ifndef SERVER_OUT_MAX
+/** Bytes of answers waiting for a connection to read them beyond which its queries wait too */
+#define SERVER_OUT_MAX (1 << 20)
+#endif
+
+/** Outcome of a run of the server
+ * \see server_run
+ */
+struct server_stats_s {
+	/** Connections accepted */
+	unsigned long connections;
+	/** Queries answered */
+	unsigned long queries;
+	/** Malformed queries */
+	unsigned long rejected;
+	/** Time the server ran, in seconds */
+	double seconds;
+};
+
+/**
+ * Answer queries of the Restaurant List on a Unix domain socket, until interrupted.
+ *
+ * Clients connect to the socket and write query lines, in the format of query_parse(),
+ * getting their answers back, in the format of query_write() and in the order they were
+ * written. The calling thread waits on every connection at once with epoll, and hands
+ * the complete lines a connection has written to the next free thread of a pool of
+ * workers, which answer them; a connection has at most one worker at a time, so its
+ * answers keep the order of its queries. While a client does not read its answers, the
+ * server stops answering it.
+ *
+ * \param path      path of the socket; a socket already there is replaced
+ * \param workers   threads answering queries; 0 for one per online processor
+ * \param st        filled with the outcome of the run; may be NULL
+ * \return          0 once interrupted by SIGINT or SIGTERM, or -1 if the socket cannot be served
+ * \remarks The queries read the snapshots of the Restaurant List, the first one published
+ * as the server starts: another thread may go on changing the list meanwhile, as the
+ * writer of restaurant_snapshot_publish(), and the queries then see each snapshot it publishes.
+ */
+int server_run(const char *path, unsigned int workers, struct server_stats_s *st);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SERVER_H */
@@ -0,0 +1,162 @@
+/**
+ *      \file snapshot.c
+ * 		\brief Implementation file for the Snapshots: immutable versions of data shared by threads
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "snapshot.h"
+
+/**
+ * Take the versions no reader may reach any more off the snapshots; the lock must be held
+ * \param s     snapshots to operate
+ * \return      the versions taken, oldest first, linked by newer
+ * \remarks A reader of a version may reach the memory retired while any newer one was
+ * current, so the versions go strictly in order.
+ */
+static struct snapshot_s *snapshot_collect(snapshots_t *s) {
+	struct snapshot_s *first = s->oldest, *last = NULL;
+
+	while (s->oldest != NULL && s->oldest != s->current && s->oldest->pins == 0) {
+		last = s->oldest;
+		s->oldest = last->newer;
+		s->alive--;
+	}
+	if (last == NULL)
+		return NULL;
+	last->newer = NULL;
+
+	return first;
+}
+
+/**
+ * Destroy versions taken by snapshot_collect(), and the memory retired with them
+ * \param s     snapshots the versions belonged to
+ * \param v     versions, linked by newer
+ */
+static void snapshot_reclaim(snapshots_t *s, struct snapshot_s *v) {
+	struct snapshot_s *next;
+	struct snapshot_garbage_s *g, *gnext;
+
+	for (; v != NULL; v = next) {
+		next = v->newer;
+		for (g = v->garbage; g != NULL; g = gnext) {
+			gnext = g->next;
+			g->destroy(g->p);
+			free(g);
+		}
+		s->destroy(v);
+	}
+}
+
+int snapshots_init(snapshots_t *s, snapshot_destructor destroy) {
+	memset(s, 0, sizeof(*s));
+	s->destroy = destroy;
+
+	return (pthread_mutex_init(&s->lock, NULL) == 0 ? 0 : -1);
+}
+
+void snapshots_destroy(snapshots_t *s) {
+	struct snapshot_s *v = s->oldest;
+
+	s->oldest = s->current = NULL;
+	s->alive = 0;
+	snapshot_reclaim(s, v);
+	pthread_mutex_destroy(&s->lock);
+}
+
+struct snapshot_s *snapshot_pin(snapshots_t *s) {
+	struct snapshot_s *v;
+
+	pthread_mutex_lock(&s->lock);
+	v = s->current;
+	if (v != NULL)
+		v->pins++;
+	pthread_mutex_unlock(&s->lock);
+
+	return v;
+}
+
+void snapshot_unpin(snapshots_t *s, struct snapshot_s *v) {
+	struct snapshot_s *old = NULL;
+
+	if (v == NULL)
+		return;
+
+	pthread_mutex_lock(&s->lock);
+	/* only the last reader of the oldest version can let versions go */
+	if (--v->pins == 0 && v == s->oldest)
+		old = snapshot_collect(s);
+	pthread_mutex_unlock(&s->lock);
+
+	/* out of the lock: the readers do not wait for the memory to be freed */
+	snapshot_reclaim(s, old);
+}
+
+unsigned long snapshot_publish(snapshots_t *s, struct snapshot_s *v) {
+	struct snapshot_s *old;
+
+	v->pins = 0;
+	v->garbage = NULL;
+	v->newer = NULL;
+
+	pthread_mutex_lock(&s->lock);
+	v->number = ++s->published;
+	if (s->current != NULL)
+		s->current->newer = v;
+	else
+		s->oldest = v;
+	s->current = v;
+	s->alive++;
+	old = snapshot_collect(s);
+	pthread_mutex_unlock(&s->lock);
+
+	snapshot_reclaim(s, old);
+
+	return v->number;
+}
+
+int snapshot_retire(snapshots_t *s, void *p, snapshot_destructor destroy) {
+	struct snapshot_garbage_s *g;
+
+	/* only the writer changes current: it needs no lock to read it */
+	if (s->current == NULL) {
+		destroy(p);
+		return 0;
+	}
+
+	g = (struct snapshot_garbage_s *) malloc(sizeof(struct snapshot_garbage_s));
+	if (!g) {
+		perror("out of memory");
+		return -1;
+	}
+	g->p = p;
+	g->destroy = destroy;
+
+	/* the current version is only collected once the next one is published */
+	pthread_mutex_lock(&s->lock);
+	g->next = s->current->garbage;
+	s->current->garbage = g;
+	pthread_mutex_unlock(&s->lock);
+
+	return 0;
+}
@@ -0,0 +1,143 @@
+/**
+ *      \file snapshot.h
+ * 		\brief Heather file for the Snapshots: immutable versions of data shared by threads
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifndef _SNAPSHOT_H
+#define	_SNAPSHOT_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+
+/**
+ * Destructor of a version, or of memory retired from the versions.
+ * \param p     version, or memory retired
+ */
+typedef void (*snapshot_destructor)(void *p);
+
+/** Memory retired from the versions, freed once no reader may still reach it
+ * \see snapshot_retire
+ */
+struct snapshot_garbage_s {
+	/** Memory retired */
+	void *p;
+	/** Its destructor */
+	snapshot_destructor destroy;
+	/** Next memory retired with the same version */
+	struct snapshot_garbage_s *next;
+};
+
+/** Version of the data: embedded, as first member, in the struct holding the data itself,
+ *  which must not change once published
+ *  \see snapshot_publish
+ */
+struct snapshot_s {
+	/** Number of the version, from 1 */
+	unsigned long number;
+	/** Number of readers holding the version */
+	unsigned int pins;
+	/** Memory retired while the version was the current one */
+	struct snapshot_garbage_s *garbage;
+	/** Next newer version */
+	struct snapshot_s *newer;
+};
+
+/**
+ * \brief Type defenition for struct snapshots_s
+ * \see snapshots_s
+ */
+typedef struct snapshots_s snapshots_t;
+
+/** Versions of some data: readers pin the current one and read it with no lock held,
+ *  while a writer prepares the next one, which it then publishes at once; an older
+ *  version is destroyed once no reader holds it or any version before it.
+ */
+struct snapshots_s {
+	/** Guards the versions and their pins */
+	pthread_mutex_t lock;
+	/** Current version; NULL until one is published */
+	struct snapshot_s *current;
+	/** Oldest version not yet destroyed */
+	struct snapshot_s *oldest;
+	/** Destructor of the versions */
+	snapshot_destructor destroy;
+	/** Number of versions published */
+	unsigned long published;
+	/** Number of versions not yet destroyed */
+	unsigned int alive;
+};
+
+/**
+ * Initialize a snapshots object for use.
+ * \param s         must point to a user-provided memory location
+ * \param destroy   destructor of the versions published
+ * \return          0 for success. -1 for failure
+ */
+int snapshots_init(snapshots_t *s, snapshot_destructor destroy);
+
+/**
+ * Destroy every version and the memory retired.
+ * \param s     snapshots to destroy
+ * \remarks No reader may hold a version any more.
+ */
+void snapshots_destroy(snapshots_t *s);
+
+/**
+ * Pin the current version, so it is not destroyed while read.
+ * \param s     snapshots to operate
+ * \return      current version, or NULL if none was published
+ * \see snapshot_unpin
+ */
+struct snapshot_s *snapshot_pin(snapshots_t *s);
+
+/**
+ * Unpin a version pinned by snapshot_pin(), which may then be destroyed.
+ * \param s     snapshots to operate
+ * \param v     version pinned; NULL does nothing
+ */
+void snapshot_unpin(snapshots_t *s, struct snapshot_s *v);
+
+/**
+ * Make a version the current one, for the readers pinning from now on.
+ * \param s     snapshots to operate
+ * \param v     new version; it is destroyed by the destructor of s
+ * \return      number of the version
+ * \remarks Only one thread may publish and retire at a time.
+ */
+unsigned long snapshot_publish(snapshots_t *s, struct snapshot_s *v);
+
+/**
+ * Free memory that a reader of the versions published so far may still reach, once none can.
+ * \param s         snapshots to operate
+ * \param p         memory retired, which the new versions must no longer reach
+ * \param destroy   its destructor
+ * \return          0 for success. -1 if out of memory: p is then never freed
+ * \remarks Without versions published, p is destroyed at once.
+ */
+int snapshot_retire(snapshots_t *s, void *p, snapshot_destructor destroy);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SNAPSHOT_H */
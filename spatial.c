@@ -0,0 +1,688 @@
+/**
+ *      \file spatial.c
+ * 		\brief Implementation file for the Spatial Indexes (uniform grid and k-d tree)
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "spatial.h"
+#include "utils.h"
+
+/** Earth radius in Km, the same used by distance() */
+#define SPATIAL_EARTH_RADIUS 6371.0
+/** Degrees in one radian, the same used by distance() */
+#define SPATIAL_DEGREES 57.29578
+
+/** Initial number of buckets of the cells hash table */
+#define SPATIAL_MIN_BUCKETS 64
+/** Initial number of elements allocated in a cell */
+#define SPATIAL_MIN_CELL_ITEMS 4
+
+/** Column of the cell for a longitude */
+static inline int spatial_col(const spatial_grid_t *g, float longitude) {
+	int cx = (int) floor((longitude + 180.0) / g->cell_deg);
+
+	cx %= g->cols;
+	return (cx < 0 ? cx + g->cols : cx);
+}
+
+/** Row of the cell for a latitude */
+static inline int spatial_row(const spatial_grid_t *g, float latitude) {
+	int cy = (int) floor((latitude + 90.0) / g->cell_deg);
+
+	if (cy < 0)
+		return 0;
+	return (cy >= g->rows ? g->rows - 1 : cy);
+}
+
+/** Bucket of the hash table for a cell key */
+static inline unsigned int spatial_bucket(const spatial_grid_t *g, uint32_t key) {
+	return (key * 2654435761u) & (g->numbuckets - 1);
+}
+
+/** Get the cell for a key, or NULL if it was never allocated */
+static struct spatial_cell_s *spatial_cell_get(const spatial_grid_t *g, int cx, int cy) {
+	struct spatial_cell_s *c;
+	uint32_t key = (uint32_t) cy * g->cols + cx;
+
+	for (c = g->buckets[spatial_bucket(g, key)]; c != NULL; c = c->next)
+		if (c->key == key)
+			return c;
+
+	return NULL;
+}
+
+/** Double the number of buckets of the cells hash table */
+static int spatial_rehash(spatial_grid_t *g) {
+	struct spatial_cell_s **old = g->buckets;
+	unsigned int oldnum = g->numbuckets;
+	unsigned int i;
+
+	g->buckets = (struct spatial_cell_s **) calloc(oldnum * 2, sizeof(struct spatial_cell_s *));
+	if (g->buckets == NULL) {
+		g->buckets = old;
+		return -1;
+	}
+	g->numbuckets = oldnum * 2;
+
+	for (i = 0; i < oldnum; i++) {
+		while (old[i] != NULL) {
+			struct spatial_cell_s *c = old[i];
+			unsigned int b = spatial_bucket(g, c->key);
+
+			old[i] = c->next;
+			c->next = g->buckets[b];
+			g->buckets[b] = c;
+		}
+	}
+	free(old);
+
+	return 0;
+}
+
+int spatial_grid_init(spatial_grid_t *g, double cell_deg) {
+	if (g == NULL || cell_deg <= 0)
+		return -1;
+
+	g->cell_deg = cell_deg;
+	g->cols = (int) ceil(360.0 / cell_deg);
+	g->rows = (int) ceil(180.0 / cell_deg);
+	g->numbuckets = SPATIAL_MIN_BUCKETS;
+	g->buckets = (struct spatial_cell_s **) calloc(g->numbuckets, sizeof(struct spatial_cell_s *));
+	if (g->buckets == NULL)
+		return -1;
+	g->numcells = 0;
+	g->numels = 0;
+	g->min_cx = g->min_cy = INT32_MAX;
+	g->max_cx = g->max_cy = -1;
+
+	return 0;
+}
+
+void spatial_grid_clear(spatial_grid_t *g) {
+	unsigned int i;
+
+	for (i = 0; i < g->numbuckets; i++) {
+		while (g->buckets[i] != NULL) {
+			struct spatial_cell_s *c = g->buckets[i];
+
+			g->buckets[i] = c->next;
+			free(c->items);
+			free(c);
+		}
+	}
+	g->numcells = 0;
+	g->numels = 0;
+	g->min_cx = g->min_cy = INT32_MAX;
+	g->max_cx = g->max_cy = -1;
+}
+
+void spatial_grid_destroy(spatial_grid_t *g) {
+	spatial_grid_clear(g);
+	free(g->buckets);
+	g->buckets = NULL;
+	g->numbuckets = 0;
+}
+
+int spatial_grid_insert(spatial_grid_t *g, float latitude, float longitude, void *data) {
+	int cx = spatial_col(g, longitude);
+	int cy = spatial_row(g, latitude);
+	struct spatial_cell_s *c = spatial_cell_get(g, cx, cy);
+
+	if (c == NULL) {
+		unsigned int b;
+
+		if (g->numcells >= g->numbuckets && spatial_rehash(g) != 0)
+			return -1;
+
+		c = (struct spatial_cell_s *) calloc(1, sizeof(struct spatial_cell_s));
+		if (c == NULL)
+			return -1;
+		c->key = (uint32_t) cy * g->cols + cx;
+		b = spatial_bucket(g, c->key);
+		c->next = g->buckets[b];
+		g->buckets[b] = c;
+		g->numcells++;
+
+		if (cx < g->min_cx)
+			g->min_cx = cx;
+		if (cx > g->max_cx)
+			g->max_cx = cx;
+		if (cy < g->min_cy)
+			g->min_cy = cy;
+		if (cy > g->max_cy)
+			g->max_cy = cy;
+	}
+
+	if (c->count == c->size) {
+		unsigned int size = (c->size == 0 ? SPATIAL_MIN_CELL_ITEMS : c->size * 2);
+		struct spatial_item_s *items = (struct spatial_item_s *) realloc(c->items, size * sizeof(struct spatial_item_s));
+
+		if (items == NULL)
+			return -1;
+		c->items = items;
+		c->size = size;
+	}
+
+	c->items[c->count].latitude = latitude;
+	c->items[c->count].longitude = longitude;
+	c->items[c->count].data = data;
+	c->count++;
+	g->numels++;
+
+	return 0;
+}
+
+int spatial_grid_remove(spatial_grid_t *g, float latitude, float longitude, const void *data) {
+	struct spatial_cell_s *c = spatial_cell_get(g, spatial_col(g, longitude), spatial_row(g, latitude));
+	unsigned int i;
+
+	if (c == NULL)
+		return -1;
+
+	for (i = 0; i < c->count; i++) {
+		if (c->items[i].data == data) {
+			/* order inside a cell is irrelevant: move the last one here */
+			c->items[i] = c->items[--c->count];
+			g->numels--;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * Lower bound of the distance from a GPS point to any element in the cells at a given ring.
+ * \param latitude  GPS latitude of the query point
+ * \param r         ring, in cells, around the cell of the query point
+ * \param cell_deg  size of each cell in degrees
+ * \return          distance in Km
+ * \remarks The elements of the ring are at least r-1 cells away in latitude or in longitude,
+ * and the distance to the meridian r-1 cells away is the smallest of both.
+ */
+static double spatial_ring_bound(float latitude, int r, double cell_deg) {
+	double dl = (r - 1) * cell_deg / SPATIAL_DEGREES;
+
+	if (dl <= 0)
+		return 0;
+	if (dl > M_PI_2)
+		dl = M_PI_2;
+
+	return asin(cos(latitude / SPATIAL_DEGREES) * sin(dl)) * SPATIAL_EARTH_RADIUS;
+}
+
+/** Restore the max-heap property of hits, from position i down */
+static void spatial_heap_down(struct spatial_hit_s *heap, unsigned int n, unsigned int i) {
+	for (;;) {
+		unsigned int l = 2 * i + 1, r = l + 1, m = i;
+		struct spatial_hit_s tmp;
+
+		if (l < n && heap[l].distance > heap[m].distance)
+			m = l;
+		if (r < n && heap[r].distance > heap[m].distance)
+			m = r;
+		if (m == i)
+			return;
+		tmp = heap[i];
+		heap[i] = heap[m];
+		heap[m] = tmp;
+		i = m;
+	}
+}
+
+/** Restore the max-heap property of hits, from position i up */
+static void spatial_heap_up(struct spatial_hit_s *heap, unsigned int i) {
+	while (i > 0 && heap[(i - 1) / 2].distance < heap[i].distance) {
+		struct spatial_hit_s tmp = heap[i];
+
+		heap[i] = heap[(i - 1) / 2];
+		heap[(i - 1) / 2] = tmp;
+		i = (i - 1) / 2;
+	}
+}
+
+/** Comparator of hits by distance, for qsort() */
+static int spatial_hit_cmp(const void *p1, const void *p2) {
+	const struct spatial_hit_s *h1 = (const struct spatial_hit_s *) p1;
+	const struct spatial_hit_s *h2 = (const struct spatial_hit_s *) p2;
+
+	if (h1->distance < h2->distance)
+		return -1;
+	if (h2->distance < h1->distance)
+		return 1;
+
+	return 0;
+}
+
+/** Offer the elements of a cell to the heap of the k nearest */
+static void spatial_knn_cell(const struct spatial_cell_s *c, float latitude, float longitude,
+		struct spatial_hit_s *heap, unsigned int *n, unsigned int k) {
+	unsigned int i;
+
+	for (i = 0; i < c->count; i++) {
+		double d = distance(latitude, longitude, c->items[i].latitude, c->items[i].longitude);
+
+		if (*n < k) {
+			heap[*n].data = c->items[i].data;
+			heap[*n].distance = d;
+			spatial_heap_up(heap, (*n)++);
+		} else if (d < heap[0].distance) {
+			heap[0].data = c->items[i].data;
+			heap[0].distance = d;
+			spatial_heap_down(heap, k, 0);
+		}
+	}
+}
+
+unsigned int spatial_grid_knn(const spatial_grid_t *g, float latitude, float longitude, unsigned int k,
+		struct spatial_hit_s *out) {
+	int cx = spatial_col(g, longitude);
+	int cy = spatial_row(g, latitude);
+	int half = g->cols / 2;
+	int rmax, r, dx, dy;
+	unsigned int n = 0;
+
+	if (k == 0 || g->numels == 0)
+		return 0;
+
+	/* farthest ring that can still hold an occupied cell */
+	rmax = abs(cy - g->min_cy);
+	if (abs(cy - g->max_cy) > rmax)
+		rmax = abs(cy - g->max_cy);
+	if (abs(cx - g->min_cx) > rmax)
+		rmax = abs(cx - g->min_cx);
+	if (abs(cx - g->max_cx) > rmax)
+		rmax = abs(cx - g->max_cx);
+	if (rmax > g->rows + half)
+		rmax = g->rows + half;
+
+	for (r = 0; r <= rmax; r++) {
+		if (n == k && spatial_ring_bound(latitude, r, g->cell_deg) > out[0].distance)
+			break;
+
+		for (dy = -r; dy <= r; dy++) {
+			if (cy + dy < 0 || cy + dy >= g->rows)
+				continue;
+			/* only the border of the ring; columns wrap around the globe once */
+			for (dx = -r; dx <= r; dx += (abs(dy) == r || dx == r || r == 0 ? 1 : 2 * r)) {
+				const struct spatial_cell_s *c;
+
+				if (dx > half || dx < -half || (dx == -half && g->cols % 2 == 0))
+					continue;
+
+				c = spatial_cell_get(g, (cx + dx + g->cols) % g->cols, cy + dy);
+				if (c != NULL)
+					spatial_knn_cell(c, latitude, longitude, out, &n, k);
+			}
+		}
+	}
+
+	qsort(out, n, sizeof(struct spatial_hit_s), spatial_hit_cmp);
+
+	return n;
+}
+
+unsigned int spatial_grid_radius(const spatial_grid_t *g, float latitude, float longitude, double radius,
+		struct spatial_hit_s *out, unsigned int max) {
+	struct spatial_hit_s *hits = NULL;
+	unsigned int n = 0, size = 0, i;
+	double dlat = radius / SPATIAL_EARTH_RADIUS;
+	int cx = spatial_col(g, longitude);
+	int half = g->cols / 2;
+	int w, cy, cy1, cy2, dx;
+
+	if (max == 0 || g->numels == 0 || radius < 0)
+		return 0;
+
+	cy1 = spatial_row(g, latitude - dlat * SPATIAL_DEGREES);
+	cy2 = spatial_row(g, latitude + dlat * SPATIAL_DEGREES);
+
+	/* half width, in cells, of the longitudes within reach */
+	w = half;
+	if (fabs(latitude / SPATIAL_DEGREES) + dlat < M_PI_2) {
+		double s = sin(dlat) / cos(latitude / SPATIAL_DEGREES);
+
+		if (s < 1)
+			w = (int) ceil(asin(s) * SPATIAL_DEGREES / g->cell_deg);
+	}
+	if (w > half)
+		w = half;
+
+	for (cy = cy1; cy <= cy2; cy++) {
+		for (dx = -w; dx <= w; dx++) {
+			const struct spatial_cell_s *c;
+
+			if (dx == -half && g->cols % 2 == 0)
+				continue;
+
+			c = spatial_cell_get(g, (cx + dx + g->cols) % g->cols, cy);
+			if (c == NULL)
+				continue;
+
+			for (i = 0; i < c->count; i++) {
+				double d = distance(latitude, longitude, c->items[i].latitude, c->items[i].longitude);
+
+				if (d > radius)
+					continue;
+				if (n == size) {
+					struct spatial_hit_s *tmp;
+
+					size = (size == 0 ? max : size * 2);
+					tmp = (struct spatial_hit_s *) realloc(hits, size * sizeof(struct spatial_hit_s));
+					if (tmp == NULL) {
+						free(hits);
+						return 0;
+					}
+					hits = tmp;
+				}
+				hits[n].data = c->items[i].data;
+				hits[n].distance = d;
+				n++;
+			}
+		}
+	}
+
+	qsort(hits, n, sizeof(struct spatial_hit_s), spatial_hit_cmp);
+	if (n > max)
+		n = max;
+	memcpy(out, hits, n * sizeof(struct spatial_hit_s));
+	free(hits);
+
+	return n;
+}
+
+int spatial_kdtree_init(spatial_kdtree_t *t) {
+	if (t == NULL)
+		return -1;
+
+	t->items = NULL;
+	t->axis = NULL;
+	t->numels = 0;
+	t->size = 0;
+
+	return 0;
+}
+
+void spatial_kdtree_destroy(spatial_kdtree_t *t) {
+	free(t->items);
+	free(t->axis);
+	spatial_kdtree_init(t);
+}
+
+/** Coordinate of an item on a split axis */
+static inline float spatial_kdtree_coord(const struct spatial_item_s *it, int axis) {
+	return (axis ? it->longitude : it->latitude);
+}
+
+/** Partially sort items[lo..hi] on an axis so that items[nth] is in its sorted position */
+static void spatial_kdtree_select(struct spatial_item_s *items, int lo, int hi, int nth, int axis) {
+	while (lo < hi) {
+		float pivot = spatial_kdtree_coord(&items[lo + (hi - lo) / 2], axis);
+		int i = lo, j = hi;
+
+		/* Hoare partition: [lo..j] <= pivot <= [i..hi] */
+		while (i <= j) {
+			struct spatial_item_s tmp;
+
+			while (spatial_kdtree_coord(&items[i], axis) < pivot)
+				i++;
+			while (spatial_kdtree_coord(&items[j], axis) > pivot)
+				j--;
+			if (i > j)
+				break;
+			tmp = items[i];
+			items[i] = items[j];
+			items[j] = tmp;
+			i++;
+			j--;
+		}
+
+		if (nth <= j)
+			hi = j;
+		else if (nth >= i)
+			lo = i;
+		else
+			return;
+	}
+}
+
+/** Build the subtree of items[lo..hi] */
+static void spatial_kdtree_build_range(spatial_kdtree_t *t, int lo, int hi) {
+	while (lo <= hi) {
+		int i, mid = lo + (hi - lo) / 2;
+		float min_lat = 90, max_lat = -90, min_lon = 180, max_lon = -180;
+		double lon_spread;
+		int axis;
+
+		for (i = lo; i <= hi; i++) {
+			const struct spatial_item_s *it = &t->items[i];
+
+			if (it->latitude < min_lat)
+				min_lat = it->latitude;
+			if (it->latitude > max_lat)
+				max_lat = it->latitude;
+			if (it->longitude < min_lon)
+				min_lon = it->longitude;
+			if (it->longitude > max_lon)
+				max_lon = it->longitude;
+		}
+
+		/* a degree of longitude shrinks with the latitude */
+		lon_spread = (max_lon - min_lon) * cos((min_lat + max_lat) / 2 / SPATIAL_DEGREES);
+		axis = (lon_spread > max_lat - min_lat);
+
+		spatial_kdtree_select(t->items, lo, hi, mid, axis);
+		t->axis[mid] = (unsigned char) axis;
+
+		spatial_kdtree_build_range(t, lo, mid - 1);
+		lo = mid + 1;
+	}
+}
+
+int spatial_kdtree_build(spatial_kdtree_t *t, const struct spatial_item_s *items, unsigned int n) {
+	if (n > t->size) {
+		struct spatial_item_s *nitems = (struct spatial_item_s *) realloc(t->items, n * sizeof(struct spatial_item_s));
+		unsigned char *naxis;
+
+		if (nitems == NULL)
+			return -1;
+		t->items = nitems;
+		naxis = (unsigned char *) realloc(t->axis, n);
+		if (naxis == NULL)
+			return -1;
+		t->axis = naxis;
+		t->size = n;
+	}
+
+	memcpy(t->items, items, n * sizeof(struct spatial_item_s));
+	t->numels = n;
+	spatial_kdtree_build_range(t, 0, (int) n - 1);
+
+	return 0;
+}
+
+/**
+ * Lower bound of the distance from a GPS point to any element on the far side of a split.
+ * \param latitude  GPS latitude of the query point
+ * \param longitude GPS longitude of the query point
+ * \param axis      split axis: 0 for latitude, 1 for longitude
+ * \param split     coordinate of the split
+ * \return          distance in Km
+ * \remarks For a longitude split the far side can also be reached across the 180 meridian.
+ */
+static double spatial_kdtree_bound(float latitude, float longitude, int axis, float split) {
+	double dl;
+
+	if (!axis)
+		return fabs(latitude - split) / SPATIAL_DEGREES * SPATIAL_EARTH_RADIUS;
+
+	if (longitude < split)
+		dl = fmin(split - longitude, longitude + 180.0);
+	else
+		dl = fmin(longitude - split, 180.0 - longitude);
+	dl = fmin(dl / SPATIAL_DEGREES, M_PI_2);
+
+	return asin(cos(latitude / SPATIAL_DEGREES) * sin(dl)) * SPATIAL_EARTH_RADIUS;
+}
+
+/** k nearest search in the subtree of items[lo..hi] */
+static void spatial_kdtree_knn_range(const spatial_kdtree_t *t, int lo, int hi, float latitude, float longitude,
+		struct spatial_hit_s *heap, unsigned int *n, unsigned int k) {
+	while (lo <= hi) {
+		int mid = lo + (hi - lo) / 2;
+		const struct spatial_item_s *it = &t->items[mid];
+		int axis = t->axis[mid];
+		float split = spatial_kdtree_coord(it, axis);
+		double d = distance(latitude, longitude, it->latitude, it->longitude);
+		int near_left = ((axis ? longitude : latitude) < split);
+
+		if (*n < k) {
+			heap[*n].data = it->data;
+			heap[*n].distance = d;
+			spatial_heap_up(heap, (*n)++);
+		} else if (d < heap[0].distance) {
+			heap[0].data = it->data;
+			heap[0].distance = d;
+			spatial_heap_down(heap, k, 0);
+		}
+
+		/* near side first, then the far side only if it can still hold a nearer element */
+		if (near_left)
+			spatial_kdtree_knn_range(t, lo, mid - 1, latitude, longitude, heap, n, k);
+		else
+			spatial_kdtree_knn_range(t, mid + 1, hi, latitude, longitude, heap, n, k);
+
+		if (*n == k && spatial_kdtree_bound(latitude, longitude, axis, split) > heap[0].distance)
+			return;
+
+		if (near_left)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+}
+
+unsigned int spatial_kdtree_knn(const spatial_kdtree_t *t, float latitude, float longitude, unsigned int k,
+		struct spatial_hit_s *out) {
+	unsigned int n = 0;
+
+	if (k == 0 || t->numels == 0)
+		return 0;
+
+	spatial_kdtree_knn_range(t, 0, (int) t->numels - 1, latitude, longitude, out, &n, k);
+	qsort(out, n, sizeof(struct spatial_hit_s), spatial_hit_cmp);
+
+	return n;
+}
+
+/** Growable array of hits for the box search */
+struct spatial_hits_s {
+	/** Hits found */
+	struct spatial_hit_s *hits;
+	/** Number of hits found */
+	unsigned int n;
+	/** Number of hits allocated */
+	unsigned int size;
+};
+
+/** Box search in the subtree of items[lo..hi] */
+static int spatial_kdtree_box_range(const spatial_kdtree_t *t, int lo, int hi, const float *box, float latitude,
+		float longitude, struct spatial_hits_s *res) {
+	int wraps = (box[1] > box[3]);
+
+	while (lo <= hi) {
+		int mid = lo + (hi - lo) / 2;
+		const struct spatial_item_s *it = &t->items[mid];
+		int axis = t->axis[mid];
+		float split = spatial_kdtree_coord(it, axis);
+		int go_left, go_right;
+
+		if (it->latitude >= box[0] && it->latitude <= box[2] && (wraps ? (it->longitude >= box[1]
+				|| it->longitude <= box[3]) : (it->longitude >= box[1] && it->longitude <= box[3]))) {
+			if (res->n == res->size) {
+				unsigned int size = (res->size == 0 ? 64 : res->size * 2);
+				struct spatial_hit_s *tmp = (struct spatial_hit_s *) realloc(res->hits, size * sizeof(struct spatial_hit_s));
+
+				if (tmp == NULL)
+					return -1;
+				res->hits = tmp;
+				res->size = size;
+			}
+			res->hits[res->n].data = it->data;
+			res->hits[res->n].distance = distance(latitude, longitude, it->latitude, it->longitude);
+			res->n++;
+		}
+
+		if (!axis) {
+			go_left = (split >= box[0]);
+			go_right = (split <= box[2]);
+		} else if (!wraps) {
+			go_left = (split >= box[1]);
+			go_right = (split <= box[3]);
+		} else {
+			go_left = go_right = 1;
+		}
+
+		if (go_left && go_right) {
+			if (spatial_kdtree_box_range(t, lo, mid - 1, box, latitude, longitude, res) != 0)
+				return -1;
+			lo = mid + 1;
+		} else if (go_left) {
+			hi = mid - 1;
+		} else if (go_right) {
+			lo = mid + 1;
+		} else {
+			break;
+		}
+	}
+
+	return 0;
+}
+
+unsigned int spatial_kdtree_box(const spatial_kdtree_t *t, float min_latitude, float min_longitude,
+		float max_latitude, float max_longitude, float latitude, float longitude, struct spatial_hit_s *out,
+		unsigned int max) {
+	struct spatial_hits_s res = { NULL, 0, 0 };
+	float box[4];
+
+	if (max == 0 || t->numels == 0)
+		return 0;
+
+	box[0] = min_latitude;
+	box[1] = min_longitude;
+	box[2] = max_latitude;
+	box[3] = max_longitude;
+
+	if (spatial_kdtree_box_range(t, 0, (int) t->numels - 1, box, latitude, longitude, &res) != 0) {
+		free(res.hits);
+		return 0;
+	}
+
+	qsort(res.hits, res.n, sizeof(struct spatial_hit_s), spatial_hit_cmp);
+	if (res.n > max)
+		res.n = max;
+	memcpy(out, res.hits, res.n * sizeof(struct spatial_hit_s));
+	free(res.hits);
+
+	return res.n;
+}
@@ -0,0 +1,247 @@
+/**
+ *      \file spatial.h
+ * 		\brief Heather file for the Spatial Indexes (uniform grid and k-d tree)
+ * 		\author Augusto Campos
+ *
+ * 		\par Copyright
+ * 		Copyright 2008 Augusto Campos <augcampos@augcampos.pt>\n
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 3 of the License.
+ *      \par
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *      \par
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifndef _SPATIAL_H
+#define	_SPATIAL_H
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/** Default size, in degrees, of each cell of the grid (about 5.5 Km of latitude) */
+#define SPATIAL_GRID_CELL_DEG 0.05
+
+/**
+ * \brief Type defenition for struct spatial_grid_s
+ * \see spatial_grid_s
+ */
+typedef struct spatial_grid_s spatial_grid_t;
+
+/** Element stored in a cell of the grid
+ * \note [private-use]
+ */
+struct spatial_item_s {
+	/** GPS Latitude of the element */
+	float latitude;
+	/** GPS Longitude of the element */
+	float longitude;
+	/** Element data pointer */
+	void *data;
+};
+
+/** Cell of the grid, chained in the buckets of the cells hash table
+ * \note [private-use]
+ */
+struct spatial_cell_s {
+	/** Cell key: row * columns + column */
+	uint32_t key;
+	/** Number of elements in the cell */
+	unsigned int count;
+	/** Number of elements allocated in items */
+	unsigned int size;
+	/** Elements of the cell */
+	struct spatial_item_s *items;
+	/** Next cell in the same bucket */
+	struct spatial_cell_s *next;
+};
+
+/** Uniform latitude/longitude grid of elements
+ * \remarks Only non empty cells are allocated, so the grid can cover the whole globe.
+ */
+struct spatial_grid_s {
+	/** Size of each cell in degrees */
+	double cell_deg;
+	/** Number of cell columns (longitude) */
+	int cols;
+	/** Number of cell rows (latitude) */
+	int rows;
+	/** Hash table of the allocated cells */
+	struct spatial_cell_s **buckets;
+	/** Number of buckets in the hash table */
+	unsigned int numbuckets;
+	/** Number of allocated cells */
+	unsigned int numcells;
+	/** Number of elements in the grid */
+	unsigned int numels;
+	/** Lowest and highest column and row ever occupied */
+	int min_cx, max_cx, min_cy, max_cy;
+};
+
+/** k-d tree of elements, bulk built over their coordinates
+ * \remarks The tree is implicit: the root of a range [lo, hi] of items is the item at
+ * (lo + hi) / 2, splitting the range by the axis stored at the same position.
+ */
+struct spatial_kdtree_s {
+	/** Elements of the tree */
+	struct spatial_item_s *items;
+	/** Split axis of each node: 0 for latitude, 1 for longitude */
+	unsigned char *axis;
+	/** Number of elements in the tree */
+	unsigned int numels;
+	/** Number of elements allocated in items */
+	unsigned int size;
+};
+
+/**
+ * \brief Type defenition for struct spatial_kdtree_s
+ * \see spatial_kdtree_s
+ */
+typedef struct spatial_kdtree_s spatial_kdtree_t;
+
+/** Result of a spatial query */
+struct spatial_hit_s {
+	/** Element data pointer */
+	void *data;
+	/** Distance in Km to the query point */
+	double distance;
+};
+
+/**
+ * Initialize a grid object for use.
+ * \param g         must point to a user-provided memory location
+ * \param cell_deg  size of each cell in degrees
+ * \return          0 for success. -1 for failure
+ */
+int spatial_grid_init(spatial_grid_t *g, double cell_deg);
+
+/**
+ * Completely remove the grid from memory.
+ * \param g     grid to destroy
+ * \remarks The element data is not freed.
+ */
+void spatial_grid_destroy(spatial_grid_t *g);
+
+/**
+ * Remove all elements from the grid.
+ * \param g     grid to operate
+ */
+void spatial_grid_clear(spatial_grid_t *g);
+
+/**
+ * Insert an element in the grid.
+ * \param g         grid to operate
+ * \param latitude  GPS latitude of the element
+ * \param longitude GPS longitude of the element
+ * \param data      pointer to user data
+ * \return          0 for success. -1 for failure
+ */
+int spatial_grid_insert(spatial_grid_t *g, float latitude, float longitude, void *data);
+
+/**
+ * Remove an element from the grid.
+ * \param g         grid to operate
+ * \param latitude  GPS latitude the element was inserted with
+ * \param longitude GPS longitude the element was inserted with
+ * \param data      pointer to user data
+ * \return          0 for success. -1 if the element was not found
+ */
+int spatial_grid_remove(spatial_grid_t *g, float latitude, float longitude, const void *data);
+
+/**
+ * Find the k elements nearest to a GPS point.
+ * \param g         grid to operate
+ * \param latitude  GPS latitude of the query point
+ * \param longitude GPS longitude of the query point
+ * \param k         maximum number of elements to find
+ * \param out       array of at least k hits to fill, nearest first
+ * \return          number of hits stored in out
+ * \remarks Cells are visited in rings around the query cell, stopping as soon as no
+ * unvisited cell can hold an element nearer than the k-th found.
+ */
+unsigned int spatial_grid_knn(const spatial_grid_t *g, float latitude, float longitude, unsigned int k,
+		struct spatial_hit_s *out);
+
+/**
+ * Find the elements within a distance of a GPS point.
+ * \param g         grid to operate
+ * \param latitude  GPS latitude of the query point
+ * \param longitude GPS longitude of the query point
+ * \param radius    maximum distance in Km
+ * \param out       array of at least max hits to fill, nearest first
+ * \param max       maximum number of hits to store in out
+ * \return          number of hits stored in out
+ */
+unsigned int spatial_grid_radius(const spatial_grid_t *g, float latitude, float longitude, double radius,
+		struct spatial_hit_s *out, unsigned int max);
+
+/**
+ * Initialize an empty k-d tree object for use.
+ * \param t     must point to a user-provided memory location
+ * \return      0 for success. -1 for failure
+ */
+int spatial_kdtree_init(spatial_kdtree_t *t);
+
+/**
+ * Completely remove the k-d tree from memory.
+ * \param t     tree to destroy
+ * \remarks The element data is not freed.
+ */
+void spatial_kdtree_destroy(spatial_kdtree_t *t);
+
+/**
+ * Build the k-d tree over a set of elements, replacing its previous content.
+ * \param t     tree to operate
+ * \param items elements of the tree; they are copied
+ * \param n     number of elements
+ * \return      0 for success. -1 for failure
+ * \remarks Each node splits its elements at the median of the axis with the larger spread,
+ * so dense areas get deeper subtrees instead of crowded cells.
+ */
+int spatial_kdtree_build(spatial_kdtree_t *t, const struct spatial_item_s *items, unsigned int n);
+
+/**
+ * Find the k elements nearest to a GPS point.
+ * \param t         tree to operate
+ * \param latitude  GPS latitude of the query point
+ * \param longitude GPS longitude of the query point
+ * \param k         maximum number of elements to find
+ * \param out       array of at least k hits to fill, nearest first
+ * \return          number of hits stored in out
+ */
+unsigned int spatial_kdtree_knn(const spatial_kdtree_t *t, float latitude, float longitude, unsigned int k,
+		struct spatial_hit_s *out);
+
+/**
+ * Find the elements inside a latitude/longitude box.
+ * \param t             tree to operate
+ * \param min_latitude  south edge of the box
+ * \param min_longitude west edge of the box
+ * \param max_latitude  north edge of the box
+ * \param max_longitude east edge of the box
+ * \param latitude      GPS latitude of the point to measure the distances from
+ * \param longitude     GPS longitude of the point to measure the distances from
+ * \param out           array of at least max hits to fill, nearest first
+ * \param max           maximum number of hits to store in out
+ * \return              number of hits stored in out
+ * \remarks A box with min_longitude > max_longitude crosses the 180 meridian.
+ */
+unsigned int spatial_kdtree_box(const spatial_kdtree_t *t, float min_latitude, float min_longitude,
+		float max_latitude, float max_longitude, float latitude, float longitude, struct spatial_hit_s *out,
+		unsigned int max);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SPATIAL_H */
@@ -26,8 +26,18 @@
 
 #include "utils.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DISTANCE_BATCH_X86
+#endif
+
 #define LINE_CHARS 128
 
+/** Degrees in one radian, the same used by distance() */
+#define DISTANCE_DEGREES 57.29578
+/** Earth radius in Km, the same used by distance() */
+#define DISTANCE_EARTH_RADIUS 6371
+
 /**
  * Description of the days of week
  */
@@ -38,8 +48,247 @@ double distance(float lat1, float lon1, float lat2, float lon2) {
 	double d_lon1 = (double) (lon1 / 57.29578);
 	double d_lat2 = (double) (lat2 / 57.29578);
 	double d_lon2 = (double) (lon2 / 57.29578);
+	double c = sin(d_lat1) * sin(d_lat2) + cos(d_lat1) * cos(d_lat2) * cos(d_lon2 - d_lon1);
+
+	/* rounding can push the same point slightly over 1, or antipodes under -1, out of the acos domain */
+	if (c > 1.0)
+		c = 1.0;
+	else if (c < -1.0)
+		c = -1.0;
+
+	return acos(c) * 6371;
+}
+
+/** Scalar implementation of distance_batch() */
+static void distance_batch_scalar(float user_lat, float user_lon, const float *lat, const float *lon, double *out,
+		size_t n) {
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		out[i] = distance(user_lat, user_lon, lat[i], lon[i]);
+}
+
+#ifdef DISTANCE_BATCH_X86
+
+/** Taylor coefficients of sin(x) / x, in x^2 (enough for |x| <= pi/2) */
+static const double distance_sin_coef[] = { 1, -0.16666666666666666, 0.0083333333333333332,
+		-0.00019841269841269841, 2.7557319223985893e-06, -2.505210838544172e-08, 1.6059043836821613e-10,
+		-7.6471637318198164e-13, 2.8114572543455206e-15, -8.2206352466243295e-18, 1.9572941063391263e-20 };
+/** Taylor coefficients of cos(x), in x^2 (enough for |x| <= pi/2) */
+static const double distance_cos_coef[] = { 1, -0.5, 0.041666666666666664, -0.0013888888888888889,
+		2.4801587301587302e-05, -2.7557319223985888e-07, 2.08767569878681e-09, -1.1470745597729725e-11,
+		4.7794773323873853e-14, -1.5619206968586225e-16, 4.1103176233121648e-19, -8.8967913924505741e-22 };
+/** Taylor coefficients of asin(x) / x, in x^2 (enough for |x| <= sin(pi/8)) */
+static const double distance_asin_coef[] = { 1, 0.16666666666666666, 0.074999999999999997, 0.044642857142857144,
+		0.030381944444444444, 0.022372159090909092, 0.017352764423076924, 0.013964843750000001,
+		0.011551800896139705, 0.0097616095291940784, 0.0083903358096168151, 0.0073125258735988454,
+		0.0064472103118896487, 0.0057400376708419236, 0.0051533096823199046, 0.0046601434869150962,
+		0.0042409070936793632, 0.0038809645588376691, 0.0035692053938259347 };
+
+#define DISTANCE_COEFS(c) ((int) (sizeof(c) / sizeof(c[0])))
+
+/** Evaluate a polynomial in x2 with SSE2 */
+__attribute__((target("sse2")))
+static inline __m128d distance_poly_sse2(__m128d x2, const double *c, int n) {
+	__m128d r = _mm_set1_pd(c[n - 1]);
+
+	while (--n > 0)
+		r = _mm_add_pd(_mm_mul_pd(r, x2), _mm_set1_pd(c[n - 1]));
+
+	return r;
+}
+
+/** Select a where mask is set, b otherwise, with SSE2 */
+__attribute__((target("sse2")))
+static inline __m128d distance_select_sse2(__m128d mask, __m128d a, __m128d b) {
+	return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+/**
+ * Haversine distance from a GPS point to 2 others with SSE2.
+ * \param lat1 latitude of the GPS point, in radians, in every lane
+ * \param lon1 longitude of the GPS point, in radians, in every lane
+ * \param cos_lat1 cosine of lat1 in every lane
+ * \param lat latitudes of the other GPS points, in degrees
+ * \param lon longitudes of the other GPS points, in degrees
+ * \return distances in Km
+ * \remarks asin(s) is taken as 4 * asin(t), halving the angle twice with
+ * sin(x/2) = sin(x) / sqrt(2 (1 + cos(x))), so its series converges quickly.
+ */
+__attribute__((target("sse2")))
+static inline __m128d distance_kernel_sse2(__m128d lat1, __m128d lon1, __m128d cos_lat1, const float *lat,
+		const float *lon) {
+	const __m128d deg = _mm_set1_pd(DISTANCE_DEGREES);
+	const __m128d half = _mm_set1_pd(0.5);
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d two = _mm_set1_pd(2.0);
+	const __m128d pi = _mm_set1_pd(M_PI);
+	const __m128d pi_2 = _mm_set1_pd(M_PI_2);
+	__m128d lat2 = _mm_div_pd(_mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i *) lat))), deg);
+	__m128d lon2 = _mm_div_pd(_mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i *) lon))), deg);
+	__m128d hdlat = _mm_mul_pd(_mm_sub_pd(lat2, lat1), half);
+	__m128d hdlon = _mm_mul_pd(_mm_sub_pd(lon2, lon1), half);
+	__m128d s_lat, s_lon, c_lat2, a, x2;
+
+	/* sin(h) = sin(+-pi - h), to bring the half longitude difference into [-pi/2, pi/2] */
+	hdlon = distance_select_sse2(_mm_cmpgt_pd(hdlon, pi_2), _mm_sub_pd(pi, hdlon), hdlon);
+	hdlon = distance_select_sse2(_mm_cmplt_pd(hdlon, _mm_sub_pd(_mm_setzero_pd(), pi_2)),
+			_mm_sub_pd(_mm_sub_pd(_mm_setzero_pd(), pi), hdlon), hdlon);
+
+	s_lat = _mm_mul_pd(hdlat, distance_poly_sse2(_mm_mul_pd(hdlat, hdlat), distance_sin_coef,
+			DISTANCE_COEFS(distance_sin_coef)));
+	s_lon = _mm_mul_pd(hdlon, distance_poly_sse2(_mm_mul_pd(hdlon, hdlon), distance_sin_coef,
+			DISTANCE_COEFS(distance_sin_coef)));
+	c_lat2 = distance_poly_sse2(_mm_mul_pd(lat2, lat2), distance_cos_coef, DISTANCE_COEFS(distance_cos_coef));
+
+	a = _mm_add_pd(_mm_mul_pd(s_lat, s_lat), _mm_mul_pd(_mm_mul_pd(cos_lat1, c_lat2), _mm_mul_pd(s_lon, s_lon)));
+	a = _mm_min_pd(a, one);
+
+	/* a is sin^2 of the half angle; halve that angle twice more */
+	x2 = _mm_div_pd(a, _mm_mul_pd(two, _mm_add_pd(one, _mm_sqrt_pd(_mm_sub_pd(one, a)))));
+	x2 = _mm_div_pd(x2, _mm_mul_pd(two, _mm_add_pd(one, _mm_sqrt_pd(_mm_sub_pd(one, x2)))));
+
+	return _mm_mul_pd(_mm_set1_pd(8.0 * DISTANCE_EARTH_RADIUS), _mm_mul_pd(_mm_sqrt_pd(x2),
+			distance_poly_sse2(x2, distance_asin_coef, DISTANCE_COEFS(distance_asin_coef))));
+}
+
+/** SSE2 implementation of distance_batch() */
+__attribute__((target("sse2")))
+static void distance_batch_sse2(float user_lat, float user_lon, const float *lat, const float *lon, double *out,
+		size_t n) {
+	double d_lat1 = (double) (user_lat / DISTANCE_DEGREES);
+	__m128d lat1 = _mm_set1_pd(d_lat1);
+	__m128d lon1 = _mm_set1_pd((double) (user_lon / DISTANCE_DEGREES));
+	__m128d cos_lat1 = _mm_set1_pd(cos(d_lat1));
+	float tlat[2], tlon[2];
+	double tout[2];
+	size_t i;
+
+	for (i = 0; i + 2 <= n; i += 2)
+		_mm_storeu_pd(out + i, distance_kernel_sse2(lat1, lon1, cos_lat1, lat + i, lon + i));
+
+	/* the last point, padded with the GPS point itself */
+	if (i < n) {
+		tlat[0] = lat[i];
+		tlon[0] = lon[i];
+		tlat[1] = user_lat;
+		tlon[1] = user_lon;
+		_mm_storeu_pd(tout, distance_kernel_sse2(lat1, lon1, cos_lat1, tlat, tlon));
+		out[i] = tout[0];
+	}
+}
+
+/** Evaluate a polynomial in x2 with AVX2 */
+__attribute__((target("avx2")))
+static inline __m256d distance_poly_avx2(__m256d x2, const double *c, int n) {
+	__m256d r = _mm256_set1_pd(c[n - 1]);
+
+	while (--n > 0)
+		r = _mm256_add_pd(_mm256_mul_pd(r, x2), _mm256_set1_pd(c[n - 1]));
+
+	return r;
+}
+
+/**
+ * Haversine distance from a GPS point to 4 others with AVX2.
+ * \see distance_kernel_sse2
+ */
+__attribute__((target("avx2")))
+static inline __m256d distance_kernel_avx2(__m256d lat1, __m256d lon1, __m256d cos_lat1, const float *lat,
+		const float *lon) {
+	const __m256d deg = _mm256_set1_pd(DISTANCE_DEGREES);
+	const __m256d half = _mm256_set1_pd(0.5);
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d two = _mm256_set1_pd(2.0);
+	const __m256d pi = _mm256_set1_pd(M_PI);
+	const __m256d pi_2 = _mm256_set1_pd(M_PI_2);
+	__m256d lat2 = _mm256_div_pd(_mm256_cvtps_pd(_mm_loadu_ps(lat)), deg);
+	__m256d lon2 = _mm256_div_pd(_mm256_cvtps_pd(_mm_loadu_ps(lon)), deg);
+	__m256d hdlat = _mm256_mul_pd(_mm256_sub_pd(lat2, lat1), half);
+	__m256d hdlon = _mm256_mul_pd(_mm256_sub_pd(lon2, lon1), half);
+	__m256d s_lat, s_lon, c_lat2, a, x2;
+
+	/* sin(h) = sin(+-pi - h), to bring the half longitude difference into [-pi/2, pi/2] */
+	hdlon = _mm256_blendv_pd(hdlon, _mm256_sub_pd(pi, hdlon), _mm256_cmp_pd(hdlon, pi_2, _CMP_GT_OQ));
+	hdlon = _mm256_blendv_pd(hdlon, _mm256_sub_pd(_mm256_sub_pd(_mm256_setzero_pd(), pi), hdlon),
+			_mm256_cmp_pd(hdlon, _mm256_sub_pd(_mm256_setzero_pd(), pi_2), _CMP_LT_OQ));
+
+	s_lat = _mm256_mul_pd(hdlat, distance_poly_avx2(_mm256_mul_pd(hdlat, hdlat), distance_sin_coef,
+			DISTANCE_COEFS(distance_sin_coef)));
+	s_lon = _mm256_mul_pd(hdlon, distance_poly_avx2(_mm256_mul_pd(hdlon, hdlon), distance_sin_coef,
+			DISTANCE_COEFS(distance_sin_coef)));
+	c_lat2 = distance_poly_avx2(_mm256_mul_pd(lat2, lat2), distance_cos_coef, DISTANCE_COEFS(distance_cos_coef));
+
+	a = _mm256_add_pd(_mm256_mul_pd(s_lat, s_lat), _mm256_mul_pd(_mm256_mul_pd(cos_lat1, c_lat2),
+			_mm256_mul_pd(s_lon, s_lon)));
+	a = _mm256_min_pd(a, one);
+
+	/* a is sin^2 of the half angle; halve that angle twice more */
+	x2 = _mm256_div_pd(a, _mm256_mul_pd(two, _mm256_add_pd(one, _mm256_sqrt_pd(_mm256_sub_pd(one, a)))));
+	x2 = _mm256_div_pd(x2, _mm256_mul_pd(two, _mm256_add_pd(one, _mm256_sqrt_pd(_mm256_sub_pd(one, x2)))));
+
+	return _mm256_mul_pd(_mm256_set1_pd(8.0 * DISTANCE_EARTH_RADIUS), _mm256_mul_pd(_mm256_sqrt_pd(x2),
+			distance_poly_avx2(x2, distance_asin_coef, DISTANCE_COEFS(distance_asin_coef))));
+}
+
+/** AVX2 implementation of distance_batch() */
+__attribute__((target("avx2")))
+static void distance_batch_avx2(float user_lat, float user_lon, const float *lat, const float *lon, double *out,
+		size_t n) {
+	double d_lat1 = (double) (user_lat / DISTANCE_DEGREES);
+	__m256d lat1 = _mm256_set1_pd(d_lat1);
+	__m256d lon1 = _mm256_set1_pd((double) (user_lon / DISTANCE_DEGREES));
+	__m256d cos_lat1 = _mm256_set1_pd(cos(d_lat1));
+	float tlat[4], tlon[4];
+	double tout[4];
+	size_t i, j;
+
+	for (i = 0; i + 4 <= n; i += 4)
+		_mm256_storeu_pd(out + i, distance_kernel_avx2(lat1, lon1, cos_lat1, lat + i, lon + i));
+
+	/* the last points, padded with the GPS point itself */
+	if (i < n) {
+		for (j = 0; j < 4; j++) {
+			tlat[j] = (i + j < n ? lat[i + j] : user_lat);
+			tlon[j] = (i + j < n ? lon[i + j] : user_lon);
+		}
+		_mm256_storeu_pd(tout, distance_kernel_avx2(lat1, lon1, cos_lat1, tlat, tlon));
+		for (j = 0; i + j < n; j++)
+			out[i + j] = tout[j];
+	}
+}
+
+#endif /* DISTANCE_BATCH_X86 */
+
+/** Implementation of distance_batch() in use, chosen on the first call */
+static void (*distance_batch_impl)(float, float, const float *, const float *, double *, size_t) = NULL;
+
+int distance_batch_isa(eDISTANCE_ISA isa) {
+#ifdef DISTANCE_BATCH_X86
+	__builtin_cpu_init();
+
+	if ((isa == DISTANCE_ISA_AUTO || isa == DISTANCE_ISA_AVX2) && __builtin_cpu_supports("avx2")) {
+		distance_batch_impl = distance_batch_avx2;
+		return DISTANCE_ISA_AVX2;
+	}
+	if ((isa == DISTANCE_ISA_AUTO || isa == DISTANCE_ISA_SSE2) && __builtin_cpu_supports("sse2")) {
+		distance_batch_impl = distance_batch_sse2;
+		return DISTANCE_ISA_SSE2;
+	}
+#endif
+	if (isa == DISTANCE_ISA_AUTO || isa == DISTANCE_ISA_SCALAR) {
+		distance_batch_impl = distance_batch_scalar;
+		return DISTANCE_ISA_SCALAR;
+	}
+
+	return -1;
+}
+
+void distance_batch(float user_lat, float user_lon, const float *lat, const float *lon, double *out, size_t n) {
+	if (distance_batch_impl == NULL)
+		distance_batch_isa(DISTANCE_ISA_AUTO);
 
-	return acos(sin(d_lat1) * sin(d_lat2) + cos(d_lat1) * cos(d_lat2) * cos(d_lon2 - d_lon1)) * 6371;
+	distance_batch_impl(user_lat, user_lon, lat, lon, out, n);
 }
 
 char *kget_char(const char* mess, int max_count) {
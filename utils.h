@@ -31,6 +31,7 @@ extern "C"
 #include <math.h>
 #include <time.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 /**
  * Compare 2 floats
@@ -50,6 +51,36 @@ extern "C"
  */
 double distance(float lat1, float lon1, float lat2, float lon2);
 
+/** Enumerator for the instruction sets of distance_batch() */
+typedef enum {
+	DISTANCE_ISA_AUTO,
+	DISTANCE_ISA_SCALAR,
+	DISTANCE_ISA_SSE2,
+	DISTANCE_ISA_AVX2
+} eDISTANCE_ISA;
+
+/**
+ * Calculates the distance between a GPS point and many others.
+ * \param user_lat  latitude of the GPS point.
+ * \param user_lon  longitude of the GPS point.
+ * \param lat       latitudes of the other GPS points.
+ * \param lon       longitudes of the other GPS points.
+ * \param out       distances in Km, by point.
+ * \param n         number of other GPS points.
+ * \remarks The vectorized implementations use the haversine formula with polynomial
+ * sine and arcsine, so they agree with distance() except for its own rounding noise,
+ * a few centimeters for points almost at the same place.
+ * \see distance_batch_isa()
+ */
+void distance_batch(float user_lat, float user_lon, const float *lat, const float *lon, double *out, size_t n);
+
+/**
+ * Select the instruction set used by distance_batch().
+ * \param isa   instruction set; DISTANCE_ISA_AUTO picks the best one the CPU supports.
+ * \return      the instruction set in use, or -1 if the CPU does not support the one requested.
+ */
+int distance_batch_isa(eDISTANCE_ISA isa);
+
 /**
  * Get chars from keyboard.
  * \param mess  message to display to the user.